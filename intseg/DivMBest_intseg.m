@@ -28,42 +28,93 @@ ee = params.ee;
 
 nnodes = size(ne, 2);
 
-% find Modes
-divne = ne;
-allL = [];
-
-for ps = 1:nummodes
-    [L en lb] = perform_inference(divne,el,ee,'trw');
-    allL(ps,:) = L';
-    seg{ps} = label2seg(L, labels);
-    
-    % compute accuracies
-    [acc, precision, recall, sol_iou(ps), fmeasure] = computeStats(seg{ps}, gt);
-    
-    [~,~,sol_en(ps)] = get_state_energy(L+1,ne,el,ee);
-    
-    % suppress mode
-    if(strcmp(type, 'perturb'))
-	divne = ne;
-	U = rand([size(ne,1) size(ne,2)]);
-	gumbel = log(-log(U));
-	divne = divne + lambda * gumbel;
-    elseif(strcmp(type, 'divMbest'))
-	inds = sub2ind([nlabels nnodes],L'+1,1:nnodes);
-	divne(inds) = divne(inds) + lambda;
-    elseif(strcmp(type, 'divMbest_boundary_'))
-	%not everywhere. only penalize inds at boundaries
-	bedges = find(L(el(1,:)) ~= L(el(2,:)));
-	bnodes = unique(el(:,bedges));
-	inds = sub2ind([nlabels nnodes],L(bnodes)+1,bnodes);
-	
-	divne(inds) = divne(inds) + lambda;
+% All modes in one call. The diversity terms are applied to the unary
+% terms in place, and each mode is warm-started from the messages of the
+% previous one
+div_types = struct('perturb', 'perturb', 'divMbest', 'hamming', 'divMbest_boundary_', 'boundary');
+if isfield(params, 'seed')
+    seed = params.seed;
+else
+    seed = 0;
+end
+% The structured diversity types are instead added to the graph by
+% vgg_qpbo_divmbest, weighted by lambda: Hamming, boundary (edges cut in a
+% previous mode) and segment (segments of a previous mode not entirely
+% relabelled, as higher order cliques)
+qpbo_types = struct('divMbest_qpbo', [1 0 0], 'divMbest_edges', [0 1 0], 'divMbest_segments', [0 0 1]);
+if ~isfield(div_types, type) && ~isfield(qpbo_types, type)
+    valid = [fieldnames(div_types); fieldnames(qpbo_types)];
+    error('Unknown type ''%s''. Valid types are:%s', type, sprintf(' %s', valid{:}));
+end
+
+% Distinct modes are added to a store as the solver produces each mode:
+% binary labellings to a bit-packed store kept by vgg_solution_store
+% (streamed to params.storefile, if given), which also keeps their
+% distances, other labellings to the columns of distinct. Nodes left
+% unlabelled by QPBO (labels < 0) are taken as label 0, as in the energy of
+% the mode.
+binary = isfield(qpbo_types, type) || size(ne, 1) == 2;
+if isfield(params, 'storefile') && ~binary
+    error('params.storefile is only supported for binary labellings.');
+end
+distinct = zeros(nnodes, 0);
+hamdist = [];
+sol_index = zeros(1, nummodes);
+nadded = 0;
+if binary
+    if isfield(params, 'storefile')
+        store = vgg_solution_store('open', nnodes, params.storefile);
+    else
+        store = vgg_solution_store('open', nnodes);
     end
-    hamdist(ps) = sum(allL(ps,:)~=allL(1,:));
-%                     figure, imshow(seg{ps,pf});
 end
+try
+    % The labellings are read from the store, not from the solver output
+    if isfield(qpbo_types, type)
+        [~, nativeEn] = vgg_qpbo_divmbest(ne,uint32(el),ee,lambda*qpbo_types.(type),nummodes,{int32(0), @add_mode});
+    else
+        [~, nativeEn] = perform_divmbest(ne,el,ee,lambda,nummodes,'trw',[],div_types.(type),seed,@add_mode);
+    end
+    if binary
+        distinct = vgg_solution_store('labels', store);
+        hamming = vgg_solution_store('distances', store, sol_index);
+        vgg_solution_store('close', store);
+    else
+        hamming = hamdist(sol_index,sol_index);
+    end
+catch err
+    if binary
+        vgg_solution_store('close', store);
+    end
+    rethrow(err);
+end
+
+% Segmentations and accuracies of the distinct modes, in one pass over the
+% pixels. Mode ps shares those of distinct mode sol_index(ps).
+[allseg stats] = vgg_seg_stats(distinct, labels, gt);
 
-output.seg = seg;
-output.sol_iou = sol_iou;
-output.sol_en = sol_en;
+output.allseg = allseg;
+output.sol_index = sol_index;
+output.sol_iou = stats(4,sol_index);
+output.sol_en = nativeEn;
+output.hamming = hamming;
+
+    function add_mode(L)
+        % Adds a mode to the store, as soon as the solver has computed it
+        L = double(L);
+        L(L < 0) = 0;
+        nadded = nadded + 1;
+        if binary
+            sol_index(nadded) = vgg_solution_store('add', store, L);
+        else
+            s = find(all(bsxfun(@eq, distinct, L), 1), 1);
+            if isempty(s)
+                d = sum(bsxfun(@ne, distinct, L), 1);
+                hamdist = [hamdist d'; d 0];
+                distinct(:,end+1) = L;
+                s = size(distinct, 2);
+            end
+            sol_index(nadded) = s;
+        end
+    end
 end
@@ -0,0 +1,107 @@
+function results = sweep_DivMBest_intseg(sweep)
+
+%
+% function results = sweep_DivMBest_intseg(sweep)
+%
+% Runs DivMBest_intseg over a grid of diversity types, lambdas and numbers of modes, for every
+% image of a dataset, and collects the oracle (best of the first M modes) IoU of each configuration.
+%
+% The energies of each image are loaded once. Modes are computed greedily, so the first M modes of
+% a run with more modes are the modes of a run with M modes: each (image, type, lambda) is only run
+% once, with the largest number of modes, and the MAP solution (first mode) it starts from serves all
+% the numbers of modes. These runs are spread over the workers of the current parallel pool (if
+% any). The IoU of the modes of each run is cached on disk, in a file named after the parameters, so
+% that a rerun only computes the runs that are missing, or that need more modes than were cached.
+%
+% Inputs (fields of sweep)
+% 1. datadir   -- directory of the .mat energies (as in demo_DivMBest_intseg).
+% 2. gtdir     -- directory of the ground truth images. Default: <datadir>/gtdir.
+% 3. types     -- cell array of diversity types (see DivMBest_intseg). Default: {'divMbest'}.
+% 4. lambdas   -- vector of diversity weights.
+% 5. nummodes  -- vector of numbers of modes M.
+% 6. cachedir  -- directory of the result cache. Default: ./sweepcache.
+% 7. files     -- (optional) cell array of image names to use. Default: all the images in datadir.
+% 8. seed      -- (optional) seed of the perturbations (default 0).
+%
+% Outputs (fields of results, along with the grid)
+% 1. oracle_iou       -- <num_files> x <num_types> x <num_lambdas> x <num_nummodes> oracle IoUs.
+% 2. mean_oracle_iou  -- <num_types> x <num_lambdas> x <num_nummodes> mean of oracle_iou over images.
+
+if ~isfield(sweep,'gtdir'), sweep.gtdir = fullfile(sweep.datadir, 'gtdir'); end
+if ~isfield(sweep,'types'), sweep.types = {'divMbest'}; end
+if ~isfield(sweep,'cachedir'), sweep.cachedir = './sweepcache'; end
+if ~isfield(sweep,'seed'), sweep.seed = 0; end
+if ~isfield(sweep,'files')
+  flist = dir(fullfile(sweep.datadir,'*.mat'));
+  sweep.files = cellfun(@(f) f(1:end-4), {flist.name}, 'UniformOutput', false);
+end
+if ~exist(sweep.cachedir,'dir')
+  mkdir(sweep.cachedir);
+end
+
+nfiles = numel(sweep.files);
+ntypes = numel(sweep.types);
+nlambdas = numel(sweep.lambdas);
+maxmodes = max(sweep.nummodes);
+
+% Runs, one per (image, type, lambda), and the IoUs of their modes
+[ll tt ff] = ndgrid(1:nlambdas, 1:ntypes, 1:nfiles);
+nruns = numel(ff);
+cachefile = cell(nruns,1);
+sol_iou = cell(nruns,1);
+for r = 1:nruns
+  cachefile{r} = fullfile(sweep.cachedir, sprintf('%s_%s_lambda%s_seed%d.mat', sweep.files{ff(r)}, ...
+                         sweep.types{tt(r)}, num2str(sweep.lambdas(ll(r)), '%.10g'), sweep.seed));
+  if exist(cachefile{r},'file')
+    cached = load(cachefile{r});
+    if numel(cached.sol_iou) >= maxmodes
+      sol_iou{r} = cached.sol_iou;
+    end
+  end
+end
+todo = find(cellfun(@isempty, sol_iou));
+
+% Load the energies of the images with runs to do, once per image
+jobs = cell(numel(todo),1);
+loaded = [];
+for j = 1:numel(todo)
+  r = todo(j);
+  if isempty(loaded) || ~isequal(loaded.fname, sweep.files{ff(r)})
+    loaded = load_intseg_energies(sweep.datadir, sweep.gtdir, sweep.files{ff(r)});
+    loaded.datadir = sweep.datadir;
+    loaded.gtdir = sweep.gtdir;
+    loaded.savedir = sweep.cachedir;
+    loaded.nlabels = 2;
+    loaded.nummodes = maxmodes;
+    loaded.seed = sweep.seed;
+  end
+  jobs{j} = loaded;
+  jobs{j}.type = sweep.types{tt(r)};
+  jobs{j}.lambda = sweep.lambdas(ll(r));
+end
+
+% Do the runs
+fprintf('%d of %d runs cached, computing %d\n', nruns-numel(todo), nruns, numel(todo));
+todo_iou = cell(numel(todo),1);
+todo_file = cachefile(todo);
+parfor j = 1:numel(todo)
+  output = DivMBest_intseg(jobs{j});
+  todo_iou{j} = output.sol_iou;
+  save_cache(todo_file{j}, output.sol_iou, output.sol_en);
+end
+sol_iou(todo) = todo_iou;
+
+% Oracle IoU of the first M modes of each run
+results = rmfield(sweep, 'cachedir');
+results.oracle_iou = zeros(nfiles, ntypes, nlambdas, numel(sweep.nummodes));
+for r = 1:nruns
+  best = cummax(sol_iou{r}(1:maxmodes));
+  results.oracle_iou(ff(r),tt(r),ll(r),:) = best(sweep.nummodes);
+end
+results.mean_oracle_iou = reshape(mean(results.oracle_iou,1), [ntypes nlambdas numel(sweep.nummodes)]);
+end
+
+% save() cannot be called directly in the body of a parfor loop
+function save_cache(filename, sol_iou, sol_en)
+save(filename, 'sol_iou', 'sol_en');
+end
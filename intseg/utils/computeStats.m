@@ -1,12 +1,16 @@
 function [acc, precision, recal, iou, fmeasure] = computeStats(seg_im, gt_im)
 
- acc = numel(union(find(seg_im==1 & gt_im==1),find(seg_im==0 & gt_im==0)))/(prod(size(seg_im))-numel(find(gt_im==255)));
+ seg1 = (seg_im==1);
+ gt1 = (gt_im==1);
+ tp = nnz(seg1 & gt1);
 
- iou = numel(intersect(find(gt_im==1),find(seg_im==1)))/numel(union(find(gt_im==1),find(seg_im==1)));
+ acc = (tp + nnz(seg_im==0 & gt_im==0))/(numel(seg_im)-nnz(gt_im==255));
 
- precision = numel(intersect(find(seg_im==1),find(gt_im==1))) / numel(find(seg_im==1));
+ iou = tp/nnz(gt1 | seg1);
 
- recal = numel(intersect(find(seg_im==1),find(gt_im==1))) / numel(find(gt_im==1));
+ precision = tp / nnz(seg1);
+
+ recal = tp / nnz(gt1);
 
  fmeasure = 2*precision*recal/(precision + recal); 
-end
\ No newline at end of file
+end
@@ -0,0 +1,51 @@
+function convert_intseg_energies(datadir, outdir)
+
+%
+% function convert_intseg_energies(datadir, [outdir])
+%
+% Function to convert the <fname>.mat energies of the interactive segmentation data into the
+% binary format read by load_intseg_energies, which can be memory-mapped instead of loaded.
+%
+% Inputs
+% 1. datadir  -- directory of the <fname>.mat files holding data_term, labels and sparse_term.
+% 2. outdir   -- directory to write the <fname>.bin files to. Default: datadir.
+%
+% Format of a .bin file (little endian, no padding):
+%   header       -- 1 x 8 uint32: 'ISEG' magic (as uint32), version (1), nnodes, nedges,
+%                   height and width of the superpixel map, 0, 0.
+%   ne           -- 2 x nnodes double node energies, with the two labels already swapped as in
+%                   load_intseg_energies.
+%   wt           -- 1 x nedges double edge weights.
+%   first        -- 1 x (nnodes+1) uint32. Compressed edge list: the edges whose second node is i
+%                   are first(i)+1:first(i+1), in the order of find(triu(sparse_term)).
+%   node1        -- 1 x nedges uint32 first node of each edge (1-based).
+%   labels       -- height x width uint32 superpixel map (0-based).
+
+if ~exist('outdir','var') || isempty(outdir)
+  outdir = datadir;
+end
+
+flist = dir(fullfile(datadir,'*.mat'));
+for f = 1:numel(flist)
+  fname = flist(f).name(1:end-4);
+  load_struct = load(fullfile(datadir, flist(f).name));
+  labels = load_struct.labels;
+  nnodes = size(load_struct.data_term,2);
+  assert(nnodes==length(unique(labels)));
+
+  ne = double(load_struct.data_term([2 1],:));
+  [node1 node2 wt] = find(triu(load_struct.sparse_term));
+  first = [0 cumsum(accumarray(node2(:), 1, [nnodes 1]))'];
+
+  fid = fopen(fullfile(outdir, [fname '.bin']), 'w', 'ieee-le');
+  if fid < 0
+    error('cannot write %s', fullfile(outdir, [fname '.bin']));
+  end
+  fwrite(fid, [typecast(uint8('ISEG'),'uint32') 1 nnodes numel(wt) size(labels,1) size(labels,2) 0 0], 'uint32');
+  fwrite(fid, ne, 'double');
+  fwrite(fid, wt, 'double');
+  fwrite(fid, first, 'uint32');
+  fwrite(fid, node1, 'uint32');
+  fwrite(fid, labels, 'uint32');
+  fclose(fid);
+end
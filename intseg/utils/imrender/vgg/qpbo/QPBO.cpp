@@ -844,6 +844,61 @@ template <typename REAL>
 	}
 }
 
+template <typename REAL>
+	void QPBO<REAL>::AddUnaryTermDynamic(NodeId i, REAL E0, REAL E1)
+{
+	user_assert(i >= 0 && i < node_num);
+
+	AddUnaryTerm(i, E0, E1);
+	mark_node(&nodes[0][i]);
+	if (stage) mark_node(&nodes[1][i]);
+}
+
+template <typename REAL>
+	typename QPBO<REAL>::EdgeId QPBO<REAL>::AddPairwiseTermDynamic(NodeId i, NodeId j, REAL E00, REAL E01, REAL E10, REAL E11)
+{
+	user_assert(first_free); // reallocating the edges would invalidate the search trees
+
+	EdgeId e = AddPairwiseTerm(i, j, E00, E01, E10, E11);
+	mark_node(&nodes[0][i]);
+	mark_node(&nodes[0][j]);
+	if (stage)
+	{
+		mark_node(&nodes[1][i]);
+		mark_node(&nodes[1][j]);
+	}
+	return e;
+}
+
+template <typename REAL>
+	void QPBO<REAL>::AddPairwiseTermDynamic(EdgeId e, NodeId i, NodeId j, REAL E00, REAL E01, REAL E10, REAL E11)
+{
+	AddPairwiseTerm(e, i, j, E00, E01, E10, E11);
+	mark_node(&nodes[0][i]);
+	mark_node(&nodes[0][j]);
+	if (stage)
+	{
+		mark_node(&nodes[1][i]);
+		mark_node(&nodes[1][j]);
+	}
+}
+
+template <typename REAL>
+	void QPBO<REAL>::SolveDynamic()
+{
+	Node* i;
+
+	// Solve() leaves stage 0 only if all edges are submodular
+	code_assert(stage == 1 || all_edges_submodular);
+	maxflow(true);
+
+	for (i=nodes[0]; i<node_last[0]; i++)
+	{
+		i->label = what_segment(i);
+		if (stage && i->label == what_segment(GetMate0(i))) i->label = -1;
+	}
+}
+
 template <typename REAL> REAL QPBO<REAL>::ComputeTwiceEnergy(int option)
 {
 	REAL E = 2*zero_energy, E1[2], E2[2][2];
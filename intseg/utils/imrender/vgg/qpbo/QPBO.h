@@ -113,6 +113,7 @@
 #define exit(X) mexErrMsgTxt("Unspecified Error")
 
 #include <string.h>
+#include <limits>
 #include "block.h"
 
 // NOTE: in UNIX, use -DNDEBUG flag to suppress assertions!!!
@@ -256,6 +257,23 @@ public:
 	// that if GetLabel(i)>=0 (i.e. node i is labeled) then x_i == GetLabel(i) for ALL global minima x.
 	void Solve();
 
+	// Dynamic graph cuts (Kohli & Torr, ICCV 2005). After Solve(), unary terms may be changed
+	// with AddUnaryTermDynamic() and the energy solved again with SolveDynamic(), which reuses
+	// the flow and search trees of the previous maxflow rather than starting from scratch.
+	// For a submodular energy, only the part of the graph affected by the changes is recomputed.
+	// The search trees are destroyed by ComputeWeakPersistencies(), Probe() and Improve(), 
+	// which therefore must not be called in between.
+	//
+	// Pairwise terms may also be added, to new or existing edges, with AddPairwiseTermDynamic(),
+	// and nodes with AddNode() (a new node is unconnected until terms are added to it).
+	// If the energy was submodular, the added pairwise terms must also be submodular.
+	// Reallocating the nodes or edges invalidates the search trees, so the memory for all
+	// the nodes and edges must be allocated by the constructor.
+	void AddUnaryTermDynamic(NodeId i, REAL E0, REAL E1);
+	EdgeId AddPairwiseTermDynamic(NodeId i, NodeId j, REAL E00, REAL E01, REAL E10, REAL E11);
+	void AddPairwiseTermDynamic(EdgeId e, NodeId i, NodeId j, REAL E00, REAL E01, REAL E10, REAL E11);
+	void SolveDynamic();
+
 	// Can only be called immediately after Solve()/Probe() (and before any modifications are made to the energy).
 	// Computes WEAKLY PERSISTENT LABELING. Use GetLabel() to read the result.
 	// NOTE: if the energy is submodular, then ComputeWeakPersistences() will label all nodes (in general, this is not necessarily true for Solve()).
@@ -329,7 +347,7 @@ public:
 		ProbeOptions()
 			: directed_constraints(2),
 			  weak_persistencies(0),
-			  C(100000),
+			  C(std::numeric_limits<REAL>::max()/4 < 100000 ? std::numeric_limits<REAL>::max()/4 : 100000),
 			  order_array(NULL),
 			  order_seed(0),
 			  dilation(3),
@@ -346,6 +364,7 @@ public:
 
 		REAL C; // Large constant used inside Probe() for enforcing directed constraints. 
 		        // Note: small value may increase the number of iterations, large value may cause overflow.
+		        // Default: 100000, or a quarter of the largest value of REAL if that is smaller.
 
 		int* order_array; // if array of size nodeNum() is provided, then nodes are tested in the order order_array[0], order_array[1], ...
 		unsigned int order_seed; // used only if order_array == NULL:
@@ -388,6 +407,17 @@ public:
 	// second run can be combined using MergeMappings. Array mapping0 is updated accordingly.
 	static void MergeMappings(int nodeNum0, int* mapping0, int* mapping1);
 
+	// Tests nodes order_array[0], ..., order_array[N-1] as Probe() does, but without changing
+	// the energy: each unlabeled node i is fixed to 0 and then to 1, and every other unlabeled
+	// node j which gets the same label x in both cases takes label x in all global minima.
+	// For each such j with fixed_labels[j] < 0, sets fixed_labels[j] = x (fixed_labels is
+	// of size GetNodeNum()). Returns the number of labels set, or -1 if a node could not be
+	// fixed (overflow is likely).
+	// Must be called after Solve(), with no other calls in between, as the search trees are
+	// reused. Since the result does not depend on previous tests, different nodes can be
+	// tested by different threads, each on its own copy of the energy (see QPBO(QPBO&)).
+	int ProbeNodes(int N, int* order_array, int* fixed_labels);
+
 
 	//////////////////////////////////////////////////////////
 	//////////////////////////////////////////////////////////
@@ -431,6 +461,11 @@ private:
 
 		unsigned int user_label : 1; // set by calling SetLabel()
 
+		REAL		tr_cap;		// if tr_cap > 0 then tr_cap is residual capacity of the Arc SOURCE->Node
+								// otherwise         -tr_cap is residual capacity of the Arc Node->SINK 
+								// (declared after the flags, so that a 4 byte or smaller REAL
+								// fills their padding on 64 bit platforms)
+
 		union
 		{
 			struct
@@ -447,9 +482,6 @@ private:
 				Arc		*dfs_current;
 			};
 		};
-
-		REAL		tr_cap;		// if tr_cap > 0 then tr_cap is residual capacity of the Arc SOURCE->Node
-								// otherwise         -tr_cap is residual capacity of the Arc Node->SINK 
 	};
 
 	struct Arc
@@ -1152,6 +1152,83 @@ template <typename REAL>
 		delete [] mapping1;
 }
 
+template <typename REAL>
+	int QPBO<REAL>::ProbeNodes(int N, int* order_array, int* fixed_labels)
+{
+	int p, k, K, label[2];
+	int fixed_num = 0;
+	Node* i;
+	Node* j;
+	Node* _i[2];
+	Node** ptr;
+	bool success;
+
+	user_assert(stage == 1 && maxflow_iteration > 0);
+
+	for (p=0; p<N; p++)
+	{
+		i = _i[0] = &nodes[0][order_array[p]];
+		_i[1] = GetMate0(i);
+		if (i->label >= 0) continue;
+
+		REAL INFTY0 = DetermineSaturation(_i[0]);
+		REAL INFTY1 = DetermineSaturation(_i[1]);
+		REAL INFTY = ((INFTY0 > INFTY1) ? INFTY0 : INFTY1) + 1;
+
+		// fix to 0, run maxflow. The changed list is kept over the three runs
+		// below, so its first K nodes are the nodes changed by fixing to 0
+		mark_node(_i[0]);
+		mark_node(_i[1]);
+		AddUnaryTerm(i, 0, INFTY);
+		maxflow(true, true);
+		success = (what_segment(_i[0])==0 && what_segment(_i[1])==1);
+		for (ptr=changed_list->ScanFirst(), K=0; ptr; ptr=changed_list->ScanNext(), K++)
+		{
+			j = *ptr;
+			j->label_after_fix0 = what_segment(j);
+			if (j->label_after_fix0 == what_segment(GetMate0(j))) j->label_after_fix0 = -1;
+		}
+
+		// fix to 1, run maxflow
+		mark_node(_i[0]);
+		mark_node(_i[1]);
+		AddUnaryTerm(i, 0, -2*INFTY);
+		maxflow(true, true);
+		success = success && (what_segment(_i[0])==1 && what_segment(_i[1])==0);
+		for (ptr=changed_list->ScanFirst(), k=0; ptr; ptr=changed_list->ScanNext(), k++)
+		{
+			j = *ptr;
+			if (j == i || j->label >= 0) continue;
+
+			// nodes not changed by fixing to 0 kept their (unlabeled) state
+			label[0] = (k < K) ? j->label_after_fix0 : -1;
+			label[1] = what_segment(j);
+			if (label[1] == what_segment(GetMate0(j))) label[1] = -1;
+
+			if (success && label[0] >= 0 && label[0] == label[1] && fixed_labels[j - nodes[0]] < 0)
+			{
+				fixed_labels[j - nodes[0]] = label[0];
+				fixed_num ++;
+			}
+		}
+
+		// restore the energy
+		mark_node(_i[0]);
+		mark_node(_i[1]);
+		AddUnaryTerm(i, 0, INFTY);
+		maxflow(true, true);
+		for (ptr=changed_list->ScanFirst(); ptr; ptr=changed_list->ScanNext())
+		{
+			(*ptr)->is_in_changed_list = 0;
+		}
+		changed_list->Reset();
+
+		if (!success) return -1;
+	}
+
+	return fixed_num;
+}
+
 template <typename REAL>
 	bool QPBO<REAL>::Improve(int N, int* order_array, int* fixed_nodes)
 {
@@ -231,7 +231,8 @@ template <typename REAL>
 		i -> DIST = 1;
 	}
 
-	code_assert(stage == 1);
+	// in stage 0 only the graph of a submodular energy can be reused (see SolveDynamic())
+	code_assert(stage == 1 || all_edges_submodular);
 	//test_consistency();
 
 	/* adoption */
@@ -21,6 +21,11 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
 
 #include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include "disjoint-set.h"
 
 // threshold function
@@ -35,21 +40,92 @@ bool operator<(const edge &a, const edge &b) {
   return a.w < b.w;
 }
 
+// radix sort key of an edge: weights are non-negative, so the bits of the
+// float order the same as the weights
+static inline uint32_t edge_key(const edge &e) {
+  uint32_t key;
+  memcpy(&key, &e.w, sizeof(key));
+  return key;
+}
+
 /*
- * Segment a graph
+ * Sort edges by weight
+ *
+ * Stable LSD radix sort on the weight bits, a byte per pass. The edges are
+ * split into chunks, which are counted and scattered in parallel. Passes in
+ * which all the edges have the same byte are skipped.
+ *
+ * num_edges: number of edges in graph
+ * edges: array of edges.
+ */
+static void sort_edges(int num_edges, edge *edges) {
+  int num_chunks = 1;
+#ifdef _OPENMP
+  if (num_edges > 100000)
+    num_chunks = omp_get_num_procs();
+#endif
+  int chunk = (num_edges + num_chunks - 1) / num_chunks;
+  std::vector<int> count(256 * num_chunks);
+  edge *tmp = new edge[num_edges];
+  edge *src = edges;
+  edge *dst = tmp;
+
+  for (int shift = 0; shift < 32; shift += 8) {
+    // count the bytes in each chunk
+    int t;
+#pragma omp parallel for if (num_chunks > 1) num_threads(num_chunks) default(shared) private(t)
+    for (t = 0; t < num_chunks; t++) {
+      int *cnt = &count[256 * t];
+      for (int d = 0; d < 256; d++)
+	cnt[d] = 0;
+      int end = std::min(num_edges, (t + 1) * chunk);
+      for (int i = t * chunk; i < end; i++)
+	cnt[(edge_key(src[i]) >> shift) & 255]++;
+    }
+
+    // turn the counts into offsets, by byte then chunk
+    int sum = 0;
+    bool skip = false;
+    for (int d = 0; d < 256 && !skip; d++) {
+      int start = sum;
+      for (t = 0; t < num_chunks; t++) {
+	int n = count[256 * t + d];
+	count[256 * t + d] = sum;
+	sum += n;
+      }
+      skip = sum - start == num_edges;
+    }
+    if (skip)
+      continue;
+
+    // scatter each chunk
+#pragma omp parallel for if (num_chunks > 1) num_threads(num_chunks) default(shared) private(t)
+    for (t = 0; t < num_chunks; t++) {
+      int *cnt = &count[256 * t];
+      int end = std::min(num_edges, (t + 1) * chunk);
+      for (int i = t * chunk; i < end; i++)
+	dst[cnt[(edge_key(src[i]) >> shift) & 255]++] = src[i];
+    }
+    std::swap(src, dst);
+  }
+
+  if (src != edges)
+    memcpy(edges, src, num_edges * sizeof(edge));
+  delete [] tmp;
+}
+
+/*
+ * Segment a graph whose edges are sorted by weight
  *
  * Returns a disjoint-set forest representing the segmentation.
  *
  * num_vertices: number of vertices in graph.
  * num_edges: number of edges in graph
- * edges: array of edges.
+ * edges: array of edges, in non-decreasing weight order.
  * c: constant for treshold function.
  */
-universe *segment_graph(int num_vertices, int num_edges, edge *edges, 
-			float c) { 
-  // sort edges by weight
-  std::sort(edges, edges + num_edges);
-
+universe *segment_sorted_graph(int num_vertices, int num_edges,
+			       const edge *edges, float c) { 
   // make a disjoint-set forest
   universe *u = new universe(num_vertices);
 
@@ -60,7 +136,7 @@ universe *segment_graph(int num_vertices, int num_edges, edge *edges,
 
   // for each edge, in non-decreasing weight order...
   for (int i = 0; i < num_edges; i++) {
-    edge *pedge = &edges[i];
+    const edge *pedge = &edges[i];
     
     // components conected by this edge
     int a = u->find(pedge->a);
@@ -76,8 +152,25 @@ universe *segment_graph(int num_vertices, int num_edges, edge *edges,
   }
 
   // free up
-  delete threshold;
+  delete [] threshold;
   return u;
 }
 
+/*
+ * Segment a graph
+ *
+ * Returns a disjoint-set forest representing the segmentation.
+ *
+ * num_vertices: number of vertices in graph.
+ * num_edges: number of edges in graph
+ * edges: array of edges.
+ * c: constant for treshold function.
+ */
+universe *segment_graph(int num_vertices, int num_edges, edge *edges, 
+			float c) { 
+  // sort edges by weight
+  sort_edges(num_edges, edges);
+  return segment_sorted_graph(num_vertices, num_edges, edges, c);
+}
+
 #endif
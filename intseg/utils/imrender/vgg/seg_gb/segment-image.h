@@ -20,6 +20,13 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
 #define SEGMENT_IMAGE
 
 #include <cstdlib>
+#include <vector>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include "image.h"
 #include "misc.h"
 #include "filter.h"
@@ -151,101 +158,214 @@ image<rgb> *segment_image(image<rgb> *im, float sigma, float c, int min_size,
 }
 
 /*
- * Segment an image
+ * Convolve rows with an even mask, as convolve_even
  *
- * Returns a color image representing the segmentation.
+ * Each of the num_rows rows of src (of length width) is convolved with mask,
+ * and written as a column of the transposed dst (num_rows high). Rows are
+ * done in parallel, and the pixels of a row four at a time, each pixel's
+ * sum being accumulated in the same order as convolve_even.
+ */
+static void convolve_even_rows(const float *src, float *dst, int width,
+			       int num_rows, const std::vector<float> &mask) {
+  int len = mask.size();
+  int y;
+#pragma omp parallel for if (width*num_rows > 10000) num_threads(omp_get_num_procs()) default(shared) private(y)
+  for (y = 0; y < num_rows; y++) {
+    // row padded with its end values, followed by the sums
+    std::vector<float> buf(2*(width+len-1));
+    float *pad = &buf[0];
+    const float *row = &src[y * width];
+    for (int i = 0; i < len-1; i++) {
+      pad[i] = row[0];
+      pad[width+len-1+i] = row[width-1];
+    }
+    const float *p = pad + len-1;
+    memcpy(pad + len-1, row, width * sizeof(float));
+    float *sum = pad + width + 2*(len-1);
+
+    for (int x = 0; x < width; x++)
+      sum[x] = mask[0] * p[x];
+    for (int i = 1; i < len; i++) {
+      int x = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+      __m128 m = _mm_set1_ps(mask[i]);
+      for (; x+4 <= width; x += 4) {
+	__m128 a = _mm_add_ps(_mm_loadu_ps(p+x-i), _mm_loadu_ps(p+x+i));
+	_mm_storeu_ps(sum+x, _mm_add_ps(_mm_loadu_ps(sum+x), _mm_mul_ps(m, a)));
+      }
+#endif
+      for (; x < width; x++)
+	sum[x] += mask[i] * (p[x-i] + p[x+i]);
+    }
+
+    for (int x = 0; x < width; x++)
+      dst[x * num_rows + y] = sum[x];
+  }
+}
+
+/*
+ * Smooth the color channels of an image, as smooth
  *
- * im: image to segment.
- * sigma: to smooth the image.
- * c: constant for treshold function.
- * min_size: minimum component size (enforced by post-processing stage).
- * num_ccs: number of connected components in the segmentation.
+ * Returns the smoothed r, g and b values of each pixel, in row major order.
+ *
+ * im: image to smooth.
+ * sigma: of the gaussian filter.
  */
-void segment_image(image<rgb> *im, float sigma, float c, int min_size,
-			  int *num_ccs, uint32_t *output) {
+static float *smooth_rgb(image<rgb> *im, float sigma) {
   int width = im->width();
   int height = im->height();
+  int n = width * height;
+  std::vector<float> mask = make_fgauss(sigma);
+  normalize(mask);
 
-  image<float> *r = new image<float>(width, height);
-  image<float> *g = new image<float>(width, height);
-  image<float> *b = new image<float>(width, height);
-
-  // smooth each color channel  
+  // the channels, one after the other
+  float *chan = new float[3*n];
   for (int y = 0; y < height; y++) {
     for (int x = 0; x < width; x++) {
-      imRef(r, x, y) = imRef(im, x, y).r;
-      imRef(g, x, y) = imRef(im, x, y).g;
-      imRef(b, x, y) = imRef(im, x, y).b;
+      rgb v = imRef(im, x, y);
+      chan[y*width + x] = v.r;
+      chan[n + y*width + x] = v.g;
+      chan[2*n + y*width + x] = v.b;
     }
   }
-  image<float> *smooth_r = smooth(r, sigma);
-  image<float> *smooth_g = smooth(g, sigma);
-  image<float> *smooth_b = smooth(b, sigma);
-  delete r;
-  delete g;
-  delete b;
- 
-  // build graph
-  edge *edges = new edge[width*height*4];
-  int num = 0;
+
+  // convolve the rows, giving the columns of each channel, then those,
+  // giving the channels of each pixel
+  float *out = new float[3*n];
+  convolve_even_rows(chan, out, width, 3*height, mask);
+  convolve_even_rows(out, chan, height, 3*width, mask);
+  delete [] out;
+  return chan;
+}
+
+// edge between pixels a and b, weighted as diff
+static inline void make_edge(edge *e, const float *smooth, int a, int b) {
+  const float *p = &smooth[3*a];
+  const float *q = &smooth[3*b];
+  e->a = a;
+  e->b = b;
+  e->w = sqrt(square(p[0]-q[0]) + square(p[1]-q[1]) + square(p[2]-q[2]));
+}
+
+/*
+ * Build the 8-neighbour graph of an image
+ *
+ * Edges are generated in the same order as segment_image, row by row, the
+ * rows in parallel.
+ *
+ * Returns the number of edges.
+ *
+ * smooth: smoothed r, g and b values of each pixel, as output by smooth_rgb.
+ * edges: array of at least width*height*4 edges.
+ */
+static int build_graph(const float *smooth, int width, int height,
+		       edge *edges) {
+  int n = width * height;
+
+  // first edge of each row
+  std::vector<int> start(height+1);
+  start[0] = 0;
   for (int y = 0; y < height; y++) {
+    int num = width-1;
+    if (y < height-1)
+      num += width + width-1;
+    if (y > 0)
+      num += width-1;
+    start[y+1] = start[y] + num;
+  }
+
+  int y;
+#pragma omp parallel for if (n > 10000) num_threads(omp_get_num_procs()) default(shared) private(y)
+  for (y = 0; y < height; y++) {
+    edge *e = &edges[start[y]];
     for (int x = 0; x < width; x++) {
-      if (x < width-1) {
-	edges[num].a = y * width + x;
-	edges[num].b = y * width + (x+1);
-	edges[num].w = diff(smooth_r, smooth_g, smooth_b, x, y, x+1, y);
-	num++;
-      }
+      int i = y * width + x;
+      if (x < width-1)
+	make_edge(e++, smooth, i, i+1);
+      if (y < height-1)
+	make_edge(e++, smooth, i, i+width);
+      if ((x < width-1) && (y < height-1))
+	make_edge(e++, smooth, i, i+width+1);
+      if ((x < width-1) && (y > 0))
+	make_edge(e++, smooth, i, i-width+1);
+    }
+  }
+  return start[height];
+}
 
-      if (y < height-1) {
-	edges[num].a = y * width + x;
-	edges[num].b = (y+1) * width + x;
-	edges[num].w = diff(smooth_r, smooth_g, smooth_b, x, y, x, y+1);
-	num++;
-      }
+/*
+ * Segment an image for several thresholds
+ *
+ * The image is smoothed and its edges sorted once, then segmented for each
+ * threshold constant, in parallel.
+ *
+ * im: image to segment.
+ * sigma: to smooth the image.
+ * c: constants for treshold function.
+ * min_size: minimum component size for each constant (enforced by
+ *           post-processing stage).
+ * num_c: number of constants.
+ * num_ccs: number of connected components in each segmentation.
+ * output: num_c height x width segmentations (column major), giving the
+ *         component of each pixel.
+ */
+void segment_image_multi(image<rgb> *im, float sigma, const float *c,
+			 const int *min_size, int num_c, int *num_ccs,
+			 uint32_t *output) {
+  int width = im->width();
+  int height = im->height();
 
-      if ((x < width-1) && (y < height-1)) {
-	edges[num].a = y * width + x;
-	edges[num].b = (y+1) * width + (x+1);
-	edges[num].w = diff(smooth_r, smooth_g, smooth_b, x, y, x+1, y+1);
-	num++;
-      }
+  // smooth each color channel  
+  float *smooth = smooth_rgb(im, sigma);
 
-      if ((x < width-1) && (y > 0)) {
-	edges[num].a = y * width + x;
-	edges[num].b = (y-1) * width + (x+1);
-	edges[num].w = diff(smooth_r, smooth_g, smooth_b, x, y, x+1, y-1);
-	num++;
-      }
+  // build graph
+  edge *edges = new edge[width*height*4];
+  int num = build_graph(smooth, width, height, edges);
+  delete [] smooth;
+  sort_edges(num, edges);
+
+  int k;
+#pragma omp parallel for if (num_c > 1) num_threads(omp_get_num_procs()) default(shared) private(k)
+  for (k = 0; k < num_c; k++) {
+    // segment
+    universe *u = segment_sorted_graph(width*height, num, edges, c[k]);
+
+    // post process small components
+    for (int i = 0; i < num; i++) {
+      int a = u->find(edges[i].a);
+      int b = u->find(edges[i].b);
+      if ((a != b) && ((u->size(a) < min_size[k]) || (u->size(b) < min_size[k])))
+	u->join(a, b);
     }
-  }
-  delete smooth_r;
-  delete smooth_g;
-  delete smooth_b;
+    num_ccs[k] = u->num_sets();
 
-  // segment
-  universe *u = segment_graph(width*height, num, edges, c);
-  
-  // post process small components
-  for (int i = 0; i < num; i++) {
-    int a = u->find(edges[i].a);
-    int b = u->find(edges[i].b);
-    if ((a != b) && ((u->size(a) < min_size) || (u->size(b) < min_size)))
-      u->join(a, b);
+    // output the regions
+    uint32_t *out = &output[k * width * height];
+    for (int y = 0; y < height-1; y++) {
+      for (int x = 0; x < width-1; x++) {
+	out[x * height + y] = (uint32_t)u->find(y * width + x);
+      }
+    }  
+    delete u;
   }
   delete [] edges;
-  *num_ccs = u->num_sets();
-  
-  // output the regions
-  for (int y = 0; y < height-1; y++) {
-    for (int x = 0; x < width-1; x++) {
-      output[x * height + y] = (uint32_t)u->find(y * width + x);
-    }
-  }  
-
-  delete u;
-
   return;
 }
 
+/*
+ * Segment an image
+ *
+ * im: image to segment.
+ * sigma: to smooth the image.
+ * c: constant for treshold function.
+ * min_size: minimum component size (enforced by post-processing stage).
+ * num_ccs: number of connected components in the segmentation.
+ * output: height x width segmentation (column major), giving the component
+ *         of each pixel.
+ */
+void segment_image(image<rgb> *im, float sigma, float c, int min_size,
+			  int *num_ccs, uint32_t *output) {
+  segment_image_multi(im, sigma, &c, &min_size, 1, num_ccs, output);
+}
+
 #endif
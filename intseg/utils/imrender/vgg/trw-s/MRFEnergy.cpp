@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <algorithm>
 #include "MRFEnergy.h"
 
 void DefaultErrorFn(char* msg)
@@ -15,17 +16,31 @@ template <class T> MRFEnergy<T>::MRFEnergy(GlobalSize Kglobal, ErrorFunction err
 	  m_mallocBlockFirst(NULL),
 	  m_nodeFirst(NULL),
 	  m_nodeLast(NULL),
+	  m_nodeIndex(NULL),
+	  m_nodeIndexSize(0),
 	  m_nodeNum(0),
 	  m_edgeNum(0),
 	  m_Kglobal(Kglobal),
 	  m_vectorMaxSizeInBytes(0),
 	  m_isEnergyConstructionCompleted(false),
-	  m_buf(NULL)
+	  m_buf(NULL),
+	  m_bufSizeInBytes(0),
+	  m_levelNodes(NULL),
+	  m_levelFirst(NULL),
+	  m_levelNum(0),
+	  m_levelLowerBound(NULL),
+	  m_threadBuf(NULL),
+	  m_threadBufNum(0)
 {
 }
 
 template <class T> MRFEnergy<T>::~MRFEnergy<T>()
 {
+	delete [] m_nodeIndex;
+	delete [] m_levelNodes;
+	delete [] m_levelFirst;
+	delete [] m_levelLowerBound;
+	delete [] m_threadBuf;
 	while (m_mallocBlockFirst)
 	{
 		MallocBlock* next = m_mallocBlockFirst->m_next;
@@ -70,23 +85,40 @@ template <class T> typename MRFEnergy<T>::NodeId MRFEnergy<T>::AddNode(LocalSize
 	m_nodeLast = i;
 	i->m_next = NULL;
 
+	if (m_nodeIndexSize == m_nodeNum)
+	{
+		m_nodeIndexSize = (m_nodeIndexSize < 1024) ? 1024 : 2*m_nodeIndexSize;
+		Node** nodeIndex = new Node*[m_nodeIndexSize];
+		if (!nodeIndex) m_errorFn("Not enough memory");
+		if (m_nodeNum > 0)
+		{
+			memcpy(nodeIndex, m_nodeIndex, m_nodeNum*sizeof(Node*));
+		}
+		delete [] m_nodeIndex;
+		m_nodeIndex = nodeIndex;
+	}
+	m_nodeIndex[m_nodeNum] = i;
+
 	i->m_ordering = m_nodeNum ++;
 
-	return i;
+	return i->m_ordering;
 }
 
-template <class T> void MRFEnergy<T>::AddNodeData(NodeId i, NodeData data)
+template <class T> void MRFEnergy<T>::AddNodeData(NodeId _i, NodeData data)
 {
+	Node* i = m_nodeIndex[_i];
 	i->m_D.Add(m_Kglobal, i->m_K, data);
 }
 
-template <class T> void MRFEnergy<T>::AddEdge(NodeId i, NodeId j, EdgeData data)
+template <class T> void MRFEnergy<T>::AddEdge(NodeId _i, NodeId _j, EdgeData data)
 {
 	if (m_isEnergyConstructionCompleted)
 	{
 		m_errorFn("Error in AddNode(): graph construction completed - nodes cannot be added");
 	}
 
+	Node* i = m_nodeIndex[_i];
+	Node* j = m_nodeIndex[_j];
 	MRFEdge* e;
 
 	int actualEdgeSize = Edge::GetSizeInBytes(m_Kglobal, i->m_K, j->m_K, data);
@@ -96,6 +128,7 @@ template <class T> void MRFEnergy<T>::AddEdge(NodeId i, NodeId j, EdgeData data)
 	}
 	int MRFedgeSize = sizeof(MRFEdge) - sizeof(Edge) + actualEdgeSize;
 	e = (MRFEdge*) Malloc(MRFedgeSize);
+	e->m_sizeInBytes = MRFedgeSize;
 
 	e->m_message.Initialize(m_Kglobal, i->m_K, j->m_K, data, &i->m_D, &j->m_D);
 
@@ -152,9 +185,6 @@ template <class T> void MRFEnergy<T>::CompleteGraphConstruction()
 	{
 		m_errorFn("CompleteGraphConstruction(): fatal error");
 	}
-	m_buf = (char *) Malloc(m_vectorMaxSizeInBytes + 
-		( m_vectorMaxSizeInBytes > Edge::GetBufSizeInBytes(m_vectorMaxSizeInBytes) ?
-		  m_vectorMaxSizeInBytes : Edge::GetBufSizeInBytes(m_vectorMaxSizeInBytes) ) );
 
 	// set forward and backward edges properly
 #ifdef _DEBUG
@@ -221,6 +251,13 @@ template <class T> void MRFEnergy<T>::CompleteGraphConstruction()
 		}
 	}
 
+	CompactGraph();
+
+	m_bufSizeInBytes = m_vectorMaxSizeInBytes + 
+		( m_vectorMaxSizeInBytes > Edge::GetBufSizeInBytes(m_vectorMaxSizeInBytes) ?
+		  m_vectorMaxSizeInBytes : Edge::GetBufSizeInBytes(m_vectorMaxSizeInBytes) );
+	m_buf = (char *) Malloc(m_bufSizeInBytes);
+
 	m_isEnergyConstructionCompleted = true;
 
 	ZeroMessages();
@@ -228,4 +265,181 @@ template <class T> void MRFEnergy<T>::CompleteGraphConstruction()
 	//printf("done\n");
 }
 
+/////////////////////////////////////////////////////////////////////////////////
+
+// size of an element in the compact blocks (rounded up so that doubles stay aligned)
+static inline int CompactSize(int bytesNum)
+{
+	return (bytesNum + 7) & ~7;
+}
+
+// index of the block containing ptr, in blocks sorted by address
+template <class B> static int FindBlock(B** blocks, int blockNum, char* ptr)
+{
+	int lo = 0, hi = blockNum - 1;
+	while (lo < hi)
+	{
+		int mid = (lo + hi + 1) / 2;
+		if ((char*)blocks[mid] <= ptr) lo = mid;
+		else                           hi = mid - 1;
+	}
+	return lo;
+}
+
+// Nodes and edges are allocated in the order in which the user adds them, which
+// after SetAutomaticOrdering() (or for edges added in any order) has little to do
+// with the order in which Minimize_TRW_S() and Minimize_BP() visit them.
+// This function copies the nodes into large blocks in the order of m_ordering,
+// followed by the forward edges of each node (so that the edges visited at a node
+// are contiguous too). Each block used during construction is freed as soon as
+// everything in it has been copied, so the graph is not held twice in memory.
+// Backward edge lists are rebuilt in order of increasing tail ordering.
+template <class T> void MRFEnergy<T>::CompactGraph()
+{
+	Node* i;
+	Node* iNew;
+	MRFEdge* e;
+	MRFEdge* eNext;
+	MRFEdge* eNew;
+	MallocBlock* b;
+	int blockNum = 0, edgeNum = 0, k, n;
+
+	if (m_nodeNum == 0)
+	{
+		return;
+	}
+
+	// construction blocks, sorted by address
+	for (b=m_mallocBlockFirst; b; b=b->m_next)
+	{
+		blockNum ++;
+	}
+	MallocBlock** blocks = new MallocBlock*[blockNum];
+	int* blockCount = new int[blockNum]; // number of nodes and edges not yet copied out of each block
+	for (b=m_mallocBlockFirst, n=0; b; b=b->m_next)
+	{
+		blocks[n++] = b;
+	}
+	std::sort(blocks, blocks+blockNum);
+	memset(blockCount, 0, blockNum*sizeof(int));
+	m_mallocBlockFirst = NULL;
+
+	// old location of the node with ordering k is newNodes[k], until it is copied
+	Node** newNodes = new Node*[m_nodeNum];
+	for (i=m_nodeFirst; i; i=i->m_next)
+	{
+		newNodes[i->m_ordering] = i;
+		blockCount[FindBlock(blocks, blockNum, (char*)i)] ++;
+		for (e=i->m_firstForward; e; e=e->m_nextForward)
+		{
+			blockCount[FindBlock(blocks, blockNum, (char*)e)] ++;
+			edgeNum ++;
+		}
+	}
+	// ordering of each user id, and of the head of each forward edge in the order of copying
+	int* nodeOrdering = new int[m_nodeNum];
+	int* headOrdering = new int[edgeNum];
+	for (k=0; k<m_nodeNum; k++)
+	{
+		nodeOrdering[k] = m_nodeIndex[k]->m_ordering;
+	}
+	for (k=0, n=0; k<m_nodeNum; k++)
+	{
+		for (e=newNodes[k]->m_firstForward; e; e=e->m_nextForward)
+		{
+			headOrdering[n++] = e->m_head->m_ordering;
+		}
+	}
+
+	// nodes (the new nodes still point to the old edges)
+	for (k=0; k<m_nodeNum; k++)
+	{
+		i = newNodes[k];
+		int size = sizeof(Node) - sizeof(Vector) + Vector::GetSizeInBytes(m_Kglobal, i->m_K);
+		iNew = (Node*) Malloc(CompactSize(size), MallocBlock::compactBlockSizeInBytes);
+		memcpy(iNew, i, size);
+		newNodes[k] = iNew;
+		ReleaseBlockElement((char*)i, blocks, blockCount, blockNum);
+	}
+	// user ids -> new nodes
+	for (k=0; k<m_nodeNum; k++)
+	{
+		m_nodeIndex[k] = newNodes[nodeOrdering[k]];
+	}
+
+	// link the nodes and copy the forward edges
+	for (k=0, n=0; k<m_nodeNum; k++)
+	{
+		iNew = newNodes[k];
+		iNew->m_prev = (k > 0) ? newNodes[k-1] : NULL;
+		iNew->m_next = (k+1 < m_nodeNum) ? newNodes[k+1] : NULL;
+		iNew->m_firstBackward = NULL;
+
+		MRFEdge** ePrevNext = &iNew->m_firstForward;
+		for (e=iNew->m_firstForward; e; e=eNext)
+		{
+			eNext = e->m_nextForward;
+			eNew = (MRFEdge*) Malloc(CompactSize(e->m_sizeInBytes), MallocBlock::compactBlockSizeInBytes);
+			memcpy(eNew, e, e->m_sizeInBytes);
+			ReleaseBlockElement((char*)e, blocks, blockCount, blockNum);
+
+			eNew->m_tail = iNew;
+			eNew->m_head = newNodes[headOrdering[n++]];
+			*ePrevNext = eNew;
+			ePrevNext = &eNew->m_nextForward;
+		}
+		*ePrevNext = NULL;
+	}
+	m_nodeFirst = newNodes[0];
+	m_nodeLast = newNodes[m_nodeNum-1];
+
+	// backward edges
+	MRFEdge** lastBackward = (MRFEdge**) newNodes; // reuse memory: last backward edge of each node
+	for (k=0; k<m_nodeNum; k++)
+	{
+		lastBackward[k] = NULL;
+	}
+	for (i=m_nodeFirst; i; i=i->m_next)
+	{
+		for (e=i->m_firstForward; e; e=e->m_nextForward)
+		{
+			int kHead = e->m_head->m_ordering;
+			if (lastBackward[kHead])
+			{
+				lastBackward[kHead]->m_nextBackward = e;
+			}
+			else
+			{
+				e->m_head->m_firstBackward = e;
+			}
+			lastBackward[kHead] = e;
+			e->m_nextBackward = NULL;
+		}
+	}
+	delete [] newNodes;
+	delete [] nodeOrdering;
+	delete [] headOrdering;
+
+	// free the construction blocks that held nothing to copy
+	for (n=0; n<blockNum; n++)
+	{
+		if (blockCount[n] >= 0)
+		{
+			delete [] (char*) blocks[n];
+		}
+	}
+	delete [] blocks;
+	delete [] blockCount;
+}
+
+template <class T> void MRFEnergy<T>::ReleaseBlockElement(char* ptr, MallocBlock** blocks, int* blockCount, int blockNum)
+{
+	int n = FindBlock(blocks, blockNum, ptr);
+	if (--blockCount[n] == 0)
+	{
+		delete [] (char*) blocks[n];
+		blockCount[n] = -1; // freed (the address is kept for FindBlock())
+	}
+}
+
 #include "instances.inc"
@@ -35,7 +35,7 @@ public:
 	typedef typename T::NodeData   NodeData;
 	typedef typename T::EdgeData   EdgeData;
 
-	typedef Node* NodeId;
+	typedef int NodeId; // index of the node, in the order in which nodes were added
 	typedef void (*ErrorFunction)(char* msg);
 
 	// Constructor. Function errorFn is called with an error message, if an error occurs.
@@ -76,10 +76,18 @@ public:
 	// By default nodes are processed in the order in which they were added.
 	// The function below permutes this order using certain heuristics.
 	// It may speed up the algorithm if, for example, the original order is random.
+	// All orderings take time linear in the number of nodes and edges.
+	enum OrderingType
+	{
+		ORDERING_MIN_DEGREE, // greedy: the node with fewest edges to unordered nodes, among the neighbours of ordered nodes
+		ORDERING_RASTER,     // order in which the nodes were added (e.g. raster order for grids)
+		ORDERING_BFS,        // breadth first search from the first node of each connected component
+		ORDERING_RCM         // reverse Cuthill-McKee
+	};
 	// 
 	// Completes energy construction.
 	// Cannot be called after energy construction is completed.
-	void SetAutomaticOrdering();
+	void SetAutomaticOrdering(OrderingType type = ORDERING_MIN_DEGREE);
 
 	// The structure below specifies (1) stopping criteria and 
 	// (2) how often to compute solution and print its energy.
@@ -89,14 +97,22 @@ public:
 		{
 			// default parameters
 			m_eps = 0; // not used
+			m_gap = -1;
+			m_timeMax = 0;
 			m_iterMax = 1000000;
 			m_printIter = 1000;     // After 10 iterations start printing the lower bound
 			m_printMinIter = 1000; // and the energy every 5 iterations.
+			m_numThreads = 1;
+			m_verbose = true;
+			m_traceLowerBound = m_traceEnergy = m_traceTime = NULL;
 		}
 
 		// stopping criterion
 		REAL		m_eps; // stop if the increase in the lower bound during one iteration is less or equal than m_eps.
 						   // Used only if m_eps >= 0, and only for TRW-S algorithm.
+		REAL		m_gap; // stop if energy - lower bound <= m_gap, checked whenever the energy is computed.
+						   // Used only if m_gap >= 0, and only for TRW-S algorithm.
+		double		m_timeMax; // stop after m_timeMax seconds (wall clock time). Used only if m_timeMax > 0.
 		int			m_iterMax; // maximum number of iterations
 
 		// Option for printing lower bound and the energy.
@@ -104,6 +120,23 @@ public:
 		// (it is comparable to the cost of one iteration).
 		int		m_printIter; // print lower bound and energy every m_printIter iterations
 		int		m_printMinIter; // do not print lower bound and energy before m_printMinIter iterations
+
+		// Number of threads used by Minimize_TRW_S() and Minimize_BP() (requires OpenMP).
+		// Nodes are grouped into levels such that no two nodes of a level share an edge
+		// and every neighbour of a node with smaller m_ordering is in an earlier level.
+		// The nodes of each level are then updated in parallel, which gives exactly
+		// the same messages (and monotonicity of the lower bound) as the sequential passes.
+		int		m_numThreads;
+
+		// If false, nothing is printed (e.g. when several energies are minimized in parallel).
+		bool	m_verbose;
+
+		// If not NULL, element iter-1 of these arrays (of size m_iterMax) is set after each iteration
+		// to the lower bound (TRW-S only), the energy (NaN if not computed in that iteration)
+		// and the time in seconds since the start of the minimization.
+		double*	m_traceLowerBound;
+		double*	m_traceEnergy;
+		double*	m_traceTime;
 	};
 
 	// Returns number of iterations. Sets lowerBound and energy.
@@ -148,6 +181,8 @@ private:
 	MallocBlock*	m_mallocBlockFirst;
 	Node*			m_nodeFirst;
 	Node*			m_nodeLast;
+	Node**			m_nodeIndex; // m_nodeIndex[NodeId] is the node (moved by CompleteGraphConstruction())
+	int				m_nodeIndexSize; // allocated size of m_nodeIndex
 	int				m_nodeNum;
 	int				m_edgeNum;
 	GlobalSize		m_Kglobal;
@@ -157,11 +192,30 @@ private:
 
 	char*			m_buf; // buffer of size m_vectorMaxSizeInBytes 
 					       //              + max(m_vectorMaxSizeInBytes, Edge::GetBufSizeInBytes(m_vectorMaxSizeInBytes))
+	int				m_bufSizeInBytes; // size of m_buf
+
+	// parallel schedule (see Options::m_numThreads), built on first use
+	Node**			m_levelNodes; // nodes sorted by level, and by m_ordering within a level
+	int*			m_levelFirst; // nodes of level l are m_levelNodes[m_levelFirst[l]] ... m_levelNodes[m_levelFirst[l+1]-1]
+	int				m_levelNum;
+	REAL*			m_levelLowerBound; // lower bound contribution of each node in the parallel backward pass, indexed by m_ordering
+	char*			m_threadBuf; // one buffer of the same size as m_buf for each thread
+	int				m_threadBufNum;
 
 	void CompleteGraphConstruction(); // nodes and edges cannot be added after calling this function
+	void CompactGraph(); // moves nodes and edges into contiguous memory, following the node ordering
 	void SetMonotonicTrees();
+	void SetParallelSchedule(int threadNum); // builds the levels and thread buffers
+
+	// Message passing at a single node: sends messages to nodes with greater m_ordering (forward)
+	// or smaller m_ordering (backward). For TRW-S the backward update returns its contribution
+	// to the lower bound.
+	void UpdateForward(Node* i, Vector* Di, void* buf, bool isTRW);
+	REAL UpdateBackward(Node* i, Vector* Di, void* buf, bool isTRW);
+	void ParallelPasses(int threadNum, bool isTRW, REAL& lowerBound); // one forward and one backward pass over the levels
 
 	REAL ComputeSolutionAndEnergy(); // sets Node::m_solution, returns value of the energy
+	void Trace(Options& options, int iter, double lowerBound, double energy, double time); // records one iteration in the m_trace* arrays
 
 
 
@@ -191,6 +245,8 @@ private:
 		REAL		m_gammaForward; // = rho_{ij} / rho_{i} where i=m_tail, j=m_head
 		REAL		m_gammaBackward; // = rho_{ij} / rho_{j} where i=m_tail, j=m_head
 
+		int			m_sizeInBytes; // size of this MRFEdge, including the variable sized m_message
+
 		Edge		m_message; // must be the last member in the struct since its size is not fixed.
 					           // Stores edge information and either forward or backward message.
 					           // Most of the time it's the backward message; it gets replaced
@@ -203,21 +259,26 @@ private:
 	struct MallocBlock
 	{
 		static const int minBlockSizeInBytes = 4096 - 3*sizeof(void*);
+		static const int compactBlockSizeInBytes = (1<<20) - 3*sizeof(void*); // used by CompactGraph()
 		MallocBlock*	m_next;
 		char*			m_current; // first element of available memory in this block
 		char*			m_last; // first element outside of allocated memory for this block
 	};
-	char* Malloc(int bytesNum); 
+	char* Malloc(size_t bytesNum, size_t minBlockSize = MallocBlock::minBlockSizeInBytes); 
+
+	// Used by CompactGraph(): one fewer element left in the construction block containing ptr
+	// (blocks are sorted by address), which is freed when it becomes empty
+	void ReleaseBlockElement(char* ptr, MallocBlock** blocks, int* blockCount, int blockNum);
 };
 
 
 
 
-template <class T> inline char* MRFEnergy<T>::Malloc(int bytesNum)
+template <class T> inline char* MRFEnergy<T>::Malloc(size_t bytesNum, size_t minBlockSize)
 {
-	if (!m_mallocBlockFirst || m_mallocBlockFirst->m_current+bytesNum > m_mallocBlockFirst->m_last)
+	if (!m_mallocBlockFirst || bytesNum > (size_t)(m_mallocBlockFirst->m_last - m_mallocBlockFirst->m_current))
 	{
-		int size = (bytesNum > MallocBlock::minBlockSizeInBytes) ? bytesNum : MallocBlock::minBlockSizeInBytes;
+		size_t size = (bytesNum > minBlockSize) ? bytesNum : minBlockSize;
 		MallocBlock* b = (MallocBlock*) new char[sizeof(MallocBlock) + size];
 		if (!b) m_errorFn("Not enough memory");
 		b->m_current = (char*) b + sizeof(MallocBlock);
@@ -234,7 +295,7 @@ template <class T> inline char* MRFEnergy<T>::Malloc(int bytesNum)
 
 template <class T> inline typename MRFEnergy<T>::Label MRFEnergy<T>::GetSolution(NodeId i)
 {
-	return i->m_solution;
+	return m_nodeIndex[i]->m_solution;
 }
 
 #endif
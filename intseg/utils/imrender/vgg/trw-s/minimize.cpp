@@ -3,13 +3,169 @@
 #include <stdlib.h>
 #include <assert.h>
 #include "MRFEnergy.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
+// Wall clock time in seconds
+static double GetTime()
+{
+#ifdef _WIN32
+	LARGE_INTEGER t, f;
+	QueryPerformanceCounter(&t);
+	QueryPerformanceFrequency(&f);
+	return (double)t.QuadPart / (double)f.QuadPart;
+#else
+	struct timeval t;
+	gettimeofday(&t, NULL);
+	return t.tv_sec + 1e-6*t.tv_usec;
+#endif
+}
 
-template <class T> int MRFEnergy<T>::Minimize_TRW_S(Options& options, REAL& lowerBound, REAL& energy)
+template <class T> inline void MRFEnergy<T>::UpdateForward(Node* i, Vector* Di, void* buf, bool isTRW)
+{
+	MRFEdge* e;
+
+	Di->Copy(m_Kglobal, i->m_K, &i->m_D);
+	for (e=i->m_firstForward; e; e=e->m_nextForward)
+	{
+		Di->Add(m_Kglobal, i->m_K, e->m_message.GetMessagePtr());
+	}
+	for (e=i->m_firstBackward; e; e=e->m_nextBackward)
+	{
+		Di->Add(m_Kglobal, i->m_K, e->m_message.GetMessagePtr());
+	}
+
+	// normalize Di, update lower bound
+	// vMin = Di->ComputeAndSubtractMin(m_Kglobal, i->m_K); // do not compute lower bound
+	// lowerBound += vMin;                                  // during the forward pass
+
+	// pass messages from i to nodes with higher m_ordering
+	for (e=i->m_firstForward; e; e=e->m_nextForward)
+	{
+		assert(e->m_tail == i);
+
+		e->m_message.UpdateMessage(m_Kglobal, i->m_K, e->m_head->m_K, Di, isTRW ? e->m_gammaForward : 1, 0, buf);
+
+		// lowerBound += vMin; // do not compute lower bound during the forward pass
+	}
+}
+
+template <class T> inline typename T::REAL MRFEnergy<T>::UpdateBackward(Node* i, Vector* Di, void* buf, bool isTRW)
+{
+	MRFEdge* e;
+	REAL lowerBound = 0;
+
+	Di->Copy(m_Kglobal, i->m_K, &i->m_D);
+	for (e=i->m_firstBackward; e; e=e->m_nextBackward)
+	{
+		Di->Add(m_Kglobal, i->m_K, e->m_message.GetMessagePtr());
+	}
+	for (e=i->m_firstForward; e; e=e->m_nextForward)
+	{
+		Di->Add(m_Kglobal, i->m_K, e->m_message.GetMessagePtr());
+	}
+
+	// normalize Di, update lower bound
+	if (isTRW)
+	{
+		lowerBound += Di->ComputeAndSubtractMin(m_Kglobal, i->m_K);
+	}
+
+	// pass messages from i to nodes with smaller m_ordering
+	for (e=i->m_firstBackward; e; e=e->m_nextBackward)
+	{
+		assert(e->m_head == i);
+
+		REAL vMin = e->m_message.UpdateMessage(m_Kglobal, i->m_K, e->m_tail->m_K, Di, isTRW ? e->m_gammaBackward : 1, 1, buf);
+
+		if (isTRW)
+		{
+			lowerBound += vMin;
+		}
+	}
+
+	return lowerBound;
+}
+
+template <class T> void MRFEnergy<T>::SetParallelSchedule(int threadNum)
 {
 	Node* i;
-	Node* j;
 	MRFEdge* e;
-	REAL vMin;
+	int l, k;
+
+	if (!m_levelNodes)
+	{
+		// level of i = 1 + maximum level of the nodes with smaller m_ordering connected to i
+		int* level = new int[m_nodeNum];
+		m_levelNum = 0;
+		for (i=m_nodeFirst; i; i=i->m_next)
+		{
+			l = 0;
+			for (e=i->m_firstBackward; e; e=e->m_nextBackward)
+			{
+				if (l < level[e->m_tail->m_ordering] + 1)
+				{
+					l = level[e->m_tail->m_ordering] + 1;
+				}
+			}
+			level[i->m_ordering] = l;
+			if (m_levelNum < l + 1)
+			{
+				m_levelNum = l + 1;
+			}
+		}
+
+		// counting sort of the nodes by level
+		m_levelNodes = new Node*[m_nodeNum];
+		m_levelFirst = new int[m_levelNum+1];
+		memset(m_levelFirst, 0, (m_levelNum+1)*sizeof(int));
+		for (k=0; k<m_nodeNum; k++)
+		{
+			m_levelFirst[level[k]+1] ++;
+		}
+		for (l=0; l<m_levelNum; l++)
+		{
+			m_levelFirst[l+1] += m_levelFirst[l];
+		}
+		for (i=m_nodeFirst; i; i=i->m_next)
+		{
+			m_levelNodes[m_levelFirst[level[i->m_ordering]] ++] = i;
+		}
+		for (l=m_levelNum; l>0; l--)
+		{
+			m_levelFirst[l] = m_levelFirst[l-1];
+		}
+		m_levelFirst[0] = 0;
+
+		m_levelLowerBound = new REAL[m_nodeNum];
+
+		delete [] level;
+	}
+
+	if (m_threadBufNum < threadNum)
+	{
+		delete [] m_threadBuf;
+		m_threadBuf = new char[threadNum*m_bufSizeInBytes];
+		m_threadBufNum = threadNum;
+	}
+}
+
+template <class T> void MRFEnergy<T>::Trace(Options& options, int iter, double lowerBound, double energy, double time)
+{
+	if (options.m_traceLowerBound) options.m_traceLowerBound[iter-1] = lowerBound;
+	if (options.m_traceEnergy)     options.m_traceEnergy[iter-1]     = energy;
+	if (options.m_traceTime)       options.m_traceTime[iter-1]       = time;
+}
+
+template <class T> int MRFEnergy<T>::Minimize_TRW_S(Options& options, REAL& lowerBound, REAL& energy)
+{
+	Node* i;
 	int iter;
 	REAL lowerBoundPrev;
 
@@ -25,73 +181,47 @@ template <class T> int MRFEnergy<T>::Minimize_TRW_S(Options& options, REAL& lowe
 	Vector* Di = (Vector*) m_buf;
 	void* buf = (void*) (m_buf + m_vectorMaxSizeInBytes);
 
+#ifdef _OPENMP
+	int threadNum = options.m_numThreads;
+	if (threadNum > 1)
+	{
+		SetParallelSchedule(threadNum);
+	}
+#else
+	const int threadNum = 1;
+#endif
+
 	iter = 0;
+	double timeStart = GetTime();
 
 	// main loop
 	for (iter=1; ; iter++)
 	{
-		////////////////////////////////////////////////
-		//                forward pass                //
-		////////////////////////////////////////////////
-		for (i=m_nodeFirst; i; i=i->m_next)
+		if (threadNum > 1)
 		{
-			Di->Copy(m_Kglobal, i->m_K, &i->m_D);
-			for (e=i->m_firstForward; e; e=e->m_nextForward)
-			{
-				Di->Add(m_Kglobal, i->m_K, e->m_message.GetMessagePtr());
-			}
-			for (e=i->m_firstBackward; e; e=e->m_nextBackward)
-			{
-				Di->Add(m_Kglobal, i->m_K, e->m_message.GetMessagePtr());
-			}
-
-			// normalize Di, update lower bound
-			// vMin = Di->ComputeAndSubtractMin(m_Kglobal, i->m_K); // do not compute lower bound
-			// lowerBound += vMin;                                  // during the forward pass
-
-			// pass messages from i to nodes with higher m_ordering
-			for (e=i->m_firstForward; e; e=e->m_nextForward)
-			{
-				assert(e->m_tail == i);
-				j = e->m_head;
-
-				vMin = e->m_message.UpdateMessage(m_Kglobal, i->m_K, j->m_K, Di, e->m_gammaForward, 0, buf);
-
-				// lowerBound += vMin; // do not compute lower bound during the forward pass
-			}
+			lowerBound = 0;
+			ParallelPasses(threadNum, true, lowerBound);
 		}
-
-		////////////////////////////////////////////////
-		//               backward pass                //
-		////////////////////////////////////////////////
-		lowerBound = 0;
-
-		for (i=m_nodeLast; i; i=i->m_prev)
+		else
 		{
-			Di->Copy(m_Kglobal, i->m_K, &i->m_D);
-			for (e=i->m_firstBackward; e; e=e->m_nextBackward)
-			{
-				Di->Add(m_Kglobal, i->m_K, e->m_message.GetMessagePtr());
-			}
-			for (e=i->m_firstForward; e; e=e->m_nextForward)
+			////////////////////////////////////////////////
+			//                forward pass                //
+			////////////////////////////////////////////////
+			for (i=m_nodeFirst; i; i=i->m_next)
 			{
-				Di->Add(m_Kglobal, i->m_K, e->m_message.GetMessagePtr());
+				UpdateForward(i, Di, buf, true);
 			}
 
-			// normalize Di, update lower bound
-			vMin = Di->ComputeAndSubtractMin(m_Kglobal, i->m_K);
-			lowerBound += vMin;
+			////////////////////////////////////////////////
+			//               backward pass                //
+			////////////////////////////////////////////////
+			double lowerBoundSum = 0; // summed in double precision, also for float REAL
 
-			// pass messages from i to nodes with smaller m_ordering
-			for (e=i->m_firstBackward; e; e=e->m_nextBackward)
+			for (i=m_nodeLast; i; i=i->m_prev)
 			{
-				assert(e->m_head == i);
-				j = e->m_tail;
-
-				vMin = e->m_message.UpdateMessage(m_Kglobal, i->m_K, j->m_K, Di, e->m_gammaBackward, 1, buf);
-
-				lowerBound += vMin;
+				lowerBoundSum += UpdateBackward(i, Di, buf, true);
 			}
+			lowerBound = (REAL)lowerBoundSum;
 		}
 
 		////////////////////////////////////////////////
@@ -110,17 +240,28 @@ template <class T> int MRFEnergy<T>::Minimize_TRW_S(Options& options, REAL& lowe
 			}
 			lowerBoundPrev = lowerBound;
 		}
+		if (options.m_timeMax > 0 && GetTime() - timeStart >= options.m_timeMax)
+		{
+			finishFlag = true;
+		}
 
 		// print lower bound and energy, if necessary
-		if (  
-		finishFlag || 
+		bool energyFlag = finishFlag || 
 			( iter>=options.m_printMinIter && 
-			(options.m_printIter<1 || iter%options.m_printIter==0) )
-		)
+			(options.m_printIter<1 || iter%options.m_printIter==0) );
+		if (energyFlag)
 		{
 			energy = ComputeSolutionAndEnergy();
-			printf("iter %d: lower bound = %f, energy = %f\n", iter, lowerBound, energy);
+			if (options.m_verbose)
+			{
+				printf("iter %d: lower bound = %f, energy = %f\n", iter, lowerBound, energy);
+			}
+			if (options.m_gap >= 0 && energy - lowerBound <= options.m_gap)
+			{
+				finishFlag = true;
+			}
 		}
+		Trace(options, iter, (double)lowerBound, energyFlag ? (double)energy : mxGetNaN(), GetTime() - timeStart);
 
 		// if finishFlag==true terminate
 		if (finishFlag)
@@ -135,9 +276,6 @@ template <class T> int MRFEnergy<T>::Minimize_TRW_S(Options& options, REAL& lowe
 template <class T> int MRFEnergy<T>::Minimize_BP(Options& options, REAL& energy)
 {
 	Node* i;
-	Node* j;
-	MRFEdge* e;
-	REAL vMin;
 	int iter;
 
 	if (!m_isEnergyConstructionCompleted)
@@ -145,68 +283,51 @@ template <class T> int MRFEnergy<T>::Minimize_BP(Options& options, REAL& energy)
 		CompleteGraphConstruction();
 	}
 
-	printf("BP algorithm\n");
+	if (options.m_verbose)
+	{
+		printf("BP algorithm\n");
+	}
 
 	Vector* Di = (Vector*) m_buf;
 	void* buf = (void*) (m_buf + m_vectorMaxSizeInBytes);
 
+#ifdef _OPENMP
+	int threadNum = options.m_numThreads;
+	if (threadNum > 1)
+	{
+		SetParallelSchedule(threadNum);
+	}
+#else
+	const int threadNum = 1;
+#endif
+
 	iter = 0;
+	double timeStart = GetTime();
 
 	// main loop
 	for (iter=1; ; iter++)
 	{
-		////////////////////////////////////////////////
-		//                forward pass                //
-		////////////////////////////////////////////////
-		for (i=m_nodeFirst; i; i=i->m_next)
+		if (threadNum > 1)
 		{
-			Di->Copy(m_Kglobal, i->m_K, &i->m_D);
-			for (e=i->m_firstForward; e; e=e->m_nextForward)
-			{
-				Di->Add(m_Kglobal, i->m_K, e->m_message.GetMessagePtr());
-			}
-			for (e=i->m_firstBackward; e; e=e->m_nextBackward)
-			{
-				Di->Add(m_Kglobal, i->m_K, e->m_message.GetMessagePtr());
-			}
-
-			// pass messages from i to nodes with higher m_ordering
-			for (e=i->m_firstForward; e; e=e->m_nextForward)
-			{
-				assert(i == e->m_tail);
-				j = e->m_head;
-
-				const REAL gamma = 1;
-
-				e->m_message.UpdateMessage(m_Kglobal, i->m_K, j->m_K, Di, gamma, 0, buf);
-			}
+			REAL lowerBound = 0;
+			ParallelPasses(threadNum, false, lowerBound);
 		}
-
-		////////////////////////////////////////////////
-		//               backward pass                //
-		////////////////////////////////////////////////
-
-		for (i=m_nodeLast; i; i=i->m_prev)
+		else
 		{
-			Di->Copy(m_Kglobal, i->m_K, &i->m_D);
-			for (e=i->m_firstBackward; e; e=e->m_nextBackward)
-			{
-				Di->Add(m_Kglobal, i->m_K, e->m_message.GetMessagePtr());
-			}
-			for (e=i->m_firstForward; e; e=e->m_nextForward)
+			////////////////////////////////////////////////
+			//                forward pass                //
+			////////////////////////////////////////////////
+			for (i=m_nodeFirst; i; i=i->m_next)
 			{
-				Di->Add(m_Kglobal, i->m_K, e->m_message.GetMessagePtr());
+				UpdateForward(i, Di, buf, false);
 			}
 
-			// pass messages from i to nodes with smaller m_ordering
-			for (e=i->m_firstBackward; e; e=e->m_nextBackward)
+			////////////////////////////////////////////////
+			//               backward pass                //
+			////////////////////////////////////////////////
+			for (i=m_nodeLast; i; i=i->m_prev)
 			{
-				assert(i == e->m_head);
-				j = e->m_tail;
-
-				const REAL gamma = 1;
-
-				vMin = e->m_message.UpdateMessage(m_Kglobal, i->m_K, j->m_K, Di, gamma, 1, buf);
+				UpdateBackward(i, Di, buf, false);
 			}
 		}
 
@@ -218,17 +339,24 @@ template <class T> int MRFEnergy<T>::Minimize_BP(Options& options, REAL& energy)
 		{
 			finishFlag = true;
 		}
+		if (options.m_timeMax > 0 && GetTime() - timeStart >= options.m_timeMax)
+		{
+			finishFlag = true;
+		}
 
 		// print energy, if necessary
-		if (  
-		finishFlag || 
+		bool energyFlag = finishFlag || 
 			( iter>=options.m_printMinIter && 
-			(options.m_printIter<1 || iter%options.m_printIter==0) )
-		)
+			(options.m_printIter<1 || iter%options.m_printIter==0) );
+		if (energyFlag)
 		{
 			energy = ComputeSolutionAndEnergy();
-			printf("iter %d: energy = %f\n", iter, energy);
+			if (options.m_verbose)
+			{
+				printf("iter %d: energy = %f\n", iter, energy);
+			}
 		}
+		Trace(options, iter, 0, energyFlag ? (double)energy : mxGetNaN(), GetTime() - timeStart);
 
 		// if finishFlag==true terminate
 		if (finishFlag)
@@ -240,12 +368,61 @@ template <class T> int MRFEnergy<T>::Minimize_BP(Options& options, REAL& energy)
 	return iter;
 }
 
+template <class T> void MRFEnergy<T>::ParallelPasses(int threadNum, bool isTRW, REAL& lowerBound)
+{
+#ifdef _OPENMP
+	#pragma omp parallel num_threads(threadNum)
+	{
+		char* tbuf = m_threadBuf + omp_get_thread_num()*m_bufSizeInBytes;
+		Vector* Di = (Vector*) tbuf;
+		void* buf = (void*) (tbuf + m_vectorMaxSizeInBytes);
+		int l, k;
+
+		////////////////////////////////////////////////
+		//                forward pass                //
+		////////////////////////////////////////////////
+		for (l=0; l<m_levelNum; l++)
+		{
+			#pragma omp for schedule(static)
+			for (k=m_levelFirst[l]; k<m_levelFirst[l+1]; k++)
+			{
+				UpdateForward(m_levelNodes[k], Di, buf, isTRW);
+			}
+		}
+
+		////////////////////////////////////////////////
+		//               backward pass                //
+		////////////////////////////////////////////////
+		for (l=m_levelNum-1; l>=0; l--)
+		{
+			#pragma omp for schedule(static)
+			for (k=m_levelFirst[l]; k<m_levelFirst[l+1]; k++)
+			{
+				m_levelLowerBound[m_levelNodes[k]->m_ordering] = UpdateBackward(m_levelNodes[k], Di, buf, isTRW);
+			}
+		}
+	}
+
+	// sum the contributions in the order of the sequential backward pass,
+	// so that the bound does not depend on the number of threads
+	if (isTRW)
+	{
+		double lowerBoundSum = 0;
+		for (Node* i=m_nodeLast; i; i=i->m_prev)
+		{
+			lowerBoundSum += m_levelLowerBound[i->m_ordering];
+		}
+		lowerBound += (REAL)lowerBoundSum;
+	}
+#endif
+}
+
 template <class T> typename T::REAL MRFEnergy<T>::ComputeSolutionAndEnergy()
 {
 	Node* i;
 	Node* j;
 	MRFEdge* e;
-	REAL E = 0;
+	double E = 0; // summed in double precision, also for float REAL
 
 	Vector* DiBackward = (Vector*) m_buf; // cost of backward edges plus Di at the node
 	Vector* Di = (Vector*) (m_buf + m_vectorMaxSizeInBytes); // all edges plus Di at the node
@@ -280,7 +457,7 @@ template <class T> typename T::REAL MRFEnergy<T>::ComputeSolutionAndEnergy()
 		E += DiBackward->GetValue(m_Kglobal, i->m_K, i->m_solution);
 	}
 
-	return E;
+	return (REAL)E;
 }
 
 #include "instances.inc"
@@ -2,156 +2,306 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <algorithm>
 #include "MRFEnergy.h"
 
-template <class T> void MRFEnergy<T>::SetAutomaticOrdering()
+// The orderings below work on the graph in compressed form: the neighbours of
+// node i are adj[adjFirst[i]], ..., adj[adjFirst[i+1]-1] (an edge i-j appears
+// once in the list of i and once in the list of j). Each function fills
+// order[0..n-1] with the node indices in the new order.
+
+// Greedy heuristic: repeatedly take the node with the smallest remaining degree
+// (number of edges to nodes not ordered yet) among the unordered neighbours of
+// ordered nodes ('boundary'), or, if there are none, among all unordered nodes.
+// Nodes are kept in buckets indexed by remaining degree, so that the whole
+// ordering takes O(n + number of edges).
+static void OrderMinDegree(int n, const int* adjFirst, const int* adj, int* order)
 {
-	int dMin;
-	Node* i;
-	Node* iMin;
-	Node* list;
-	Node* listBoundary;
-	MRFEdge* e;
+	int i, j, k, d, dMax = 0;
 
-	if (m_isEnergyConstructionCompleted)
+	for (i=0; i<n; i++)
 	{
-		m_errorFn("Error in SetAutomaticOrdering(): function cannot be called after graph construction is completed");
+		if (dMax < adjFirst[i+1] - adjFirst[i])
+		{
+			dMax = adjFirst[i+1] - adjFirst[i];
+		}
 	}
 
-	printf("Setting automatic ordering... ");
+	int* degree = new int[4*n + 2*(dMax+1)];
+	int* state = degree + n; // 0: unordered, 1: boundary, 2: ordered
+	int* next = state + n;  // doubly linked list of nodes
+	int* prev = next + n;   // in the same bucket
+	int* bucketList = prev + n; // first node of each degree, unordered nodes
+	int* bucketBoundary = bucketList + dMax + 1; // first node of each degree, boundary nodes
 
-	list = m_nodeFirst;
-	listBoundary = NULL;
-	m_nodeFirst = m_nodeLast = NULL;
-	for (i=list; i; i=i->m_next)
+	for (d=0; d<=dMax; d++)
 	{
-		i->m_ordering = 2*m_nodeNum; // will contain remaining degree mod m_nodeNum (i.e. number of edges connecting to nodes in 'listBoundary' and 'list')
-		                             // if i->m_ordering \in [2*m_nodeNum;  3*m_nodeNum) - not assigned yet, belongs to 'list'
-		                             // if i->m_ordering \in [m_nodeNum;    2*m_nodeNum) - not assigned yet, belongs to 'listBoundary'
-		                             // if i->m_ordering \in [0;            m_nodeNum  ) - assigned, belongs to 'm_nodeFirst'
-		for (e=i->m_firstForward; e; e=e->m_nextForward)
-		{
-			i->m_ordering ++;
-		}
-		for (e=i->m_firstBackward; e; e=e->m_nextBackward)
-		{
-			i->m_ordering ++;
-		}
+		bucketList[d] = bucketBoundary[d] = -1;
 	}
+	// Nodes are appended, so that ties are broken by the order in which they were added
+	int* bucketLast = new int[dMax+1];
+	for (d=0; d<=dMax; d++)
+	{
+		bucketLast[d] = -1;
+	}
+	for (i=0; i<n; i++)
+	{
+		d = degree[i] = adjFirst[i+1] - adjFirst[i];
+		state[i] = 0;
+		next[i] = -1;
+		prev[i] = bucketLast[d];
+		if (bucketLast[d] >= 0) next[bucketLast[d]] = i;
+		else                    bucketList[d]       = i;
+		bucketLast[d] = i;
+	}
+	delete [] bucketLast;
 
-	while (list)
+	int dList = 0, dBoundary = 0, boundaryNum = 0, orderNum = 0;
+
+	while (orderNum < n)
 	{
-		// find node with the smallest remaining degree in list
-		dMin = m_nodeNum;
-		for (i=list; i; i=i->m_next)
+		// Unordered nodes only lose degree when they move to the boundary,
+		// so the smallest degree in the list never decreases
+		while (bucketList[dList] < 0) dList ++;
+		i = bucketList[dList];
+
+		// move i from list to boundary
+		bucketList[dList] = next[i];
+		if (next[i] >= 0) prev[next[i]] = -1;
+		next[i] = prev[i] = -1;
+		bucketBoundary[dList] = i;
+		state[i] = 1;
+		boundaryNum = 1;
+		dBoundary = dList;
+
+		while (boundaryNum > 0)
 		{
-			assert(i->m_ordering >= 2*m_nodeNum);
-			if (dMin > i->m_ordering - 2*m_nodeNum)
+			// take the node with the smallest remaining degree in the boundary
+			while (bucketBoundary[dBoundary] < 0) dBoundary ++;
+			i = bucketBoundary[dBoundary];
+			bucketBoundary[dBoundary] = next[i];
+			if (next[i] >= 0) prev[next[i]] = -1;
+			boundaryNum --;
+			state[i] = 2;
+			order[orderNum ++] = i;
+
+			// decrease the remaining degree of its neighbours, and put them into the boundary
+			for (k=adjFirst[i]; k<adjFirst[i+1]; k++)
 			{
-				dMin = i->m_ordering - 2*m_nodeNum;
-				iMin = i;
+				j = adj[k];
+				if (state[j] == 2) continue;
+
+				// remove j from its bucket
+				int* bucket = (state[j] == 0) ? bucketList : bucketBoundary;
+				if (prev[j] >= 0) next[prev[j]]     = next[j];
+				else              bucket[degree[j]] = next[j];
+				if (next[j] >= 0) prev[next[j]]     = prev[j];
+
+				// add j to the boundary bucket of its new degree
+				d = -- degree[j];
+				if (state[j] == 0)
+				{
+					state[j] = 1;
+					boundaryNum ++;
+				}
+				prev[j] = -1;
+				next[j] = bucketBoundary[d];
+				if (next[j] >= 0) prev[next[j]] = j;
+				bucketBoundary[d] = j;
+				if (dBoundary > d) dBoundary = d;
 			}
 		}
-		i = iMin;
+	}
 
-		// remove i from list
-		if (i->m_prev) i->m_prev->m_next = i->m_next;
-		else           list              = i->m_next;
-		if (i->m_next) i->m_next->m_prev = i->m_prev;
+	delete [] degree;
+}
 
-		// add i to listBoundary
-		listBoundary = i;
-		i->m_prev = NULL;
-		i->m_next = NULL;
-		i->m_ordering -= m_nodeNum;
+// Breadth first search from the first unordered node of each connected component.
+// (nodes are first placed in order, then their neighbours are appended as they are reached)
+static void OrderBFS(int n, const int* adjFirst, const int* adj, int* order)
+{
+	bool* visited = new bool[n];
+	int i, k, head, tail = 0;
 
-		while (listBoundary)
+	memset(visited, 0, n*sizeof(bool));
+	for (i=0; i<n; i++)
+	{
+		if (visited[i]) continue;
+		visited[i] = true;
+		order[tail ++] = i;
+		for (head=tail-1; head<tail; head++)
 		{
-			// find node with the smallest remaining degree in listBoundary
-			dMin = m_nodeNum;
-			for (i=listBoundary; i; i=i->m_next)
+			for (k=adjFirst[order[head]]; k<adjFirst[order[head]+1]; k++)
 			{
-				assert(i->m_ordering >= m_nodeNum && i->m_ordering < 2*m_nodeNum);
-				if (dMin > i->m_ordering - m_nodeNum)
+				if (!visited[adj[k]])
 				{
-					dMin = i->m_ordering - m_nodeNum;
-					iMin = i;
+					visited[adj[k]] = true;
+					order[tail ++] = adj[k];
 				}
 			}
-			i = iMin;
+		}
+	}
+
+	delete [] visited;
+}
+
+// Reverse Cuthill-McKee: breadth first search in which the neighbours of each node
+// are visited in order of increasing degree, started in each connected component from
+// a node of small degree in the last level of a breadth first search (a pseudo-peripheral node).
+// The resulting order is reversed. Gives orderings of small bandwidth.
+static void OrderRCM(int n, const int* adjFirst, const int* adj, int* order)
+{
+	int* mark = new int[n]; // -1: not reached; otherwise the component (during the first search) or n (ordered)
+	int* neighbours = new int[n];
+	int i, j, k, head, tail = 0;
+
+	for (i=0; i<n; i++)
+	{
+		mark[i] = -1;
+	}
 
-			// remove i from listBoundary
-			if (i->m_prev) i->m_prev->m_next = i->m_next;
-			else           listBoundary      = i->m_next;
-			if (i->m_next) i->m_next->m_prev = i->m_prev;
+	for (i=0; i<n; i++)
+	{
+		if (mark[i] >= 0) continue;
 
-			// add i to m_nodeFirst
-			if (m_nodeLast)
+		// Breadth first search of the component of i (into the free part of order),
+		// to find the node of smallest degree in its last level
+		int start = tail, end = tail, levelFirst;
+		order[end ++] = i;
+		mark[i] = i;
+		for (head=start; head<end; )
+		{
+			levelFirst = head;
+			int levelEnd = end;
+			for ( ; head<levelEnd; head++)
 			{
-				m_nodeLast->m_next = i;
-				i->m_ordering = m_nodeLast->m_ordering + 1;
+				for (k=adjFirst[order[head]]; k<adjFirst[order[head]+1]; k++)
+				{
+					j = adj[k];
+					if (mark[j] < 0)
+					{
+						mark[j] = i;
+						order[end ++] = j;
+					}
+				}
 			}
-			else
+		}
+		int root = order[levelFirst];
+		for (k=levelFirst; k<end; k++)
+		{
+			j = order[k];
+			if (adjFirst[j+1] - adjFirst[j] < adjFirst[root+1] - adjFirst[root])
 			{
-				m_nodeFirst = i;
-				i->m_ordering = 0;
+				root = j;
 			}
-			i->m_prev = m_nodeLast;
-			m_nodeLast = i;
-			i->m_next = NULL;
+		}
 
-			// process neighbors of i=m_nodeLast: decrease their remaining degree,
-			// put them into listBoundary (if they are in list)
-			for (e=m_nodeLast->m_firstForward; e; e=e->m_nextForward)
+		// Cuthill-McKee search from root
+		order[tail ++] = root;
+		mark[root] = n;
+		for (head=start; head<tail; head++)
+		{
+			int num = 0;
+			for (k=adjFirst[order[head]]; k<adjFirst[order[head]+1]; k++)
 			{
-				assert(m_nodeLast == e->m_tail);
-				i = e->m_head;
-				if (i->m_ordering >= m_nodeNum)
+				j = adj[k];
+				if (mark[j] != n)
 				{
-					i->m_ordering --; // decrease remaining degree of i
-					if (i->m_ordering >= 2*m_nodeNum)
-					{
-						// remove i from list
-						if (i->m_prev) i->m_prev->m_next = i->m_next;
-						else           list              = i->m_next;
-						if (i->m_next) i->m_next->m_prev = i->m_prev;
-
-						// add i to listBoundary
-						if (listBoundary) listBoundary->m_prev = i;
-						i->m_prev = NULL;
-						i->m_next = listBoundary;
-						listBoundary = i;
-						i->m_ordering -= m_nodeNum;
-					}
+					mark[j] = n;
+					neighbours[num ++] = j;
 				}
 			}
-			for (e=m_nodeLast->m_firstBackward; e; e=e->m_nextBackward)
+			for (k=1; k<num; k++)
 			{
-				assert(m_nodeLast == e->m_head);
-				i = e->m_tail;
-				if (i->m_ordering >= m_nodeNum)
+				// insertion sort by degree (stable, and neighbour lists are short)
+				j = neighbours[k];
+				int d = adjFirst[j+1] - adjFirst[j], m;
+				for (m=k; m>0 && adjFirst[neighbours[m-1]+1] - adjFirst[neighbours[m-1]] > d; m--)
 				{
-					i->m_ordering --; // decrease remaining degree of i
-					if (i->m_ordering >= 2*m_nodeNum)
-					{
-						// remove i from list
-						if (i->m_prev) i->m_prev->m_next = i->m_next;
-						else           list              = i->m_next;
-						if (i->m_next) i->m_next->m_prev = i->m_prev;
-
-						// add i to listBoundary
-						if (listBoundary) listBoundary->m_prev = i;
-						i->m_prev = NULL;
-						i->m_next = listBoundary;
-						listBoundary = i;
-						i->m_ordering -= m_nodeNum;
-					}
+					neighbours[m] = neighbours[m-1];
 				}
+				neighbours[m] = j;
 			}
+			memcpy(order + tail, neighbours, num*sizeof(int));
+			tail += num;
 		}
+		assert(tail == end);
 	}
 
-	printf("done\n");
+	std::reverse(order, order + n);
+
+	delete [] neighbours;
+	delete [] mark;
+}
+
+template <class T> void MRFEnergy<T>::SetAutomaticOrdering(OrderingType type)
+{
+	Node* i;
+	MRFEdge* e;
+	int k;
+
+	if (m_isEnergyConstructionCompleted)
+	{
+		m_errorFn("Error in SetAutomaticOrdering(): function cannot be called after graph construction is completed");
+	}
+
+	if (type != ORDERING_RASTER && m_nodeNum > 0)
+	{
+		// Until graph construction is completed, i->m_ordering is the index of i
+		int* adjFirst = new int[m_nodeNum + 1 + 2*m_edgeNum + m_nodeNum];
+		int* adj = adjFirst + m_nodeNum + 1;
+		int* order = adj + 2*m_edgeNum;
+		if (!adjFirst) m_errorFn("Not enough memory");
+
+		memset(adjFirst, 0, (m_nodeNum+1)*sizeof(int));
+		for (i=m_nodeFirst; i; i=i->m_next)
+		{
+			for (e=i->m_firstForward; e; e=e->m_nextForward)
+			{
+				adjFirst[e->m_tail->m_ordering + 1] ++;
+				adjFirst[e->m_head->m_ordering + 1] ++;
+			}
+		}
+		for (k=0; k<m_nodeNum; k++)
+		{
+			adjFirst[k+1] += adjFirst[k];
+		}
+		for (i=m_nodeFirst; i; i=i->m_next)
+		{
+			// edges of i in the order in which the original heuristic visited them
+			int* p = adj + adjFirst[i->m_ordering];
+			for (e=i->m_firstForward; e; e=e->m_nextForward)
+			{
+				*p ++ = e->m_head->m_ordering;
+			}
+			for (e=i->m_firstBackward; e; e=e->m_nextBackward)
+			{
+				*p ++ = e->m_tail->m_ordering;
+			}
+		}
+
+		switch (type)
+		{
+			case ORDERING_BFS: OrderBFS(m_nodeNum, adjFirst, adj, order); break;
+			case ORDERING_RCM: OrderRCM(m_nodeNum, adjFirst, adj, order); break;
+			default:           OrderMinDegree(m_nodeNum, adjFirst, adj, order); break;
+		}
+
+		// relink the nodes in the new order
+		m_nodeFirst = m_nodeLast = NULL;
+		for (k=0; k<m_nodeNum; k++)
+		{
+			i = m_nodeIndex[order[k]];
+			i->m_ordering = k;
+			i->m_prev = m_nodeLast;
+			i->m_next = NULL;
+			if (m_nodeLast) m_nodeLast->m_next = i;
+			else            m_nodeFirst        = i;
+			m_nodeLast = i;
+		}
+
+		delete [] adjFirst;
+	}
 
 	CompleteGraphConstruction();
 }
@@ -0,0 +1,281 @@
+/******************************************************************
+simd.h
+
+Vectorized versions of the inner loops of the message updates
+(used by typeGeneral.h and typePotts.h).
+
+On x86 processors each kernel is compiled for SSE2 and AVX2, and the
+version is selected at run time according to the CPU; elsewhere (or if
+TRWS_NO_SIMD is defined) the scalar versions are used.
+All kernels are templates over REAL and exist for float and double.
+They give exactly the same results as the scalar loops: element-wise
+operations are the same, and minima do not depend on the order of evaluation.
+
+	SimdAdd(a, b, K)                     a[k] += b[k]
+	SimdMin(a, K)                        returns min_k a[k]
+	SimdSubtract(a, v, K)                a[k] -= v
+	SimdSubtractTruncate(a, v, t, K)     a[k] = min(a[k] - v, t)
+	SimdGammaDiff(d, s, m, gamma, K)     d[k] = gamma*s[k] - m[k]
+	SimdMinSumRows(m, b, V, Ks, Kd)      m[kd] = min_ks (b[ks] + V[ks + kd*Ks])
+	SimdMinSumCols(m, b, V, Ks, Kd)      m[kd] = min_ks (b[ks] + V[kd + ks*Kd])
+
+*******************************************************************/
+
+#ifndef __SIMD_H__
+#define __SIMD_H__
+
+#if !defined(TRWS_NO_SIMD) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86))
+#define TRWS_SIMD_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+/////////////////////////////// scalar ///////////////////////////////////
+
+namespace SimdScalar
+{
+	template <class T> struct Ops
+	{
+		typedef T REAL;
+		typedef T V;
+		enum { N = 1 };
+		static inline V Load(const REAL* p) { return *p; }
+		static inline void Store(REAL* p, V a) { *p = a; }
+		static inline V Set(REAL a) { return a; }
+		static inline V Add(V a, V b) { return a + b; }
+		static inline V Sub(V a, V b) { return a - b; }
+		static inline V Mul(V a, V b) { return a * b; }
+		static inline V Min(V a, V b) { return (a > b) ? b : a; }
+		static inline REAL HMin(V a) { return a; }
+	};
+
+	#include "simdKernels.inc"
+}
+
+#ifdef TRWS_SIMD_X86
+
+/////////////////////////////// SSE2 ///////////////////////////////////
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("sse2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("sse2")
+#endif
+
+namespace SimdSse2
+{
+	template <class T> struct Ops;
+
+	template <> struct Ops<double>
+	{
+		typedef double REAL;
+		typedef __m128d V;
+		enum { N = 2 };
+		static inline V Load(const REAL* p) { return _mm_loadu_pd(p); }
+		static inline void Store(REAL* p, V a) { _mm_storeu_pd(p, a); }
+		static inline V Set(REAL a) { return _mm_set1_pd(a); }
+		static inline V Add(V a, V b) { return _mm_add_pd(a, b); }
+		static inline V Sub(V a, V b) { return _mm_sub_pd(a, b); }
+		static inline V Mul(V a, V b) { return _mm_mul_pd(a, b); }
+		static inline V Min(V a, V b) { return _mm_min_pd(a, b); }
+		static inline REAL HMin(V a) { return _mm_cvtsd_f64(_mm_min_sd(a, _mm_unpackhi_pd(a, a))); }
+	};
+
+	template <> struct Ops<float>
+	{
+		typedef float REAL;
+		typedef __m128 V;
+		enum { N = 4 };
+		static inline V Load(const REAL* p) { return _mm_loadu_ps(p); }
+		static inline void Store(REAL* p, V a) { _mm_storeu_ps(p, a); }
+		static inline V Set(REAL a) { return _mm_set1_ps(a); }
+		static inline V Add(V a, V b) { return _mm_add_ps(a, b); }
+		static inline V Sub(V a, V b) { return _mm_sub_ps(a, b); }
+		static inline V Mul(V a, V b) { return _mm_mul_ps(a, b); }
+		static inline V Min(V a, V b) { return _mm_min_ps(a, b); }
+		static inline REAL HMin(V a)
+		{
+			a = _mm_min_ps(a, _mm_movehl_ps(a, a));
+			a = _mm_min_ss(a, _mm_shuffle_ps(a, a, 1));
+			return _mm_cvtss_f32(a);
+		}
+	};
+
+	#include "simdKernels.inc"
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+/////////////////////////////// AVX2 ///////////////////////////////////
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+namespace SimdAvx2
+{
+	template <class T> struct Ops;
+
+	template <> struct Ops<double>
+	{
+		typedef double REAL;
+		typedef __m256d V;
+		enum { N = 4 };
+		static inline V Load(const REAL* p) { return _mm256_loadu_pd(p); }
+		static inline void Store(REAL* p, V a) { _mm256_storeu_pd(p, a); }
+		static inline V Set(REAL a) { return _mm256_set1_pd(a); }
+		static inline V Add(V a, V b) { return _mm256_add_pd(a, b); }
+		static inline V Sub(V a, V b) { return _mm256_sub_pd(a, b); }
+		static inline V Mul(V a, V b) { return _mm256_mul_pd(a, b); }
+		static inline V Min(V a, V b) { return _mm256_min_pd(a, b); }
+		static inline REAL HMin(V a)
+		{
+			__m128d b = _mm_min_pd(_mm256_castpd256_pd128(a), _mm256_extractf128_pd(a, 1));
+			return _mm_cvtsd_f64(_mm_min_sd(b, _mm_unpackhi_pd(b, b)));
+		}
+	};
+
+	template <> struct Ops<float>
+	{
+		typedef float REAL;
+		typedef __m256 V;
+		enum { N = 8 };
+		static inline V Load(const REAL* p) { return _mm256_loadu_ps(p); }
+		static inline void Store(REAL* p, V a) { _mm256_storeu_ps(p, a); }
+		static inline V Set(REAL a) { return _mm256_set1_ps(a); }
+		static inline V Add(V a, V b) { return _mm256_add_ps(a, b); }
+		static inline V Sub(V a, V b) { return _mm256_sub_ps(a, b); }
+		static inline V Mul(V a, V b) { return _mm256_mul_ps(a, b); }
+		static inline V Min(V a, V b) { return _mm256_min_ps(a, b); }
+		static inline REAL HMin(V a)
+		{
+			__m128 b = _mm_min_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+			b = _mm_min_ps(b, _mm_movehl_ps(b, b));
+			b = _mm_min_ss(b, _mm_shuffle_ps(b, b, 1));
+			return _mm_cvtss_f32(b);
+		}
+	};
+
+	#include "simdKernels.inc"
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif // TRWS_SIMD_X86
+
+/////////////////////////////// dispatch ///////////////////////////////////
+
+// 0: scalar, 1: SSE2, 2: AVX2
+inline int SimdDetectLevel()
+{
+#ifdef TRWS_SIMD_X86
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] >= 7)
+	{
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1<<27)) != 0;
+		bool avx = (info[2] & (1<<28)) != 0;
+		__cpuidex(info, 7, 0);
+		bool avx2 = (info[1] & (1<<5)) != 0;
+		if (osxsave && avx && avx2 && (_xgetbv(0) & 6) == 6)
+		{
+			return 2;
+		}
+	}
+	__cpuid(info, 1);
+	return (info[3] & (1<<26)) ? 1 : 0;
+#else
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+	{
+		return 2;
+	}
+	return __builtin_cpu_supports("sse2") ? 1 : 0;
+#endif
+#else
+	return 0;
+#endif
+}
+
+inline int SimdLevel()
+{
+	static const int level = SimdDetectLevel();
+	return level;
+}
+
+// Vectors shorter than this are processed with the scalar code, which is
+// inlined into the caller (the vectorized kernels are compiled for a different
+// target, so they can't be)
+#define TRWS_SIMD_MIN_SIZE 4
+
+#ifdef TRWS_SIMD_X86
+#define TRWS_SIMD_DISPATCH(REAL, call, args, size)                              \
+	if (size >= TRWS_SIMD_MIN_SIZE)                                             \
+	{                                                                           \
+		switch (SimdLevel())                                                    \
+		{                                                                       \
+			case 2: return SimdAvx2::call<SimdAvx2::Ops<REAL> > args;           \
+			case 1: return SimdSse2::call<SimdSse2::Ops<REAL> > args;           \
+		}                                                                       \
+	}                                                                           \
+	return SimdScalar::call<SimdScalar::Ops<REAL> > args;
+#else
+#define TRWS_SIMD_DISPATCH(REAL, call, args, size)                              \
+	return SimdScalar::call<SimdScalar::Ops<REAL> > args;
+#endif
+
+template <class REAL> inline void SimdAdd(REAL* a, const REAL* b, int K)
+{
+	TRWS_SIMD_DISPATCH(REAL, Add, (a, b, K), K);
+}
+
+template <class REAL> inline REAL SimdMin(const REAL* a, int K)
+{
+	TRWS_SIMD_DISPATCH(REAL, Min, (a, K), K);
+}
+
+template <class REAL> inline void SimdSubtract(REAL* a, REAL v, int K)
+{
+	TRWS_SIMD_DISPATCH(REAL, Subtract, (a, v, K), K);
+}
+
+template <class REAL> inline void SimdSubtractTruncate(REAL* a, REAL v, REAL t, int K)
+{
+	TRWS_SIMD_DISPATCH(REAL, SubtractTruncate, (a, v, t, K), K);
+}
+
+template <class REAL> inline void SimdGammaDiff(REAL* d, const REAL* s, const REAL* m, REAL gamma, int K)
+{
+	TRWS_SIMD_DISPATCH(REAL, GammaDiff, (d, s, m, gamma, K), K);
+}
+
+template <class REAL> inline void SimdMinSumRows(REAL* m, const REAL* b, const REAL* V, int Ks, int Kd)
+{
+	TRWS_SIMD_DISPATCH(REAL, MinSumRows, (m, b, V, Ks, Kd), Ks);
+}
+
+template <class REAL> inline void SimdMinSumCols(REAL* m, const REAL* b, const REAL* V, int Ks, int Kd)
+{
+	TRWS_SIMD_DISPATCH(REAL, MinSumCols, (m, b, V, Ks, Kd), Kd);
+}
+
+#undef TRWS_SIMD_DISPATCH
+#undef TRWS_SIMD_MIN_SIZE
+
+#endif
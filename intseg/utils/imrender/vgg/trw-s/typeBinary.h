@@ -86,14 +86,15 @@ void testBinary()
 template <class T> class MRFEnergy;
 
 
-class TypeBinary
+// REAL is double for TypeBinary and float for TypeBinaryFloat
+template <class RealType> class TypeBinaryT
 {
 public:
 	// types declarations
 	struct Edge; // stores edge information and either forward or backward message
 	struct Vector; // node parameters and messages
 	typedef int Label;
-	typedef double REAL;
+	typedef RealType REAL;
 	struct GlobalSize; // global information about number of labels
 	struct LocalSize; // local information about number of labels (stored at each node)
 	struct NodeData; // argument to MRFEnergy::AddNode()
@@ -137,7 +138,7 @@ public:
 	////////////////////////// Visible only to MRFEnergy /////////////////////////////
 	//////////////////////////////////////////////////////////////////////////////////
 
-	friend class MRFEnergy<TypeBinary>;
+	friend class MRFEnergy<TypeBinaryT>;
 
 	struct Vector
 	{
@@ -209,23 +210,29 @@ public:
 
 
 
+typedef TypeBinaryT<double> TypeBinary;
+typedef TypeBinaryT<float> TypeBinaryFloat;
+
+
+
+
 //////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////// Implementation ///////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////
 
-inline TypeBinary::GlobalSize::GlobalSize(int K)
+template <class RealType> inline TypeBinaryT<RealType>::GlobalSize::GlobalSize(int K)
 {
 }
 
 ///////////////////// NodeData and EdgeData ///////////////////////
 
-inline TypeBinary::NodeData::NodeData(REAL D0, REAL D1)
+template <class RealType> inline TypeBinaryT<RealType>::NodeData::NodeData(REAL D0, REAL D1)
 {
 	m_data[0] = D0;
 	m_data[1] = D1;
 }
 
-inline TypeBinary::EdgeData::EdgeData(REAL V00, REAL V01, REAL V10, REAL V11)
+template <class RealType> inline TypeBinaryT<RealType>::EdgeData::EdgeData(REAL V00, REAL V01, REAL V10, REAL V11)
 {
 	m_V[0][0] = V00;
 	m_V[0][1] = V01;
@@ -235,53 +242,53 @@ inline TypeBinary::EdgeData::EdgeData(REAL V00, REAL V01, REAL V10, REAL V11)
 
 ///////////////////// Vector ///////////////////////
 
-inline int TypeBinary::Vector::GetSizeInBytes(GlobalSize Kglobal, LocalSize K)
+template <class RealType> inline int TypeBinaryT<RealType>::Vector::GetSizeInBytes(GlobalSize Kglobal, LocalSize K)
 {
 	return sizeof(Vector);
 }
-inline void TypeBinary::Vector::Initialize(GlobalSize Kglobal, LocalSize K, NodeData data)
+template <class RealType> inline void TypeBinaryT<RealType>::Vector::Initialize(GlobalSize Kglobal, LocalSize K, NodeData data)
 {
 	m_data[0] = data.m_data[0];
 	m_data[1] = data.m_data[1];
 }
 
-inline void TypeBinary::Vector::Add(GlobalSize Kglobal, LocalSize K, NodeData data)
+template <class RealType> inline void TypeBinaryT<RealType>::Vector::Add(GlobalSize Kglobal, LocalSize K, NodeData data)
 {
 	m_data[0] += data.m_data[0];
 	m_data[1] += data.m_data[1];
 }
 
-inline void TypeBinary::Vector::SetZero(GlobalSize Kglobal, LocalSize K)
+template <class RealType> inline void TypeBinaryT<RealType>::Vector::SetZero(GlobalSize Kglobal, LocalSize K)
 {
 	m_data[0] = 0;
 	m_data[1] = 0;
 }
 
-inline void TypeBinary::Vector::Copy(GlobalSize Kglobal, LocalSize K, Vector* V)
+template <class RealType> inline void TypeBinaryT<RealType>::Vector::Copy(GlobalSize Kglobal, LocalSize K, Vector* V)
 {
 	m_data[0] = V->m_data[0];
 	m_data[1] = V->m_data[1];
 }
 
-inline void TypeBinary::Vector::Add(GlobalSize Kglobal, LocalSize K, Vector* V)
+template <class RealType> inline void TypeBinaryT<RealType>::Vector::Add(GlobalSize Kglobal, LocalSize K, Vector* V)
 {
 	m_data[0] += V->m_data[0];
 	m_data[1] += V->m_data[1];
 }
 
-inline TypeBinary::REAL TypeBinary::Vector::GetValue(GlobalSize Kglobal, LocalSize K, Label k)
+template <class RealType> inline typename TypeBinaryT<RealType>::REAL TypeBinaryT<RealType>::Vector::GetValue(GlobalSize Kglobal, LocalSize K, Label k)
 {
 	assert(k>=0 && k<2);
 	return m_data[k];
 }
 
-inline TypeBinary::REAL TypeBinary::Vector::ComputeMin(GlobalSize Kglobal, LocalSize K, Label& kMin)
+template <class RealType> inline typename TypeBinaryT<RealType>::REAL TypeBinaryT<RealType>::Vector::ComputeMin(GlobalSize Kglobal, LocalSize K, Label& kMin)
 {
 	kMin = (m_data[0] <= m_data[1]) ? 0 : 1;
 	return m_data[kMin];
 }
 
-inline TypeBinary::REAL TypeBinary::Vector::ComputeAndSubtractMin(GlobalSize Kglobal, LocalSize K)
+template <class RealType> inline typename TypeBinaryT<RealType>::REAL TypeBinaryT<RealType>::Vector::ComputeAndSubtractMin(GlobalSize Kglobal, LocalSize K)
 {
 	REAL vMin;
 
@@ -303,17 +310,17 @@ inline TypeBinary::REAL TypeBinary::Vector::ComputeAndSubtractMin(GlobalSize Kgl
 
 ///////////////////// EdgeDataAndMessage implementation /////////////////////////
 
-inline int TypeBinary::Edge::GetSizeInBytes(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj, EdgeData data)
+template <class RealType> inline int TypeBinaryT<RealType>::Edge::GetSizeInBytes(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj, EdgeData data)
 {
 	return sizeof(Edge);
 }
 
-inline int TypeBinary::Edge::GetBufSizeInBytes(int vectorMaxSizeInBytes)
+template <class RealType> inline int TypeBinaryT<RealType>::Edge::GetBufSizeInBytes(int vectorMaxSizeInBytes)
 {
 	return 0;
 }
 
-inline void TypeBinary::Edge::Initialize(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj, EdgeData data, Vector* Di, Vector* Dj)
+template <class RealType> inline void TypeBinaryT<RealType>::Edge::Initialize(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj, EdgeData data, Vector* Di, Vector* Dj)
 {
 	// V00 V01  = A B  = A A  +  0.5 * ( 0   0   + 0 P-Q  +  0   P+Q  )
 	// V10 V11    C D    D D             Q-P Q-P   0 P-Q     P+Q 0
@@ -328,16 +335,16 @@ inline void TypeBinary::Edge::Initialize(GlobalSize Kglobal, LocalSize Ki, Local
 	m_lambdaIsing = halfPplusQ;
 }
 
-inline TypeBinary::Vector* TypeBinary::Edge::GetMessagePtr()
+template <class RealType> inline typename TypeBinaryT<RealType>::Vector* TypeBinaryT<RealType>::Edge::GetMessagePtr()
 {
 	return &m_message;
 }
 
-inline void TypeBinary::Edge::Swap(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj)
+template <class RealType> inline void TypeBinaryT<RealType>::Edge::Swap(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj)
 {
 }
 
-inline TypeBinary::REAL TypeBinary::Edge::UpdateMessage(GlobalSize Kglobal, LocalSize Ksource, LocalSize Kdest, Vector* source, REAL gamma, int dir, void* buf)
+template <class RealType> inline typename TypeBinaryT<RealType>::REAL TypeBinaryT<RealType>::Edge::UpdateMessage(GlobalSize Kglobal, LocalSize Ksource, LocalSize Kdest, Vector* source, REAL gamma, int dir, void* buf)
 {
 	REAL data[2], vMin;
 
@@ -355,7 +362,7 @@ inline TypeBinary::REAL TypeBinary::Edge::UpdateMessage(GlobalSize Kglobal, Loca
 
 
 
-inline void TypeBinary::Edge::AddColumn(GlobalSize Kglobal, LocalSize Ksource, LocalSize Kdest, Label ksource, Vector* dest, int dir)
+template <class RealType> inline void TypeBinaryT<RealType>::Edge::AddColumn(GlobalSize Kglobal, LocalSize Ksource, LocalSize Kdest, Label ksource, Vector* dest, int dir)
 {
 	dest->m_data[1-ksource] += m_lambdaIsing;
 }
@@ -23,14 +23,15 @@ For example usage, see typeBinary.h (only replace BinaryType with BinaryTypeFast
 template <class T> class MRFEnergy;
 
 
-class TypeBinaryFast
+// REAL is double for TypeBinaryFast and float for TypeBinaryFastFloat
+template <class RealType> class TypeBinaryFastT
 {
 public:
 	// types declarations
 	struct Edge; // stores edge information and either forward or backward message
 	struct Vector; // node parameters and messages
 	typedef int Label;
-	typedef double REAL;
+	typedef RealType REAL;
 	struct GlobalSize; // global information about number of labels
 	struct LocalSize; // local information about number of labels (stored at each node)
 	struct NodeData; // argument to MRFEnergy::AddNode()
@@ -75,7 +76,7 @@ public:
 	////////////////////////// Visible only to MRFEnergy /////////////////////////////
 	//////////////////////////////////////////////////////////////////////////////////
 
-friend class MRFEnergy<TypeBinaryFast>;
+friend class MRFEnergy<TypeBinaryFastT>;
 
 	struct Vector
 	{
@@ -147,23 +148,29 @@ friend class MRFEnergy<TypeBinaryFast>;
 
 
 
+typedef TypeBinaryFastT<double> TypeBinaryFast;
+typedef TypeBinaryFastT<float> TypeBinaryFastFloat;
+
+
+
+
 //////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////// Implementation ///////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////
 
-inline TypeBinaryFast::GlobalSize::GlobalSize(int K)
+template <class RealType> inline TypeBinaryFastT<RealType>::GlobalSize::GlobalSize(int K)
 {
 }
 
 ///////////////////// NodeData and EdgeData ///////////////////////
 
-inline TypeBinaryFast::NodeData::NodeData(REAL D0, REAL D1)
+template <class RealType> inline TypeBinaryFastT<RealType>::NodeData::NodeData(REAL D0, REAL D1)
 {
 	m_data[0] = D0;
 	m_data[1] = D1;
 }
 
-inline TypeBinaryFast::EdgeData::EdgeData(REAL V00, REAL V01, REAL V10, REAL V11)
+template <class RealType> inline TypeBinaryFastT<RealType>::EdgeData::EdgeData(REAL V00, REAL V01, REAL V10, REAL V11)
 {
 	m_V[0][0] = V00;
 	m_V[0][1] = V01;
@@ -173,65 +180,65 @@ inline TypeBinaryFast::EdgeData::EdgeData(REAL V00, REAL V01, REAL V10, REAL V11
 
 ///////////////////// Vector ///////////////////////
 
-inline int TypeBinaryFast::Vector::GetSizeInBytes(GlobalSize Kglobal, LocalSize K)
+template <class RealType> inline int TypeBinaryFastT<RealType>::Vector::GetSizeInBytes(GlobalSize Kglobal, LocalSize K)
 {
 	return sizeof(Vector);
 }
-inline void TypeBinaryFast::Vector::Initialize(GlobalSize Kglobal, LocalSize K, NodeData data)
+template <class RealType> inline void TypeBinaryFastT<RealType>::Vector::Initialize(GlobalSize Kglobal, LocalSize K, NodeData data)
 {
 	m_data = data.m_data[1] - data.m_data[0];
 }
 
-inline void TypeBinaryFast::Vector::Add(GlobalSize Kglobal, LocalSize K, NodeData data)
+template <class RealType> inline void TypeBinaryFastT<RealType>::Vector::Add(GlobalSize Kglobal, LocalSize K, NodeData data)
 {
 	m_data += data.m_data[1] - data.m_data[0];
 }
 
-inline void TypeBinaryFast::Vector::SetZero(GlobalSize Kglobal, LocalSize K)
+template <class RealType> inline void TypeBinaryFastT<RealType>::Vector::SetZero(GlobalSize Kglobal, LocalSize K)
 {
 	m_data = 0;
 }
 
-inline void TypeBinaryFast::Vector::Copy(GlobalSize Kglobal, LocalSize K, Vector* V)
+template <class RealType> inline void TypeBinaryFastT<RealType>::Vector::Copy(GlobalSize Kglobal, LocalSize K, Vector* V)
 {
 	m_data = V->m_data;
 }
 
-inline void TypeBinaryFast::Vector::Add(GlobalSize Kglobal, LocalSize K, Vector* V)
+template <class RealType> inline void TypeBinaryFastT<RealType>::Vector::Add(GlobalSize Kglobal, LocalSize K, Vector* V)
 {
 	m_data += V->m_data;
 }
 
-inline TypeBinaryFast::REAL TypeBinaryFast::Vector::GetValue(GlobalSize Kglobal, LocalSize K, Label k)
+template <class RealType> inline typename TypeBinaryFastT<RealType>::REAL TypeBinaryFastT<RealType>::Vector::GetValue(GlobalSize Kglobal, LocalSize K, Label k)
 {
 	assert(k>=0 && k<2);
 	return (k == 0) ? 0 : m_data;
 }
 
-inline TypeBinaryFast::REAL TypeBinaryFast::Vector::ComputeMin(GlobalSize Kglobal, LocalSize K, Label& kMin)
+template <class RealType> inline typename TypeBinaryFastT<RealType>::REAL TypeBinaryFastT<RealType>::Vector::ComputeMin(GlobalSize Kglobal, LocalSize K, Label& kMin)
 {
 	kMin = (m_data >= 0) ? 0 : 1;
 	return 0;
 }
 
-inline TypeBinaryFast::REAL TypeBinaryFast::Vector::ComputeAndSubtractMin(GlobalSize Kglobal, LocalSize K)
+template <class RealType> inline typename TypeBinaryFastT<RealType>::REAL TypeBinaryFastT<RealType>::Vector::ComputeAndSubtractMin(GlobalSize Kglobal, LocalSize K)
 {
 	return 0;
 }
 
 ///////////////////// EdgeDataAndMessage implementation /////////////////////////
 
-inline int TypeBinaryFast::Edge::GetSizeInBytes(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj, EdgeData data)
+template <class RealType> inline int TypeBinaryFastT<RealType>::Edge::GetSizeInBytes(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj, EdgeData data)
 {
 	return sizeof(Edge);
 }
 
-inline int TypeBinaryFast::Edge::GetBufSizeInBytes(int vectorMaxSizeInBytes)
+template <class RealType> inline int TypeBinaryFastT<RealType>::Edge::GetBufSizeInBytes(int vectorMaxSizeInBytes)
 {
 	return 0;
 }
 
-inline void TypeBinaryFast::Edge::Initialize(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj, EdgeData data, Vector* Di, Vector* Dj)
+template <class RealType> inline void TypeBinaryFastT<RealType>::Edge::Initialize(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj, EdgeData data, Vector* Di, Vector* Dj)
 {
 	// V00 V01  = A B  = A A  +  0.5 * ( 0   0   + 0 P-Q  +  0   P+Q  )
 	// V10 V11    C D    D D             Q-P Q-P   0 P-Q     P+Q 0
@@ -245,16 +252,16 @@ inline void TypeBinaryFast::Edge::Initialize(GlobalSize Kglobal, LocalSize Ki, L
 	m_lambdaIsing = halfPplusQ;
 }
 
-inline TypeBinaryFast::Vector* TypeBinaryFast::Edge::GetMessagePtr()
+template <class RealType> inline typename TypeBinaryFastT<RealType>::Vector* TypeBinaryFastT<RealType>::Edge::GetMessagePtr()
 {
 	return &m_message;
 }
 
-inline void TypeBinaryFast::Edge::Swap(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj)
+template <class RealType> inline void TypeBinaryFastT<RealType>::Edge::Swap(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj)
 {
 }
 
-inline TypeBinaryFast::REAL TypeBinaryFast::Edge::UpdateMessage(GlobalSize Kglobal, LocalSize Ksource, LocalSize Kdest, Vector* source, REAL gamma, int dir, void* buf)
+template <class RealType> inline typename TypeBinaryFastT<RealType>::REAL TypeBinaryFastT<RealType>::Edge::UpdateMessage(GlobalSize Kglobal, LocalSize Ksource, LocalSize Kdest, Vector* source, REAL gamma, int dir, void* buf)
 {
 	REAL s = gamma*source->m_data - m_message.m_data;
 	if (m_lambdaIsing < 0)
@@ -278,7 +285,7 @@ inline TypeBinaryFast::REAL TypeBinaryFast::Edge::UpdateMessage(GlobalSize Kglob
 	return 0;
 }
 
-inline void TypeBinaryFast::Edge::AddColumn(GlobalSize Kglobal, LocalSize Ksource, LocalSize Kdest, Label ksource, Vector* dest, int dir)
+template <class RealType> inline void TypeBinaryFastT<RealType>::Edge::AddColumn(GlobalSize Kglobal, LocalSize Ksource, LocalSize Kdest, Label ksource, Vector* dest, int dir)
 {
 	dest->m_data += (ksource == 0) ? m_lambdaIsing : -m_lambdaIsing;
 }
@@ -109,10 +109,12 @@ void testGeneral()
 
 #include <string.h>
 #include <assert.h>
+#include "simd.h"
 
 template <class T> class MRFEnergy;
 
-class TypeGeneral
+// REAL is double for TypeGeneral and float for TypeGeneralFloat
+template <class RealType> class TypeGeneralT
 {
 public:
 	struct Edge; // stores edge information and either forward or backward message
@@ -125,7 +127,7 @@ public:
 
 	// types declarations
 	typedef int Label;
-	typedef double REAL;
+	typedef RealType REAL;
 	struct GlobalSize; // global information about number of labels
 	struct LocalSize; // local information about number of labels (stored at each node)
 	struct NodeData; // argument to MRFEnergy::AddNode()
@@ -182,7 +184,7 @@ public:
 	//////////////////////////////////////////////////////////////////////////////////
 
 
-friend class MRFEnergy<TypeGeneral>;
+friend class MRFEnergy<TypeGeneralT>;
 
 	struct Vector
 	{
@@ -247,7 +249,7 @@ friend class MRFEnergy<TypeGeneral>;
 		Type		m_type;
 
 		// message
-		Vector*		m_message;
+		int			m_messageOffset; // position of the message relative to this (so that edges may be moved with memcpy)
 	};
 
 	struct EdgePotts : Edge
@@ -269,34 +271,40 @@ friend class MRFEnergy<TypeGeneral>;
 
 
 
+typedef TypeGeneralT<double> TypeGeneral;
+typedef TypeGeneralT<float> TypeGeneralFloat;
+
+
+
+
 //////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////// Implementation ///////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////
 
-inline TypeGeneral::GlobalSize::GlobalSize(int K)
+template <class RealType> inline TypeGeneralT<RealType>::GlobalSize::GlobalSize(int K)
 {
 }
 
-inline TypeGeneral::LocalSize::LocalSize(int K)
+template <class RealType> inline TypeGeneralT<RealType>::LocalSize::LocalSize(int K)
 {
 	m_K = K;
 }
 
 ///////////////////// NodeData and EdgeData ///////////////////////
 
-inline TypeGeneral::NodeData::NodeData(REAL* data)
+template <class RealType> inline TypeGeneralT<RealType>::NodeData::NodeData(REAL* data)
 {
 	m_data = data;
 }
 
-inline TypeGeneral::EdgeData::EdgeData(Type type, REAL lambdaPotts)
+template <class RealType> inline TypeGeneralT<RealType>::EdgeData::EdgeData(Type type, REAL lambdaPotts)
 {
 	assert(type == POTTS);
 	m_type = type;
 	m_lambdaPotts = lambdaPotts;
 }
 
-inline TypeGeneral::EdgeData::EdgeData(Type type, REAL* data)
+template <class RealType> inline TypeGeneralT<RealType>::EdgeData::EdgeData(Type type, REAL* data)
 {
 	assert(type == GENERAL);
 	m_type = type;
@@ -305,7 +313,7 @@ inline TypeGeneral::EdgeData::EdgeData(Type type, REAL* data)
 
 ///////////////////// Vector ///////////////////////
 
-inline int TypeGeneral::Vector::GetSizeInBytes(GlobalSize Kglobal, LocalSize K)
+template <class RealType> inline int TypeGeneralT<RealType>::Vector::GetSizeInBytes(GlobalSize Kglobal, LocalSize K)
 {
 	if (K.m_K < 1)
 	{
@@ -313,12 +321,12 @@ inline int TypeGeneral::Vector::GetSizeInBytes(GlobalSize Kglobal, LocalSize K)
 	}
 	return K.m_K*sizeof(REAL);
 }
-inline void TypeGeneral::Vector::Initialize(GlobalSize Kglobal, LocalSize K, NodeData data)
+template <class RealType> inline void TypeGeneralT<RealType>::Vector::Initialize(GlobalSize Kglobal, LocalSize K, NodeData data)
 {
 	memcpy(m_data, data.m_data, K.m_K*sizeof(REAL));
 }
 
-inline void TypeGeneral::Vector::Add(GlobalSize Kglobal, LocalSize K, NodeData data)
+template <class RealType> inline void TypeGeneralT<RealType>::Vector::Add(GlobalSize Kglobal, LocalSize K, NodeData data)
 {
 	for (int k=0; k<K.m_K; k++)
 	{
@@ -326,31 +334,28 @@ inline void TypeGeneral::Vector::Add(GlobalSize Kglobal, LocalSize K, NodeData d
 	}
 }
 
-inline void TypeGeneral::Vector::SetZero(GlobalSize Kglobal, LocalSize K)
+template <class RealType> inline void TypeGeneralT<RealType>::Vector::SetZero(GlobalSize Kglobal, LocalSize K)
 {
 	memset(m_data, 0, K.m_K*sizeof(REAL));
 }
 
-inline void TypeGeneral::Vector::Copy(GlobalSize Kglobal, LocalSize K, Vector* V)
+template <class RealType> inline void TypeGeneralT<RealType>::Vector::Copy(GlobalSize Kglobal, LocalSize K, Vector* V)
 {
 	memcpy(m_data, V->m_data, K.m_K*sizeof(REAL));
 }
 
-inline void TypeGeneral::Vector::Add(GlobalSize Kglobal, LocalSize K, Vector* V)
+template <class RealType> inline void TypeGeneralT<RealType>::Vector::Add(GlobalSize Kglobal, LocalSize K, Vector* V)
 {
-	for (int k=0; k<K.m_K; k++)
-	{
-		m_data[k] += V->m_data[k];
-	}
+	SimdAdd(m_data, V->m_data, K.m_K);
 }
 
-inline TypeGeneral::REAL TypeGeneral::Vector::GetValue(GlobalSize Kglobal, LocalSize K, Label k)
+template <class RealType> inline typename TypeGeneralT<RealType>::REAL TypeGeneralT<RealType>::Vector::GetValue(GlobalSize Kglobal, LocalSize K, Label k)
 {
 	assert(k>=0 && k<K.m_K);
 	return m_data[k];
 }
 
-inline TypeGeneral::REAL TypeGeneral::Vector::ComputeMin(GlobalSize Kglobal, LocalSize K, Label& kMin)
+template <class RealType> inline typename TypeGeneralT<RealType>::REAL TypeGeneralT<RealType>::Vector::ComputeMin(GlobalSize Kglobal, LocalSize K, Label& kMin)
 {
 	REAL vMin = m_data[0];
 	kMin = 0;
@@ -366,27 +371,17 @@ inline TypeGeneral::REAL TypeGeneral::Vector::ComputeMin(GlobalSize Kglobal, Loc
 	return vMin;
 }
 
-inline TypeGeneral::REAL TypeGeneral::Vector::ComputeAndSubtractMin(GlobalSize Kglobal, LocalSize K)
+template <class RealType> inline typename TypeGeneralT<RealType>::REAL TypeGeneralT<RealType>::Vector::ComputeAndSubtractMin(GlobalSize Kglobal, LocalSize K)
 {
-	REAL vMin = m_data[0];
-	for (int k=1; k<K.m_K; k++)
-	{
-		if (vMin > m_data[k])
-		{
-			vMin = m_data[k];
-		}
-	}
-	for (int k=0; k<K.m_K; k++)
-	{
-		m_data[k] -= vMin;
-	}
+	REAL vMin = SimdMin(m_data, K.m_K);
+	SimdSubtract(m_data, vMin, K.m_K);
 
 	return vMin;
 }
 
 ///////////////////// EdgeDataAndMessage implementation /////////////////////////
 
-inline int TypeGeneral::Edge::GetSizeInBytes(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj, EdgeData data)
+template <class RealType> inline int TypeGeneralT<RealType>::Edge::GetSizeInBytes(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj, EdgeData data)
 {
 	int messageSizeInBytes = ((Ki.m_K > Kj.m_K) ? Ki.m_K : Kj.m_K)*sizeof(REAL);
 
@@ -405,12 +400,12 @@ inline int TypeGeneral::Edge::GetSizeInBytes(GlobalSize Kglobal, LocalSize Ki, L
 	}
 }
 
-inline int TypeGeneral::Edge::GetBufSizeInBytes(int vectorMaxSizeInBytes)
+template <class RealType> inline int TypeGeneralT<RealType>::Edge::GetBufSizeInBytes(int vectorMaxSizeInBytes)
 {
 	return vectorMaxSizeInBytes;
 }
 
-inline void TypeGeneral::Edge::Initialize(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj, EdgeData data, Vector* Di, Vector* Dj)
+template <class RealType> inline void TypeGeneralT<RealType>::Edge::Initialize(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj, EdgeData data, Vector* Di, Vector* Dj)
 {
 	m_type = data.m_type;
 
@@ -418,24 +413,24 @@ inline void TypeGeneral::Edge::Initialize(GlobalSize Kglobal, LocalSize Ki, Loca
 	{
 		case POTTS:
 			((EdgePotts*)this)->m_lambdaPotts = data.m_lambdaPotts;
-			m_message = (Vector*)((char*)this + sizeof(EdgePotts));
+			m_messageOffset = sizeof(EdgePotts);
 			break;
 		case GENERAL:
 			((EdgeGeneral*)this)->m_dir = 0;
 			memcpy(((EdgeGeneral*)this)->m_data, data.m_dataGeneral, Ki.m_K*Kj.m_K*sizeof(REAL));
-			m_message = (Vector*)((char*)this + sizeof(EdgeGeneral) - sizeof(REAL) + Ki.m_K*Kj.m_K*sizeof(REAL));
+			m_messageOffset = sizeof(EdgeGeneral) - sizeof(REAL) + Ki.m_K*Kj.m_K*sizeof(REAL);
 			break;
 		default:
 			assert(0);
 	}
 }
 
-inline TypeGeneral::Vector* TypeGeneral::Edge::GetMessagePtr()
+template <class RealType> inline typename TypeGeneralT<RealType>::Vector* TypeGeneralT<RealType>::Edge::GetMessagePtr()
 {
-	return m_message;
+	return (Vector*)((char*)this + m_messageOffset);
 }
 
-inline void TypeGeneral::Edge::Swap(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj)
+template <class RealType> inline void TypeGeneralT<RealType>::Edge::Swap(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj)
 {
 	if (m_type == GENERAL)
 	{
@@ -443,96 +438,38 @@ inline void TypeGeneral::Edge::Swap(GlobalSize Kglobal, LocalSize Ki, LocalSize
 	}
 }
 
-inline TypeGeneral::REAL TypeGeneral::Edge::UpdateMessage(GlobalSize Kglobal, LocalSize Ksource, LocalSize Kdest, Vector* source, REAL gamma, int dir, void* _buf)
+template <class RealType> inline typename TypeGeneralT<RealType>::REAL TypeGeneralT<RealType>::Edge::UpdateMessage(GlobalSize Kglobal, LocalSize Ksource, LocalSize Kdest, Vector* source, REAL gamma, int dir, void* _buf)
 {
 	Vector* buf = (Vector*) _buf;
+	Vector* message = GetMessagePtr();
 	REAL vMin;
 
 	if (m_type == POTTS)
 	{
 		assert(Ksource.m_K == Kdest.m_K);
 
-		int k, kMin;
-
-		m_message->m_data[0] = gamma*source->m_data[0] - m_message->m_data[0];
-		kMin = 0;
-		vMin = m_message->m_data[0];
-
-		for (k=1; k<Ksource.m_K; k++)
-		{
-			m_message->m_data[k] = gamma*source->m_data[k] - m_message->m_data[k];
-			kMin = 0;
-			vMin = buf->m_data[0];
-			if (vMin > m_message->m_data[k])
-			{
-				kMin = k;
-				vMin = m_message->m_data[k];
-			}
-		}
-
-		for (k=0; k<Ksource.m_K; k++)
-		{
-			m_message->m_data[k] -= vMin;
-			if (m_message->m_data[k] > ((EdgePotts*)this)->m_lambdaPotts)
-			{
-				m_message->m_data[k] = ((EdgePotts*)this)->m_lambdaPotts;
-			}
-		}
+		SimdGammaDiff(message->m_data, source->m_data, message->m_data, gamma, Ksource.m_K);
+		vMin = SimdMin(message->m_data, Ksource.m_K);
+		SimdSubtractTruncate(message->m_data, vMin, ((EdgePotts*)this)->m_lambdaPotts, Ksource.m_K);
 	}
 	else if (m_type == GENERAL)
 	{
-		int ksource, kdest;
 		REAL* data = ((EdgeGeneral*)this)->m_data;
 
-		for (ksource=0; ksource<Ksource.m_K; ksource++)
-		{
-			buf->m_data[ksource] = gamma*source->m_data[ksource] - m_message->m_data[ksource];
-		}
+		SimdGammaDiff(buf->m_data, source->m_data, message->m_data, gamma, Ksource.m_K);
 
+		// message[kdest] = min_{ksource} (buf[ksource] + V(ksource,kdest))
 		if (dir == ((EdgeGeneral*)this)->m_dir)
 		{
-			for (kdest=0; kdest<Kdest.m_K; kdest++)
-			{
-				vMin = buf->m_data[0] + data[0 + kdest*Ksource.m_K];
-				for (ksource=1; ksource<Ksource.m_K; ksource++)
-				{
-					if (vMin > buf->m_data[ksource] + data[ksource + kdest*Ksource.m_K])
-					{
-						vMin = buf->m_data[ksource] + data[ksource + kdest*Ksource.m_K];
-					}
-				}
-				m_message->m_data[kdest] = vMin;
-			}
+			SimdMinSumRows(message->m_data, buf->m_data, data, Ksource.m_K, Kdest.m_K);
 		}
 		else
 		{
-			for (kdest=0; kdest<Kdest.m_K; kdest++)
-			{
-				vMin = buf->m_data[0] + data[kdest + 0*Kdest.m_K];
-				for (ksource=1; ksource<Ksource.m_K; ksource++)
-				{
-					if (vMin > buf->m_data[ksource] + data[kdest + ksource*Kdest.m_K])
-					{
-						vMin = buf->m_data[ksource] + data[kdest + ksource*Kdest.m_K];	
-					}
-				}
-				m_message->m_data[kdest] = vMin;
-			}
-		}
-
-		vMin = m_message->m_data[0];
-		for (kdest=1; kdest<Kdest.m_K; kdest++)
-		{
-			if (vMin > m_message->m_data[kdest])
-			{
-				vMin = m_message->m_data[kdest];
-			}
+			SimdMinSumCols(message->m_data, buf->m_data, data, Ksource.m_K, Kdest.m_K);
 		}
 
-		for (kdest=0; kdest<Kdest.m_K; kdest++)
-		{
-			m_message->m_data[kdest] -= vMin;
-		}
+		vMin = SimdMin(message->m_data, Kdest.m_K);
+		SimdSubtract(message->m_data, vMin, Kdest.m_K);
 	}
 	else
 	{
@@ -542,7 +479,7 @@ inline TypeGeneral::REAL TypeGeneral::Edge::UpdateMessage(GlobalSize Kglobal, Lo
 	return vMin;
 }
 
-inline void TypeGeneral::Edge::AddColumn(GlobalSize Kglobal, LocalSize Ksource, LocalSize Kdest, Label ksource, Vector* dest, int dir)
+template <class RealType> inline void TypeGeneralT<RealType>::Edge::AddColumn(GlobalSize Kglobal, LocalSize Ksource, LocalSize Kdest, Label ksource, Vector* dest, int dir)
 {
 	assert(ksource>=0 && ksource<Ksource.m_K);
 
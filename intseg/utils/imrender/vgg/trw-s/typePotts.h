@@ -98,12 +98,14 @@ void testPotts()
 
 #include <string.h>
 #include <assert.h>
+#include "simd.h"
 
 
 template <class T> class MRFEnergy;
 
 
-class TypePotts
+// REAL is double for TypePotts and float for TypePottsFloat
+template <class RealType> class TypePottsT
 {
 
 public:
@@ -111,7 +113,7 @@ public:
 	struct Edge; // stores edge information and either forward or backward message
 	struct Vector; // node parameters and messages
 	typedef int Label;
-	typedef double REAL;
+	typedef RealType REAL;
 	struct GlobalSize; // global information about number of labels
 	struct LocalSize; // local information about number of labels (stored at each node)
 	struct NodeData; // argument to MRFEnergy::AddNode()
@@ -161,7 +163,7 @@ public:
 	//////////////////////////////////////////////////////////////////////////////////
 
 
-friend class MRFEnergy<TypePotts>;
+friend class MRFEnergy<TypePottsT>;
 
 	struct Vector
 	{
@@ -233,31 +235,37 @@ friend class MRFEnergy<TypePotts>;
 
 
 
+typedef TypePottsT<double> TypePotts;
+typedef TypePottsT<float> TypePottsFloat;
+
+
+
+
 //////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////// Implementation ///////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////
 
 
-inline TypePotts::GlobalSize::GlobalSize(int K)
+template <class RealType> inline TypePottsT<RealType>::GlobalSize::GlobalSize(int K)
 {
 	m_K = K;
 }
 
 ///////////////////// NodeData and EdgeData ///////////////////////
 
-inline TypePotts::NodeData::NodeData(REAL* data)
+template <class RealType> inline TypePottsT<RealType>::NodeData::NodeData(REAL* data)
 {
 	m_data = data;
 }
 
-inline TypePotts::EdgeData::EdgeData(REAL lambdaPotts)
+template <class RealType> inline TypePottsT<RealType>::EdgeData::EdgeData(REAL lambdaPotts)
 {
 	m_lambdaPotts = lambdaPotts;
 }
 
 ///////////////////// Vector ///////////////////////
 
-inline int TypePotts::Vector::GetSizeInBytes(GlobalSize Kglobal, LocalSize K)
+template <class RealType> inline int TypePottsT<RealType>::Vector::GetSizeInBytes(GlobalSize Kglobal, LocalSize K)
 {
 	if (Kglobal.m_K < 1)
 	{
@@ -265,12 +273,12 @@ inline int TypePotts::Vector::GetSizeInBytes(GlobalSize Kglobal, LocalSize K)
 	}
 	return Kglobal.m_K*sizeof(REAL);
 }
-inline void TypePotts::Vector::Initialize(GlobalSize Kglobal, LocalSize K, NodeData data)
+template <class RealType> inline void TypePottsT<RealType>::Vector::Initialize(GlobalSize Kglobal, LocalSize K, NodeData data)
 {
 	memcpy(m_data, data.m_data, Kglobal.m_K*sizeof(REAL));
 }
 
-inline void TypePotts::Vector::Add(GlobalSize Kglobal, LocalSize K, NodeData data)
+template <class RealType> inline void TypePottsT<RealType>::Vector::Add(GlobalSize Kglobal, LocalSize K, NodeData data)
 {
 	for (int k=0; k<Kglobal.m_K; k++)
 	{
@@ -278,31 +286,28 @@ inline void TypePotts::Vector::Add(GlobalSize Kglobal, LocalSize K, NodeData dat
 	}
 }
 
-inline void TypePotts::Vector::SetZero(GlobalSize Kglobal, LocalSize K)
+template <class RealType> inline void TypePottsT<RealType>::Vector::SetZero(GlobalSize Kglobal, LocalSize K)
 {
 	memset(m_data, 0, Kglobal.m_K*sizeof(REAL));
 }
 
-inline void TypePotts::Vector::Copy(GlobalSize Kglobal, LocalSize K, Vector* V)
+template <class RealType> inline void TypePottsT<RealType>::Vector::Copy(GlobalSize Kglobal, LocalSize K, Vector* V)
 {
 	memcpy(m_data, V->m_data, Kglobal.m_K*sizeof(REAL));
 }
 
-inline void TypePotts::Vector::Add(GlobalSize Kglobal, LocalSize K, Vector* V)
+template <class RealType> inline void TypePottsT<RealType>::Vector::Add(GlobalSize Kglobal, LocalSize K, Vector* V)
 {
-	for (int k=0; k<Kglobal.m_K; k++)
-	{
-		m_data[k] += V->m_data[k];
-	}
+	SimdAdd(m_data, V->m_data, Kglobal.m_K);
 }
 
-inline TypePotts::REAL TypePotts::Vector::GetValue(GlobalSize Kglobal, LocalSize K, Label k)
+template <class RealType> inline typename TypePottsT<RealType>::REAL TypePottsT<RealType>::Vector::GetValue(GlobalSize Kglobal, LocalSize K, Label k)
 {
 	assert(k>=0 && k<Kglobal.m_K);
 	return m_data[k];
 }
 
-inline TypePotts::REAL TypePotts::Vector::ComputeMin(GlobalSize Kglobal, LocalSize K, Label& kMin)
+template <class RealType> inline typename TypePottsT<RealType>::REAL TypePottsT<RealType>::Vector::ComputeMin(GlobalSize Kglobal, LocalSize K, Label& kMin)
 {
 	REAL vMin = m_data[0];
 	kMin = 0;
@@ -318,27 +323,17 @@ inline TypePotts::REAL TypePotts::Vector::ComputeMin(GlobalSize Kglobal, LocalSi
 	return vMin;
 }
 
-inline TypePotts::REAL TypePotts::Vector::ComputeAndSubtractMin(GlobalSize Kglobal, LocalSize K)
+template <class RealType> inline typename TypePottsT<RealType>::REAL TypePottsT<RealType>::Vector::ComputeAndSubtractMin(GlobalSize Kglobal, LocalSize K)
 {
-	REAL vMin = m_data[0];
-	for (int k=1; k<Kglobal.m_K; k++)
-	{
-		if (vMin > m_data[k])
-		{
-			vMin = m_data[k];
-		}
-	}
-	for (int k=0; k<Kglobal.m_K; k++)
-	{
-		m_data[k] -= vMin;
-	}
+	REAL vMin = SimdMin(m_data, Kglobal.m_K);
+	SimdSubtract(m_data, vMin, Kglobal.m_K);
 
 	return vMin;
 }
 
 ///////////////////// EdgeDataAndMessage implementation /////////////////////////
 
-inline int TypePotts::Edge::GetSizeInBytes(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj, EdgeData data)
+template <class RealType> inline int TypePottsT<RealType>::Edge::GetSizeInBytes(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj, EdgeData data)
 {
 	if (data.m_lambdaPotts < 0)
 	{
@@ -347,55 +342,37 @@ inline int TypePotts::Edge::GetSizeInBytes(GlobalSize Kglobal, LocalSize Ki, Loc
 	return sizeof(Edge) - sizeof(Vector) + Kglobal.m_K*sizeof(REAL);
 }
 
-inline int TypePotts::Edge::GetBufSizeInBytes(int vectorMaxSizeInBytes)
+template <class RealType> inline int TypePottsT<RealType>::Edge::GetBufSizeInBytes(int vectorMaxSizeInBytes)
 {
 	return 0;
 }
 
-inline void TypePotts::Edge::Initialize(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj, EdgeData data, Vector* Di, Vector* Dj)
+template <class RealType> inline void TypePottsT<RealType>::Edge::Initialize(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj, EdgeData data, Vector* Di, Vector* Dj)
 {
 	m_lambdaPotts = data.m_lambdaPotts;
 }
 
-inline TypePotts::Vector* TypePotts::Edge::GetMessagePtr()
+template <class RealType> inline typename TypePottsT<RealType>::Vector* TypePottsT<RealType>::Edge::GetMessagePtr()
 {
 	return &m_message;
 }
 
-inline void TypePotts::Edge::Swap(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj)
+template <class RealType> inline void TypePottsT<RealType>::Edge::Swap(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj)
 {
 }
 
-inline TypePotts::REAL TypePotts::Edge::UpdateMessage(GlobalSize Kglobal, LocalSize Ksource, LocalSize Kdest, Vector* source, REAL gamma, int dir, void* buf)
+template <class RealType> inline typename TypePottsT<RealType>::REAL TypePottsT<RealType>::Edge::UpdateMessage(GlobalSize Kglobal, LocalSize Ksource, LocalSize Kdest, Vector* source, REAL gamma, int dir, void* buf)
 {
-	int k;
 	REAL vMin;
 
-	m_message.m_data[0] = gamma*source->m_data[0] - m_message.m_data[0];
-	vMin = m_message.m_data[0];
-
-	for (k=1; k<Kglobal.m_K; k++)
-	{
-		m_message.m_data[k] = gamma*source->m_data[k] - m_message.m_data[k];
-		if (vMin > m_message.m_data[k])
-		{
-			vMin = m_message.m_data[k];
-		}
-	}
-
-	for (k=0; k<Kglobal.m_K; k++)
-	{
-		m_message.m_data[k] -= vMin;
-		if (m_message.m_data[k] > m_lambdaPotts)
-		{
-			m_message.m_data[k] = m_lambdaPotts;
-		}
-	}
+	SimdGammaDiff(m_message.m_data, source->m_data, m_message.m_data, gamma, Kglobal.m_K);
+	vMin = SimdMin(m_message.m_data, Kglobal.m_K);
+	SimdSubtractTruncate(m_message.m_data, vMin, m_lambdaPotts, Kglobal.m_K);
 
 	return vMin;
 }
 
-inline void TypePotts::Edge::AddColumn(GlobalSize Kglobal, LocalSize Ksource, LocalSize Kdest, Label ksource, Vector* dest, int dir)
+template <class RealType> inline void TypePottsT<RealType>::Edge::AddColumn(GlobalSize Kglobal, LocalSize Ksource, LocalSize Kdest, Label ksource, Vector* dest, int dir)
 {
 	assert(ksource>=0 && ksource<Kglobal.m_K);
 
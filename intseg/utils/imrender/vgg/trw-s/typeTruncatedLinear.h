@@ -104,14 +104,15 @@ void testTruncatedLinear()
 template <class T> class MRFEnergy;
 
 
-class TypeTruncatedLinear
+// REAL is double for TypeTruncatedLinear and float for TypeTruncatedLinearFloat
+template <class RealType> class TypeTruncatedLinearT
 {
 public:
 	// types declarations
 	struct Edge; // stores edge information and either forward or backward message
 	struct Vector; // node parameters and messages
 	typedef int Label;
-	typedef double REAL;
+	typedef RealType REAL;
 	struct GlobalSize; // global information about number of labels
 	struct LocalSize; // local information about number of labels (stored at each node)
 	struct NodeData; // argument to MRFEnergy::AddNode()
@@ -161,7 +162,7 @@ public:
 	//////////////////////////////////////////////////////////////////////////////////
 
 
-friend class MRFEnergy<TypeTruncatedLinear>;
+friend class MRFEnergy<TypeTruncatedLinearT>;
 
 	struct Vector
 	{
@@ -234,24 +235,30 @@ friend class MRFEnergy<TypeTruncatedLinear>;
 
 
 
+typedef TypeTruncatedLinearT<double> TypeTruncatedLinear;
+typedef TypeTruncatedLinearT<float> TypeTruncatedLinearFloat;
+
+
+
+
 //////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////// Implementation ///////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////
 
 
-inline TypeTruncatedLinear::GlobalSize::GlobalSize(int K)
+template <class RealType> inline TypeTruncatedLinearT<RealType>::GlobalSize::GlobalSize(int K)
 {
 	m_K = K;
 }
 
 ///////////////////// NodeData and EdgeData ///////////////////////
 
-inline TypeTruncatedLinear::NodeData::NodeData(REAL* data)
+template <class RealType> inline TypeTruncatedLinearT<RealType>::NodeData::NodeData(REAL* data)
 {
 	m_data = data;
 }
 
-inline TypeTruncatedLinear::EdgeData::EdgeData(REAL alpha, REAL lambda)
+template <class RealType> inline TypeTruncatedLinearT<RealType>::EdgeData::EdgeData(REAL alpha, REAL lambda)
 {
 	m_alpha = alpha;
 	m_lambda = lambda;
@@ -259,7 +266,7 @@ inline TypeTruncatedLinear::EdgeData::EdgeData(REAL alpha, REAL lambda)
 
 ///////////////////// Vector ///////////////////////
 
-inline int TypeTruncatedLinear::Vector::GetSizeInBytes(GlobalSize Kglobal, LocalSize K)
+template <class RealType> inline int TypeTruncatedLinearT<RealType>::Vector::GetSizeInBytes(GlobalSize Kglobal, LocalSize K)
 {
 	if (Kglobal.m_K < 1)
 	{
@@ -267,12 +274,12 @@ inline int TypeTruncatedLinear::Vector::GetSizeInBytes(GlobalSize Kglobal, Local
 	}
 	return Kglobal.m_K*sizeof(REAL);
 }
-inline void TypeTruncatedLinear::Vector::Initialize(GlobalSize Kglobal, LocalSize K, NodeData data)
+template <class RealType> inline void TypeTruncatedLinearT<RealType>::Vector::Initialize(GlobalSize Kglobal, LocalSize K, NodeData data)
 {
 	memcpy(m_data, data.m_data, Kglobal.m_K*sizeof(REAL));
 }
 
-inline void TypeTruncatedLinear::Vector::Add(GlobalSize Kglobal, LocalSize K, NodeData data)
+template <class RealType> inline void TypeTruncatedLinearT<RealType>::Vector::Add(GlobalSize Kglobal, LocalSize K, NodeData data)
 {
 	for (int k=0; k<Kglobal.m_K; k++)
 	{
@@ -280,17 +287,17 @@ inline void TypeTruncatedLinear::Vector::Add(GlobalSize Kglobal, LocalSize K, No
 	}
 }
 
-inline void TypeTruncatedLinear::Vector::SetZero(GlobalSize Kglobal, LocalSize K)
+template <class RealType> inline void TypeTruncatedLinearT<RealType>::Vector::SetZero(GlobalSize Kglobal, LocalSize K)
 {
 	memset(m_data, 0, Kglobal.m_K*sizeof(REAL));
 }
 
-inline void TypeTruncatedLinear::Vector::Copy(GlobalSize Kglobal, LocalSize K, Vector* V)
+template <class RealType> inline void TypeTruncatedLinearT<RealType>::Vector::Copy(GlobalSize Kglobal, LocalSize K, Vector* V)
 {
 	memcpy(m_data, V->m_data, Kglobal.m_K*sizeof(REAL));
 }
 
-inline void TypeTruncatedLinear::Vector::Add(GlobalSize Kglobal, LocalSize K, Vector* V)
+template <class RealType> inline void TypeTruncatedLinearT<RealType>::Vector::Add(GlobalSize Kglobal, LocalSize K, Vector* V)
 {
 	for (int k=0; k<Kglobal.m_K; k++)
 	{
@@ -298,13 +305,13 @@ inline void TypeTruncatedLinear::Vector::Add(GlobalSize Kglobal, LocalSize K, Ve
 	}
 }
 
-inline TypeTruncatedLinear::REAL TypeTruncatedLinear::Vector::GetValue(GlobalSize Kglobal, LocalSize K, Label k)
+template <class RealType> inline typename TypeTruncatedLinearT<RealType>::REAL TypeTruncatedLinearT<RealType>::Vector::GetValue(GlobalSize Kglobal, LocalSize K, Label k)
 {
 	assert(k>=0 && k<Kglobal.m_K);
 	return m_data[k];
 }
 
-inline TypeTruncatedLinear::REAL TypeTruncatedLinear::Vector::ComputeMin(GlobalSize Kglobal, LocalSize K, Label& kMin)
+template <class RealType> inline typename TypeTruncatedLinearT<RealType>::REAL TypeTruncatedLinearT<RealType>::Vector::ComputeMin(GlobalSize Kglobal, LocalSize K, Label& kMin)
 {
 	REAL vMin = m_data[0];
 	kMin = 0;
@@ -320,7 +327,7 @@ inline TypeTruncatedLinear::REAL TypeTruncatedLinear::Vector::ComputeMin(GlobalS
 	return vMin;
 }
 
-inline TypeTruncatedLinear::REAL TypeTruncatedLinear::Vector::ComputeAndSubtractMin(GlobalSize Kglobal, LocalSize K)
+template <class RealType> inline typename TypeTruncatedLinearT<RealType>::REAL TypeTruncatedLinearT<RealType>::Vector::ComputeAndSubtractMin(GlobalSize Kglobal, LocalSize K)
 {
 	REAL vMin = m_data[0];
 	for (int k=1; k<Kglobal.m_K; k++)
@@ -340,7 +347,7 @@ inline TypeTruncatedLinear::REAL TypeTruncatedLinear::Vector::ComputeAndSubtract
 
 ///////////////////// EdgeDataAndMessage implementation /////////////////////////
 
-inline int TypeTruncatedLinear::Edge::GetSizeInBytes(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj, EdgeData data)
+template <class RealType> inline int TypeTruncatedLinearT<RealType>::Edge::GetSizeInBytes(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj, EdgeData data)
 {
 	if (data.m_alpha < 0 || data.m_lambda < 0)
 	{
@@ -349,27 +356,27 @@ inline int TypeTruncatedLinear::Edge::GetSizeInBytes(GlobalSize Kglobal, LocalSi
 	return sizeof(Edge) - sizeof(Vector) + Kglobal.m_K*sizeof(REAL);
 }
 
-inline int TypeTruncatedLinear::Edge::GetBufSizeInBytes(int vectorMaxSizeInBytes)
+template <class RealType> inline int TypeTruncatedLinearT<RealType>::Edge::GetBufSizeInBytes(int vectorMaxSizeInBytes)
 {
 	return 0;
 }
 
-inline void TypeTruncatedLinear::Edge::Initialize(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj, EdgeData data, Vector* Di, Vector* Dj)
+template <class RealType> inline void TypeTruncatedLinearT<RealType>::Edge::Initialize(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj, EdgeData data, Vector* Di, Vector* Dj)
 {
 	m_alpha = data.m_alpha;
 	m_lambda = data.m_lambda;
 }
 
-inline TypeTruncatedLinear::Vector* TypeTruncatedLinear::Edge::GetMessagePtr()
+template <class RealType> inline typename TypeTruncatedLinearT<RealType>::Vector* TypeTruncatedLinearT<RealType>::Edge::GetMessagePtr()
 {
 	return &m_message;
 }
 
-inline void TypeTruncatedLinear::Edge::Swap(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj)
+template <class RealType> inline void TypeTruncatedLinearT<RealType>::Edge::Swap(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj)
 {
 }
 
-inline TypeTruncatedLinear::REAL TypeTruncatedLinear::Edge::UpdateMessage(GlobalSize Kglobal, LocalSize Ksource, LocalSize Kdest, Vector* source, REAL gamma, int dir, void* buf)
+template <class RealType> inline typename TypeTruncatedLinearT<RealType>::REAL TypeTruncatedLinearT<RealType>::Edge::UpdateMessage(GlobalSize Kglobal, LocalSize Ksource, LocalSize Kdest, Vector* source, REAL gamma, int dir, void* buf)
 {
 	int k;
 	REAL vMin;
@@ -413,7 +420,7 @@ inline TypeTruncatedLinear::REAL TypeTruncatedLinear::Edge::UpdateMessage(Global
 	return vMin;
 }
 
-inline void TypeTruncatedLinear::Edge::AddColumn(GlobalSize Kglobal, LocalSize Ksource, LocalSize Kdest, Label ksource, Vector* dest, int dir)
+template <class RealType> inline void TypeTruncatedLinearT<RealType>::Edge::AddColumn(GlobalSize Kglobal, LocalSize Ksource, LocalSize Kdest, Label ksource, Vector* dest, int dir)
 {
 	assert(ksource>=0 && ksource<Kglobal.m_K);
 
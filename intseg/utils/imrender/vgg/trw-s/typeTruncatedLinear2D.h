@@ -112,7 +112,8 @@ void testTruncatedLinear2D()
 template <class T> class MRFEnergy;
 
 
-class TypeTruncatedLinear2D
+// REAL is double for TypeTruncatedLinear2D and float for TypeTruncatedLinear2DFloat
+template <class RealType> class TypeTruncatedLinear2DT
 {
 
 public:
@@ -123,7 +124,7 @@ public:
 	{
 		int		m_kx, m_ky;
 	};
-	typedef double REAL;
+	typedef RealType REAL;
 	struct GlobalSize; // global information about number of labels
 	struct LocalSize; // local information about number of labels (stored at each node)
 	struct NodeData; // argument to MRFEnergy::AddNode()
@@ -174,7 +175,7 @@ public:
 	//////////////////////////////////////////////////////////////////////////////////
 
 
-friend class MRFEnergy<TypeTruncatedLinear2D>;
+friend class MRFEnergy<TypeTruncatedLinear2DT>;
 
 	struct Vector
 	{
@@ -247,12 +248,18 @@ friend class MRFEnergy<TypeTruncatedLinear2D>;
 
 
 
+typedef TypeTruncatedLinear2DT<double> TypeTruncatedLinear2D;
+typedef TypeTruncatedLinear2DT<float> TypeTruncatedLinear2DFloat;
+
+
+
+
 //////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////// Implementation ///////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////
 
 
-inline TypeTruncatedLinear2D::GlobalSize::GlobalSize(int KX, int KY)
+template <class RealType> inline TypeTruncatedLinear2DT<RealType>::GlobalSize::GlobalSize(int KX, int KY)
 {
 	m_KX = KX;
 	m_KY = KY;
@@ -261,12 +268,12 @@ inline TypeTruncatedLinear2D::GlobalSize::GlobalSize(int KX, int KY)
 
 ///////////////////// NodeData and EdgeData ///////////////////////
 
-inline TypeTruncatedLinear2D::NodeData::NodeData(REAL* data)
+template <class RealType> inline TypeTruncatedLinear2DT<RealType>::NodeData::NodeData(REAL* data)
 {
 	m_data = data;
 }
 
-inline TypeTruncatedLinear2D::EdgeData::EdgeData(REAL alphaX, REAL alphaY, REAL lambda)
+template <class RealType> inline TypeTruncatedLinear2DT<RealType>::EdgeData::EdgeData(REAL alphaX, REAL alphaY, REAL lambda)
 {
 	m_alphaX = alphaX;
 	m_alphaY = alphaY;
@@ -275,7 +282,7 @@ inline TypeTruncatedLinear2D::EdgeData::EdgeData(REAL alphaX, REAL alphaY, REAL
 
 ///////////////////// Vector ///////////////////////
 
-inline int TypeTruncatedLinear2D::Vector::GetSizeInBytes(GlobalSize Kglobal, LocalSize K)
+template <class RealType> inline int TypeTruncatedLinear2DT<RealType>::Vector::GetSizeInBytes(GlobalSize Kglobal, LocalSize K)
 {
 	if (Kglobal.m_KX < 1 || Kglobal.m_KY < 2)
 	{
@@ -283,12 +290,12 @@ inline int TypeTruncatedLinear2D::Vector::GetSizeInBytes(GlobalSize Kglobal, Loc
 	}
 	return Kglobal.m_K*sizeof(REAL);
 }
-inline void TypeTruncatedLinear2D::Vector::Initialize(GlobalSize Kglobal, LocalSize K, NodeData data)
+template <class RealType> inline void TypeTruncatedLinear2DT<RealType>::Vector::Initialize(GlobalSize Kglobal, LocalSize K, NodeData data)
 {
 	memcpy(m_data, data.m_data, Kglobal.m_K*sizeof(REAL));
 }
 
-inline void TypeTruncatedLinear2D::Vector::Add(GlobalSize Kglobal, LocalSize K, NodeData data)
+template <class RealType> inline void TypeTruncatedLinear2DT<RealType>::Vector::Add(GlobalSize Kglobal, LocalSize K, NodeData data)
 {
 	for (int k=0; k<Kglobal.m_K; k++)
 	{
@@ -296,17 +303,17 @@ inline void TypeTruncatedLinear2D::Vector::Add(GlobalSize Kglobal, LocalSize K,
 	}
 }
 
-inline void TypeTruncatedLinear2D::Vector::SetZero(GlobalSize Kglobal, LocalSize K)
+template <class RealType> inline void TypeTruncatedLinear2DT<RealType>::Vector::SetZero(GlobalSize Kglobal, LocalSize K)
 {
 	memset(m_data, 0, Kglobal.m_K*sizeof(REAL));
 }
 
-inline void TypeTruncatedLinear2D::Vector::Copy(GlobalSize Kglobal, LocalSize K, Vector* V)
+template <class RealType> inline void TypeTruncatedLinear2DT<RealType>::Vector::Copy(GlobalSize Kglobal, LocalSize K, Vector* V)
 {
 	memcpy(m_data, V->m_data, Kglobal.m_K*sizeof(REAL));
 }
 
-inline void TypeTruncatedLinear2D::Vector::Add(GlobalSize Kglobal, LocalSize K, Vector* V)
+template <class RealType> inline void TypeTruncatedLinear2DT<RealType>::Vector::Add(GlobalSize Kglobal, LocalSize K, Vector* V)
 {
 	for (int k=0; k<Kglobal.m_K; k++)
 	{
@@ -314,13 +321,13 @@ inline void TypeTruncatedLinear2D::Vector::Add(GlobalSize Kglobal, LocalSize K,
 	}
 }
 
-inline TypeTruncatedLinear2D::REAL TypeTruncatedLinear2D::Vector::GetValue(GlobalSize Kglobal, LocalSize K, Label k)
+template <class RealType> inline typename TypeTruncatedLinear2DT<RealType>::REAL TypeTruncatedLinear2DT<RealType>::Vector::GetValue(GlobalSize Kglobal, LocalSize K, Label k)
 {
 	assert(k.m_kx>=0 && k.m_kx<Kglobal.m_KX && k.m_ky>=0 && k.m_ky<Kglobal.m_KY);
 	return m_data[k.m_kx + k.m_ky*Kglobal.m_KX];
 }
 
-inline TypeTruncatedLinear2D::REAL TypeTruncatedLinear2D::Vector::ComputeMin(GlobalSize Kglobal, LocalSize K, Label& _kMin)
+template <class RealType> inline typename TypeTruncatedLinear2DT<RealType>::REAL TypeTruncatedLinear2DT<RealType>::Vector::ComputeMin(GlobalSize Kglobal, LocalSize K, Label& _kMin)
 {
 	REAL vMin = m_data[0];
 	int kMin = 0;
@@ -339,7 +346,7 @@ inline TypeTruncatedLinear2D::REAL TypeTruncatedLinear2D::Vector::ComputeMin(Glo
 	return vMin;
 }
 
-inline TypeTruncatedLinear2D::REAL TypeTruncatedLinear2D::Vector::ComputeAndSubtractMin(GlobalSize Kglobal, LocalSize K)
+template <class RealType> inline typename TypeTruncatedLinear2DT<RealType>::REAL TypeTruncatedLinear2DT<RealType>::Vector::ComputeAndSubtractMin(GlobalSize Kglobal, LocalSize K)
 {
 	REAL vMin = m_data[0];
 	for (int k=1; k<Kglobal.m_K; k++)
@@ -359,7 +366,7 @@ inline TypeTruncatedLinear2D::REAL TypeTruncatedLinear2D::Vector::ComputeAndSubt
 
 ///////////////////// EdgeDataAndMessage implementation /////////////////////////
 
-inline int TypeTruncatedLinear2D::Edge::GetSizeInBytes(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj, EdgeData data)
+template <class RealType> inline int TypeTruncatedLinear2DT<RealType>::Edge::GetSizeInBytes(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj, EdgeData data)
 {
 	if (data.m_alphaX < 0 || data.m_alphaY < 0 || data.m_lambda < 0)
 	{
@@ -368,28 +375,28 @@ inline int TypeTruncatedLinear2D::Edge::GetSizeInBytes(GlobalSize Kglobal, Local
 	return sizeof(Edge) - sizeof(Vector) + Kglobal.m_K*sizeof(REAL);
 }
 
-inline int TypeTruncatedLinear2D::Edge::GetBufSizeInBytes(int vectorMaxSizeInBytes)
+template <class RealType> inline int TypeTruncatedLinear2DT<RealType>::Edge::GetBufSizeInBytes(int vectorMaxSizeInBytes)
 {
 	return 0;
 }
 
-inline void TypeTruncatedLinear2D::Edge::Initialize(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj, EdgeData data, Vector* Di, Vector* Dj)
+template <class RealType> inline void TypeTruncatedLinear2DT<RealType>::Edge::Initialize(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj, EdgeData data, Vector* Di, Vector* Dj)
 {
 	m_alphaX = data.m_alphaX;
 	m_alphaY = data.m_alphaY;
 	m_lambda = data.m_lambda;
 }
 
-inline TypeTruncatedLinear2D::Vector* TypeTruncatedLinear2D::Edge::GetMessagePtr()
+template <class RealType> inline typename TypeTruncatedLinear2DT<RealType>::Vector* TypeTruncatedLinear2DT<RealType>::Edge::GetMessagePtr()
 {
 	return &m_message;
 }
 
-inline void TypeTruncatedLinear2D::Edge::Swap(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj)
+template <class RealType> inline void TypeTruncatedLinear2DT<RealType>::Edge::Swap(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj)
 {
 }
 
-inline TypeTruncatedLinear2D::REAL TypeTruncatedLinear2D::Edge::UpdateMessage(GlobalSize Kglobal, LocalSize Ksource, LocalSize Kdest, Vector* source, REAL gamma, int dir, void* buf)
+template <class RealType> inline typename TypeTruncatedLinear2DT<RealType>::REAL TypeTruncatedLinear2DT<RealType>::Edge::UpdateMessage(GlobalSize Kglobal, LocalSize Ksource, LocalSize Kdest, Vector* source, REAL gamma, int dir, void* buf)
 {
 	Label k;
 	REAL vMin;
@@ -441,7 +448,7 @@ inline TypeTruncatedLinear2D::REAL TypeTruncatedLinear2D::Edge::UpdateMessage(Gl
 	return vMin;
 }
 
-inline void TypeTruncatedLinear2D::Edge::AddColumn(GlobalSize Kglobal, LocalSize Ksource, LocalSize Kdest, Label ksource, Vector* dest, int dir)
+template <class RealType> inline void TypeTruncatedLinear2DT<RealType>::Edge::AddColumn(GlobalSize Kglobal, LocalSize Ksource, LocalSize Kdest, Label ksource, Vector* dest, int dir)
 {
 	assert(ksource.m_kx>=0 && ksource.m_kx<Kglobal.m_KX && ksource.m_ky>=0 && ksource.m_ky<Kglobal.m_KY);
 
@@ -104,14 +104,15 @@ void testTruncatedQuadratic()
 template <class T> class MRFEnergy;
 
 
-class TypeTruncatedQuadratic
+// REAL is double for TypeTruncatedQuadratic and float for TypeTruncatedQuadraticFloat
+template <class RealType> class TypeTruncatedQuadraticT
 {
 public:
 	// types declarations
 	struct Edge; // stores edge information and either forward or backward message
 	struct Vector; // node parameters and messages
 	typedef int Label;
-	typedef double REAL;
+	typedef RealType REAL;
 	struct GlobalSize; // global information about number of labels
 	struct LocalSize; // local information about number of labels (stored at each node)
 	struct NodeData; // argument to MRFEnergy::AddNode()
@@ -162,7 +163,7 @@ public:
 	////////////////////////// Visible only to MRFEnergy /////////////////////////////
 	//////////////////////////////////////////////////////////////////////////////////
 
-friend class MRFEnergy<TypeTruncatedQuadratic>;
+friend class MRFEnergy<TypeTruncatedQuadraticT>;
 
 	struct Vector
 	{
@@ -239,24 +240,30 @@ friend class MRFEnergy<TypeTruncatedQuadratic>;
 
 
 
+typedef TypeTruncatedQuadraticT<double> TypeTruncatedQuadratic;
+typedef TypeTruncatedQuadraticT<float> TypeTruncatedQuadraticFloat;
+
+
+
+
 //////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////// Implementation ///////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////
 
 
-inline TypeTruncatedQuadratic::GlobalSize::GlobalSize(int K)
+template <class RealType> inline TypeTruncatedQuadraticT<RealType>::GlobalSize::GlobalSize(int K)
 {
 	m_K = K;
 }
 
 ///////////////////// NodeData and EdgeData ///////////////////////
 
-inline TypeTruncatedQuadratic::NodeData::NodeData(REAL* data)
+template <class RealType> inline TypeTruncatedQuadraticT<RealType>::NodeData::NodeData(REAL* data)
 {
 	m_data = data;
 }
 
-inline TypeTruncatedQuadratic::EdgeData::EdgeData(REAL alpha, REAL lambda)
+template <class RealType> inline TypeTruncatedQuadraticT<RealType>::EdgeData::EdgeData(REAL alpha, REAL lambda)
 {
 	m_alpha = alpha;
 	m_lambda = lambda;
@@ -264,7 +271,7 @@ inline TypeTruncatedQuadratic::EdgeData::EdgeData(REAL alpha, REAL lambda)
 
 ///////////////////// Vector ///////////////////////
 
-inline int TypeTruncatedQuadratic::Vector::GetSizeInBytes(GlobalSize Kglobal, LocalSize K)
+template <class RealType> inline int TypeTruncatedQuadraticT<RealType>::Vector::GetSizeInBytes(GlobalSize Kglobal, LocalSize K)
 {
 	if (Kglobal.m_K < 1)
 	{
@@ -272,12 +279,12 @@ inline int TypeTruncatedQuadratic::Vector::GetSizeInBytes(GlobalSize Kglobal, Lo
 	}
 	return Kglobal.m_K*sizeof(REAL);
 }
-inline void TypeTruncatedQuadratic::Vector::Initialize(GlobalSize Kglobal, LocalSize K, NodeData data)
+template <class RealType> inline void TypeTruncatedQuadraticT<RealType>::Vector::Initialize(GlobalSize Kglobal, LocalSize K, NodeData data)
 {
 	memcpy(m_data, data.m_data, Kglobal.m_K*sizeof(REAL));
 }
 
-inline void TypeTruncatedQuadratic::Vector::Add(GlobalSize Kglobal, LocalSize K, NodeData data)
+template <class RealType> inline void TypeTruncatedQuadraticT<RealType>::Vector::Add(GlobalSize Kglobal, LocalSize K, NodeData data)
 {
 	for (int k=0; k<Kglobal.m_K; k++)
 	{
@@ -285,17 +292,17 @@ inline void TypeTruncatedQuadratic::Vector::Add(GlobalSize Kglobal, LocalSize K,
 	}
 }
 
-inline void TypeTruncatedQuadratic::Vector::SetZero(GlobalSize Kglobal, LocalSize K)
+template <class RealType> inline void TypeTruncatedQuadraticT<RealType>::Vector::SetZero(GlobalSize Kglobal, LocalSize K)
 {
 	memset(m_data, 0, Kglobal.m_K*sizeof(REAL));
 }
 
-inline void TypeTruncatedQuadratic::Vector::Copy(GlobalSize Kglobal, LocalSize K, Vector* V)
+template <class RealType> inline void TypeTruncatedQuadraticT<RealType>::Vector::Copy(GlobalSize Kglobal, LocalSize K, Vector* V)
 {
 	memcpy(m_data, V->m_data, Kglobal.m_K*sizeof(REAL));
 }
 
-inline void TypeTruncatedQuadratic::Vector::Add(GlobalSize Kglobal, LocalSize K, Vector* V)
+template <class RealType> inline void TypeTruncatedQuadraticT<RealType>::Vector::Add(GlobalSize Kglobal, LocalSize K, Vector* V)
 {
 	for (int k=0; k<Kglobal.m_K; k++)
 	{
@@ -303,13 +310,13 @@ inline void TypeTruncatedQuadratic::Vector::Add(GlobalSize Kglobal, LocalSize K,
 	}
 }
 
-inline TypeTruncatedQuadratic::REAL TypeTruncatedQuadratic::Vector::GetValue(GlobalSize Kglobal, LocalSize K, Label k)
+template <class RealType> inline typename TypeTruncatedQuadraticT<RealType>::REAL TypeTruncatedQuadraticT<RealType>::Vector::GetValue(GlobalSize Kglobal, LocalSize K, Label k)
 {
 	assert(k>=0 && k<Kglobal.m_K);
 	return m_data[k];
 }
 
-inline TypeTruncatedQuadratic::REAL TypeTruncatedQuadratic::Vector::ComputeMin(GlobalSize Kglobal, LocalSize K, Label& kMin)
+template <class RealType> inline typename TypeTruncatedQuadraticT<RealType>::REAL TypeTruncatedQuadraticT<RealType>::Vector::ComputeMin(GlobalSize Kglobal, LocalSize K, Label& kMin)
 {
 	REAL vMin = m_data[0];
 	kMin = 0;
@@ -325,7 +332,7 @@ inline TypeTruncatedQuadratic::REAL TypeTruncatedQuadratic::Vector::ComputeMin(G
 	return vMin;
 }
 
-inline TypeTruncatedQuadratic::REAL TypeTruncatedQuadratic::Vector::ComputeAndSubtractMin(GlobalSize Kglobal, LocalSize K)
+template <class RealType> inline typename TypeTruncatedQuadraticT<RealType>::REAL TypeTruncatedQuadraticT<RealType>::Vector::ComputeAndSubtractMin(GlobalSize Kglobal, LocalSize K)
 {
 	REAL vMin = m_data[0];
 	for (int k=1; k<Kglobal.m_K; k++)
@@ -345,7 +352,7 @@ inline TypeTruncatedQuadratic::REAL TypeTruncatedQuadratic::Vector::ComputeAndSu
 
 ///////////////////// EdgeDataAndMessage implementation /////////////////////////
 
-inline int TypeTruncatedQuadratic::Edge::GetSizeInBytes(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj, EdgeData data)
+template <class RealType> inline int TypeTruncatedQuadraticT<RealType>::Edge::GetSizeInBytes(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj, EdgeData data)
 {
 	if (data.m_alpha < 0 || data.m_lambda < 0)
 	{
@@ -354,28 +361,28 @@ inline int TypeTruncatedQuadratic::Edge::GetSizeInBytes(GlobalSize Kglobal, Loca
 	return sizeof(Edge) - sizeof(Vector) + Kglobal.m_K*sizeof(REAL);
 }
 
-inline int TypeTruncatedQuadratic::Edge::GetBufSizeInBytes(int vectorMaxSizeInBytes)
+template <class RealType> inline int TypeTruncatedQuadraticT<RealType>::Edge::GetBufSizeInBytes(int vectorMaxSizeInBytes)
 {
 	int K = vectorMaxSizeInBytes / sizeof(REAL);
 	return K*sizeof(REAL) + (2*K+1)*sizeof(int);
 }
 
-inline void TypeTruncatedQuadratic::Edge::Initialize(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj, EdgeData data, Vector* Di, Vector* Dj)
+template <class RealType> inline void TypeTruncatedQuadraticT<RealType>::Edge::Initialize(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj, EdgeData data, Vector* Di, Vector* Dj)
 {
 	m_alpha = data.m_alpha;
 	m_lambda = data.m_lambda;
 }
 
-inline TypeTruncatedQuadratic::Vector* TypeTruncatedQuadratic::Edge::GetMessagePtr()
+template <class RealType> inline typename TypeTruncatedQuadraticT<RealType>::Vector* TypeTruncatedQuadraticT<RealType>::Edge::GetMessagePtr()
 {
 	return &m_message;
 }
 
-inline void TypeTruncatedQuadratic::Edge::Swap(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj)
+template <class RealType> inline void TypeTruncatedQuadraticT<RealType>::Edge::Swap(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj)
 {
 }
 
-inline TypeTruncatedQuadratic::REAL TypeTruncatedQuadratic::Edge::UpdateMessage(GlobalSize Kglobal, LocalSize Ksource, LocalSize Kdest, Vector* source, REAL gamma, int dir, void* _buf)
+template <class RealType> inline typename TypeTruncatedQuadraticT<RealType>::REAL TypeTruncatedQuadraticT<RealType>::Edge::UpdateMessage(GlobalSize Kglobal, LocalSize Ksource, LocalSize Kdest, Vector* source, REAL gamma, int dir, void* _buf)
 {
 	REAL* buf = (REAL*) _buf;
 	int* parabolas = (int*) ((char*)_buf + Kglobal.m_K*sizeof(REAL));
@@ -419,7 +426,7 @@ inline TypeTruncatedQuadratic::REAL TypeTruncatedQuadratic::Edge::UpdateMessage(
 	return vMin;
 }
 
-inline void TypeTruncatedQuadratic::Edge::AddColumn(GlobalSize Kglobal, LocalSize Ksource, LocalSize Kdest, Label ksource, Vector* dest, int dir)
+template <class RealType> inline void TypeTruncatedQuadraticT<RealType>::Edge::AddColumn(GlobalSize Kglobal, LocalSize Ksource, LocalSize Kdest, Label ksource, Vector* dest, int dir)
 {
 	assert(ksource>=0 && ksource<Kglobal.m_K);
 
@@ -441,7 +448,7 @@ inline void TypeTruncatedQuadratic::Edge::AddColumn(GlobalSize Kglobal, LocalSiz
 
 
 
-inline void TypeTruncatedQuadratic::Edge::DistanceTransformL2(int K, REAL* source, REAL* dest, int* parabolas, int* intersections)
+template <class RealType> inline void TypeTruncatedQuadraticT<RealType>::Edge::DistanceTransformL2(int K, REAL* source, REAL* dest, int* parabolas, int* intersections)
 {
 	assert(m_alpha > 0);
 
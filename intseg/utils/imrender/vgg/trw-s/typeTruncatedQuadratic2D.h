@@ -112,7 +112,8 @@ void testTruncatedLinear2D()
 template <class T> class MRFEnergy;
 
 
-class TypeTruncatedQuadratic2D
+// REAL is double for TypeTruncatedQuadratic2D and float for TypeTruncatedQuadratic2DFloat
+template <class RealType> class TypeTruncatedQuadratic2DT
 {
 public:
 	// types declarations
@@ -122,7 +123,7 @@ public:
 	{
 		int		m_kx, m_ky;
 	};
-	typedef double REAL;
+	typedef RealType REAL;
 	struct GlobalSize; // global information about number of labels
 	struct LocalSize; // local information about number of labels (stored at each node)
 	struct NodeData; // argument to MRFEnergy::AddNode()
@@ -174,7 +175,7 @@ public:
 	//////////////////////////////////////////////////////////////////////////////////
 
 
-friend class MRFEnergy<TypeTruncatedQuadratic2D>;
+friend class MRFEnergy<TypeTruncatedQuadratic2DT>;
 
 	struct Vector
 	{
@@ -251,12 +252,18 @@ friend class MRFEnergy<TypeTruncatedQuadratic2D>;
 
 
 
+typedef TypeTruncatedQuadratic2DT<double> TypeTruncatedQuadratic2D;
+typedef TypeTruncatedQuadratic2DT<float> TypeTruncatedQuadratic2DFloat;
+
+
+
+
 //////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////// Implementation ///////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////
 
 
-inline TypeTruncatedQuadratic2D::GlobalSize::GlobalSize(int KX, int KY)
+template <class RealType> inline TypeTruncatedQuadratic2DT<RealType>::GlobalSize::GlobalSize(int KX, int KY)
 {
 	m_KX = KX;
 	m_KY = KY;
@@ -265,12 +272,12 @@ inline TypeTruncatedQuadratic2D::GlobalSize::GlobalSize(int KX, int KY)
 
 ///////////////////// NodeData and EdgeData ///////////////////////
 
-inline TypeTruncatedQuadratic2D::NodeData::NodeData(REAL* data)
+template <class RealType> inline TypeTruncatedQuadratic2DT<RealType>::NodeData::NodeData(REAL* data)
 {
 	m_data = data;
 }
 
-inline TypeTruncatedQuadratic2D::EdgeData::EdgeData(REAL alphaX, REAL alphaY, REAL lambda)
+template <class RealType> inline TypeTruncatedQuadratic2DT<RealType>::EdgeData::EdgeData(REAL alphaX, REAL alphaY, REAL lambda)
 {
 	m_alphaX = alphaX;
 	m_alphaY = alphaY;
@@ -279,7 +286,7 @@ inline TypeTruncatedQuadratic2D::EdgeData::EdgeData(REAL alphaX, REAL alphaY, RE
 
 ///////////////////// Vector ///////////////////////
 
-inline int TypeTruncatedQuadratic2D::Vector::GetSizeInBytes(GlobalSize Kglobal, LocalSize K)
+template <class RealType> inline int TypeTruncatedQuadratic2DT<RealType>::Vector::GetSizeInBytes(GlobalSize Kglobal, LocalSize K)
 {
 	if (Kglobal.m_KX < 1 || Kglobal.m_KY < 1)
 	{
@@ -287,12 +294,12 @@ inline int TypeTruncatedQuadratic2D::Vector::GetSizeInBytes(GlobalSize Kglobal,
 	}
 	return Kglobal.m_K*sizeof(REAL);
 }
-inline void TypeTruncatedQuadratic2D::Vector::Initialize(GlobalSize Kglobal, LocalSize K, NodeData data)
+template <class RealType> inline void TypeTruncatedQuadratic2DT<RealType>::Vector::Initialize(GlobalSize Kglobal, LocalSize K, NodeData data)
 {
 	memcpy(m_data, data.m_data, Kglobal.m_K*sizeof(REAL));
 }
 
-inline void TypeTruncatedQuadratic2D::Vector::Add(GlobalSize Kglobal, LocalSize K, NodeData data)
+template <class RealType> inline void TypeTruncatedQuadratic2DT<RealType>::Vector::Add(GlobalSize Kglobal, LocalSize K, NodeData data)
 {
 	for (int k=0; k<Kglobal.m_K; k++)
 	{
@@ -300,17 +307,17 @@ inline void TypeTruncatedQuadratic2D::Vector::Add(GlobalSize Kglobal, LocalSize
 	}
 }
 
-inline void TypeTruncatedQuadratic2D::Vector::SetZero(GlobalSize Kglobal, LocalSize K)
+template <class RealType> inline void TypeTruncatedQuadratic2DT<RealType>::Vector::SetZero(GlobalSize Kglobal, LocalSize K)
 {
 	memset(m_data, 0, Kglobal.m_K*sizeof(REAL));
 }
 
-inline void TypeTruncatedQuadratic2D::Vector::Copy(GlobalSize Kglobal, LocalSize K, Vector* V)
+template <class RealType> inline void TypeTruncatedQuadratic2DT<RealType>::Vector::Copy(GlobalSize Kglobal, LocalSize K, Vector* V)
 {
 	memcpy(m_data, V->m_data, Kglobal.m_K*sizeof(REAL));
 }
 
-inline void TypeTruncatedQuadratic2D::Vector::Add(GlobalSize Kglobal, LocalSize K, Vector* V)
+template <class RealType> inline void TypeTruncatedQuadratic2DT<RealType>::Vector::Add(GlobalSize Kglobal, LocalSize K, Vector* V)
 {
 	for (int k=0; k<Kglobal.m_K; k++)
 	{
@@ -318,13 +325,13 @@ inline void TypeTruncatedQuadratic2D::Vector::Add(GlobalSize Kglobal, LocalSize
 	}
 }
 
-inline TypeTruncatedQuadratic2D::REAL TypeTruncatedQuadratic2D::Vector::GetValue(GlobalSize Kglobal, LocalSize K, Label k)
+template <class RealType> inline typename TypeTruncatedQuadratic2DT<RealType>::REAL TypeTruncatedQuadratic2DT<RealType>::Vector::GetValue(GlobalSize Kglobal, LocalSize K, Label k)
 {
 	assert(k.m_kx>=0 && k.m_kx<Kglobal.m_KX && k.m_ky>=0 && k.m_ky<Kglobal.m_KY);
 	return m_data[k.m_kx + k.m_ky*Kglobal.m_KX];
 }
 
-inline TypeTruncatedQuadratic2D::REAL TypeTruncatedQuadratic2D::Vector::ComputeMin(GlobalSize Kglobal, LocalSize K, Label& _kMin)
+template <class RealType> inline typename TypeTruncatedQuadratic2DT<RealType>::REAL TypeTruncatedQuadratic2DT<RealType>::Vector::ComputeMin(GlobalSize Kglobal, LocalSize K, Label& _kMin)
 {
 	REAL vMin = m_data[0];
 	int kMin = 0;
@@ -343,7 +350,7 @@ inline TypeTruncatedQuadratic2D::REAL TypeTruncatedQuadratic2D::Vector::ComputeM
 	return vMin;
 }
 
-inline TypeTruncatedQuadratic2D::REAL TypeTruncatedQuadratic2D::Vector::ComputeAndSubtractMin(GlobalSize Kglobal, LocalSize K)
+template <class RealType> inline typename TypeTruncatedQuadratic2DT<RealType>::REAL TypeTruncatedQuadratic2DT<RealType>::Vector::ComputeAndSubtractMin(GlobalSize Kglobal, LocalSize K)
 {
 	REAL vMin = m_data[0];
 	for (int k=1; k<Kglobal.m_K; k++)
@@ -363,7 +370,7 @@ inline TypeTruncatedQuadratic2D::REAL TypeTruncatedQuadratic2D::Vector::ComputeA
 
 ///////////////////// EdgeDataAndMessage implementation /////////////////////////
 
-inline int TypeTruncatedQuadratic2D::Edge::GetSizeInBytes(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj, EdgeData data)
+template <class RealType> inline int TypeTruncatedQuadratic2DT<RealType>::Edge::GetSizeInBytes(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj, EdgeData data)
 {
 	if (data.m_alphaX < 0 || data.m_alphaY < 0 || data.m_lambda < 0)
 	{
@@ -372,29 +379,29 @@ inline int TypeTruncatedQuadratic2D::Edge::GetSizeInBytes(GlobalSize Kglobal, Lo
 	return sizeof(Edge) - sizeof(Vector) + Kglobal.m_K*sizeof(REAL);
 }
 
-inline int TypeTruncatedQuadratic2D::Edge::GetBufSizeInBytes(int vectorMaxSizeInBytes)
+template <class RealType> inline int TypeTruncatedQuadratic2DT<RealType>::Edge::GetBufSizeInBytes(int vectorMaxSizeInBytes)
 {
 	int K = vectorMaxSizeInBytes / sizeof(REAL);
 	return K*sizeof(REAL) + (2*K+1)*sizeof(int);
 }
 
-inline void TypeTruncatedQuadratic2D::Edge::Initialize(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj, EdgeData data, Vector* Di, Vector* Dj)
+template <class RealType> inline void TypeTruncatedQuadratic2DT<RealType>::Edge::Initialize(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj, EdgeData data, Vector* Di, Vector* Dj)
 {
 	m_alphaX = data.m_alphaX;
 	m_alphaY = data.m_alphaY;
 	m_lambda = data.m_lambda;
 }
 
-inline TypeTruncatedQuadratic2D::Vector* TypeTruncatedQuadratic2D::Edge::GetMessagePtr()
+template <class RealType> inline typename TypeTruncatedQuadratic2DT<RealType>::Vector* TypeTruncatedQuadratic2DT<RealType>::Edge::GetMessagePtr()
 {
 	return &m_message;
 }
 
-inline void TypeTruncatedQuadratic2D::Edge::Swap(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj)
+template <class RealType> inline void TypeTruncatedQuadratic2DT<RealType>::Edge::Swap(GlobalSize Kglobal, LocalSize Ki, LocalSize Kj)
 {
 }
 
-inline TypeTruncatedQuadratic2D::REAL TypeTruncatedQuadratic2D::Edge::UpdateMessage(GlobalSize Kglobal, LocalSize Ksource, LocalSize Kdest, Vector* source, REAL gamma, int dir, void* _buf)
+template <class RealType> inline typename TypeTruncatedQuadratic2DT<RealType>::REAL TypeTruncatedQuadratic2DT<RealType>::Edge::UpdateMessage(GlobalSize Kglobal, LocalSize Ksource, LocalSize Kdest, Vector* source, REAL gamma, int dir, void* _buf)
 {
 	REAL* buf = (REAL*) _buf;
 	int* parabolas = (int*) ((char*)_buf + Kglobal.m_K*sizeof(REAL));
@@ -442,7 +449,7 @@ inline TypeTruncatedQuadratic2D::REAL TypeTruncatedQuadratic2D::Edge::UpdateMess
 	return vMin;
 }
 
-inline void TypeTruncatedQuadratic2D::Edge::AddColumn(GlobalSize Kglobal, LocalSize Ksource, LocalSize Kdest, Label ksource, Vector* dest, int dir)
+template <class RealType> inline void TypeTruncatedQuadratic2DT<RealType>::Edge::AddColumn(GlobalSize Kglobal, LocalSize Ksource, LocalSize Kdest, Label ksource, Vector* dest, int dir)
 {
 	assert(ksource.m_kx>=0 && ksource.m_kx<Kglobal.m_KX && ksource.m_ky>=0 && ksource.m_ky<Kglobal.m_KY);
 
@@ -463,7 +470,7 @@ inline void TypeTruncatedQuadratic2D::Edge::AddColumn(GlobalSize Kglobal, LocalS
 
 
 
-inline void TypeTruncatedQuadratic2D::Edge::DistanceTransformL2(int K, int stride, REAL alpha, REAL* source, REAL* dest, int* parabolas, int* intersections)
+template <class RealType> inline void TypeTruncatedQuadratic2DT<RealType>::Edge::DistanceTransformL2(int K, int stride, REAL alpha, REAL* source, REAL* dest, int* parabolas, int* intersections)
 {
 	assert(alpha >= 0);
 
@@ -64,6 +64,10 @@ if compile
         case {'mexglx', 'mexa64'}
             str = '"-O3 -ffast-math -funroll-loops"';
             flags = sprintf('%s CXXOPTIMFLAGS=%s LDCXXOPTIMFLAGS=%s LDOPTIMFLAGS=%s', flags, str, str, str);
+            % OpenMP, used by the multithreaded code paths
+            flags = sprintf('%s CXXFLAGS="$CXXFLAGS -fopenmp" LDFLAGS="$LDFLAGS -fopenmp"', flags);
+        case {'mexw32', 'mexw64'}
+            flags = sprintf('%s COMPFLAGS="$COMPFLAGS /openmp"', flags);
         otherwise
     end
 
@@ -0,0 +1,180 @@
+//[ue pe total] = vgg_mrf_energy(state, UE, PI, PE, [TI, TE]);
+
+// Energies of a batch of labellings of an MRF with tabular unary, pairwise
+// and triple clique terms. Cliques of each order are summed by one loop,
+// which reads the labels of the clique's nodes, and from them the entry of
+// the clique's energy table. The loops over cliques run in parallel.
+
+#include <mex.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Copies a matrix of 1-based indices (or labels), read as rows x cols, into
+// 0-based ints, checking that each row is in the range [1, max_val[row]]
+template<class T> static inline bool convert_indices(const T *in, int *out, int rows, int cols, const int *max_val)
+{
+	for (int j = 0; j < cols; j++) {
+		for (int r = 0; r < rows; r++, in++, out++) {
+			if (!(*in >= 1 && (double)*in <= max_val[r]))
+				return false;
+			*out = (int)*in - 1;
+		}
+	}
+	return true;
+}
+
+static int *read_indices(const mxArray *A, int rows, const int *max_val, const char *err)
+{
+	int cols = mxGetNumberOfElements(A) / rows;
+	int *out = new int[rows*cols];
+	const void *in = mxGetData(A);
+	bool okay = false;
+	switch (mxGetClassID(A)) {
+		case mxDOUBLE_CLASS:
+			okay = convert_indices((const double *)in, out, rows, cols, max_val);
+			break;
+		case mxSINGLE_CLASS:
+			okay = convert_indices((const float *)in, out, rows, cols, max_val);
+			break;
+		case mxINT32_CLASS:
+			okay = convert_indices((const int *)in, out, rows, cols, max_val);
+			break;
+		case mxUINT32_CLASS:
+			okay = convert_indices((const unsigned int *)in, out, rows, cols, max_val);
+			break;
+		case mxINT16_CLASS:
+			okay = convert_indices((const short *)in, out, rows, cols, max_val);
+			break;
+		case mxUINT16_CLASS:
+			okay = convert_indices((const unsigned short *)in, out, rows, cols, max_val);
+			break;
+		case mxUINT8_CLASS:
+			okay = convert_indices((const unsigned char *)in, out, rows, cols, max_val);
+			break;
+		default:
+			delete[] out;
+			mexErrMsgTxt("Unsupported type of state or clique list.");
+			break;
+	}
+	if (!okay) {
+		delete[] out;
+		mexErrMsgTxt(err);
+	}
+	return out;
+}
+
+// Adds to energy[m] the energy of the cliques of the given order in the mth
+// labelling. The first order rows of list give the nodes of each clique,
+// and the optional last row the column of the energy table to use (if list
+// is NULL, clique c is the single node c). Entries of the table are ordered with the label of the first node
+// varying fastest.
+template<class T> static void clique_energy(double *energy, const int *state, int n_nodes, int M, int n_states, const int *list, int rows, int n_cliques, int order, const T *table)
+{
+	int table_size = 1;
+	for (int k = 0; k < order; k++)
+		table_size *= n_states;
+
+	for (int m = 0; m < M; m++, state += n_nodes) {
+		double E = 0;
+		int c;
+#pragma omp parallel for if (n_cliques > 10000) num_threads(omp_get_num_procs()) default(shared) private(c) reduction(+:E)
+		for (c = 0; c < n_cliques; c++) {
+			if (!list) {
+				E += (double)table[n_states*c + state[c]];
+				continue;
+			}
+			const int *clique = &list[rows*c];
+			int ind = 0;
+			for (int k = order-1; k >= 0; k--)
+				ind = ind * n_states + state[clique[k]];
+			E += (double)table[table_size*(rows > order ? clique[order] : c) + ind];
+		}
+		energy[m] += E;
+	}
+}
+
+static void add_clique_energy(double *energy, const int *state, int n_nodes, int M, int n_states, const mxArray *list_in, const mxArray *table_in, int order)
+{
+	// Check the clique list and energy table
+	int rows = list_in ? mxGetM(list_in) : order;
+	int n_cliques = list_in ? mxGetN(list_in) : n_nodes;
+	int n_tables = mxGetN(table_in);
+	int table_size = 1;
+	for (int k = 0; k < order; k++)
+		table_size *= n_states;
+	if (rows != order && rows != order+1)
+		mexErrMsgTxt("Unexpected dimensions for clique list.");
+	if ((int)mxGetM(table_in) != table_size)
+		mexErrMsgTxt("Unexpected dimensions for clique energies.");
+	if (rows == order && n_tables != n_cliques)
+		mexErrMsgTxt("Without explicit indices, clique list and energies should have the same number of columns.");
+	int max_val[4] = {n_nodes, n_nodes, n_nodes, n_nodes};
+	max_val[order] = n_tables;
+	int *list = NULL;
+	if (list_in)
+		list = read_indices(list_in, rows, max_val, "Clique list references invalid node or energy table.");
+
+	const void *table = mxGetData(table_in);
+	switch (mxGetClassID(table_in)) {
+		case mxDOUBLE_CLASS:
+			clique_energy(energy, state, n_nodes, M, n_states, list, rows, n_cliques, order, (const double *)table);
+			break;
+		case mxSINGLE_CLASS:
+			clique_energy(energy, state, n_nodes, M, n_states, list, rows, n_cliques, order, (const float *)table);
+			break;
+		case mxINT32_CLASS:
+			clique_energy(energy, state, n_nodes, M, n_states, list, rows, n_cliques, order, (const int *)table);
+			break;
+		default:
+			delete[] list;
+			mexErrMsgTxt("Energies must be double, single or int32.");
+			break;
+	}
+	delete[] list;
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+	// Check number of inputs
+	if (nrhs != 4 && nrhs != 6)
+		mexErrMsgTxt("Unexpected number of input arguments.");
+	if (nlhs > 3)
+		mexErrMsgTxt("Unexpected number of outputs.");
+	for (int i = 0; i < nrhs; i++) {
+		if (mxIsComplex(prhs[i]))
+			mexErrMsgTxt("Inputs must be real.");
+	}
+
+	// Read the labellings
+	int n_states = mxGetM(prhs[1]);
+	int n_nodes = mxGetN(prhs[1]);
+	if (n_states < 1)
+		mexErrMsgTxt("Unexpected dimensions for UE.");
+	if ((int)mxGetM(prhs[0]) != n_nodes)
+		mexErrMsgTxt("state must have one row per node.");
+	int M = mxGetN(prhs[0]);
+	int *state = read_indices(prhs[0], 1, &n_states, "state references invalid label.");
+
+	// Sum the energies of each order of clique
+	double *ue = new double[3*M];
+	double *pe = ue + M;
+	double *te = pe + M;
+	for (int m = 0; m < 3*M; m++)
+		ue[m] = 0;
+	add_clique_energy(ue, state, n_nodes, M, n_states, NULL, prhs[1], 1);
+	add_clique_energy(pe, state, n_nodes, M, n_states, prhs[2], prhs[3], 2);
+	if (nrhs > 4)
+		add_clique_energy(te, state, n_nodes, M, n_states, prhs[4], prhs[5], 3);
+	delete[] state;
+
+	// Create the outputs
+	for (int i = 0; i < 3 && i < (nlhs > 0 ? nlhs : 1); i++) {
+		plhs[i] = mxCreateDoubleMatrix(1, M, mxREAL);
+		double *out = mxGetPr(plhs[i]);
+		for (int m = 0; m < M; m++)
+			out[m] = i < 2 ? ue[i*M+m] : ue[m] + pe[m] + te[m];
+	}
+	delete[] ue;
+	return;
+}
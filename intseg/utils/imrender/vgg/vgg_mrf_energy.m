@@ -0,0 +1,41 @@
+%VGG_MRF_ENERGY  Energies of a batch of labellings of an MRF
+%
+%   [ue pe total] = vgg_mrf_energy(state, UE, PI, PE, [TI, TE])
+%
+% Computes the unary, pairwise and total energies of one or more
+% labellings of an MRF with tabular unary, pairwise and (optionally)
+% triple clique energies. The inputs are as for GET_STATE_ENERGY. The sums
+% over cliques are computed in parallel if compiled with OpenMP.
+%
+% IN:
+%   state - NxM matrix of labels (1-based), the mth column giving the
+%           labelling of N nodes to evaluate.
+%   UE - SxN matrix of unary terms, for S states.
+%   PI - {2,3}xP matrix, each column containing the following information
+%        on an edge: [start_node end_node [pairwise_energy_table_index]].
+%        If there are only 2 rows then pairwise_energy_table_index is
+%        assumed to be the column number, therefore you must have P == Q.
+%   PE - S^2xQ pairwise energy table, each column containing the energies
+%        [E11 E21 ... ES1 E12 ... ESS] for a given edge (e.g. [E00 E10 E01
+%        E11] for binary MRFs, with 0-based labels).
+%   TI - {3,4}xR matrix of triple cliques: [node1 node2 node3
+%        [triple_clique_energy_table_index]], as for PI.
+%   TE - S^3xT triple clique energy table, the label of node1 varying
+%        fastest.
+%
+%   State and clique lists can be double, single, or any integer type up
+%   to 32 bits. Energy tables can be double, single or int32.
+%
+% OUT:
+%   ue - 1xM vector of the unary energies of the labellings.
+%   pe - 1xM vector of the pairwise energies of the labellings.
+%   total - 1xM vector of the total energies, including the triple
+%           cliques.
+%
+% See also GET_STATE_ENERGY.
+
+function varargout = vgg_mrf_energy(varargin)
+funcName = mfilename;
+sourceList = {[funcName '.cxx']};
+vgg_mexcompile_script; % Compilation happens in this script
+return
@@ -1,21 +1,33 @@
 // Calls Valdimir Kolmogorov's QPBO code, downloaded from:
 // http://www.adastral.ucl.ac.uk/~vladkolm/software.html
 
-// L = vgg_qpbo(UE, PI, PE[, TI, TE], [params]);
+// [L stats] = vgg_qpbo(UE, PI, PE[, TI, TE], [params]);
 // T UE 2xM matrix of unary terms for M nodes, or scalar = M if all unary terms are zero
 // uint32 PI 2or3xN matrix, each column [start_node end_node [pairwise_energy_table_index]]
 // T PE 4xP pairwise energy table, each column [E00 E01 E10 E11]
 // uint32 TI 3or4xQ matrix, each column [node1 node2 node3 [triple_energy_table_index]]
 // T TE 8xR triple clique energy table, each column [E000 E001 E010 E011 E100 E101 E110 E111]
+// T is int16, int32, int64, single or double
 
 #include "QPBO.h"
+#include "vgg_qpbo.h"
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 static void erfunc(char *err) {mexErrMsgTxt(err);}
 template<class INPUT, class INTERNAL> static inline void wrapper_func(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[], INTERNAL infinite_edge_cost);
+template<class INPUT> static void integer_wrapper_func(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[], int largerInternal);
+static void check_inputs(int nlhs, int nrhs, const mxArray *prhs[]);
 
 // Define types
 #ifdef _MSC_VER
 #pragma warning(disable: 4661)
+typedef __int16 int16_t;
 typedef __int32 int32_t;
 typedef __int64 int64_t;
 typedef unsigned __int32 uint32_t;
@@ -37,8 +49,8 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 		mexErrMsgTxt("Types of the input arguments don't agree.");
 
 	// Do we want a larger internal representation
-	bool largerInternal = nrhs == 4 || nrhs == 6;
-    if (largerInternal) {
+	int largerInternal = 0;
+    if (nrhs == 4 || nrhs == 6) {
         const mxArray *paramsArray = prhs[nrhs-1];
         if (mxIsCell(paramsArray)) {
             if (mxGetNumberOfElements(paramsArray) < 1 || mxGetNumberOfElements(paramsArray) > 2)
@@ -47,19 +59,28 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
         }
 		if (!mxIsInt32(paramsArray))
 			mexErrMsgTxt("options should be int32s");
-        largerInternal = mxGetNumberOfElements(paramsArray) > 3 && ((const int32_t *)mxGetData(paramsArray))[3];
+        if (mxGetNumberOfElements(paramsArray) > 3)
+            largerInternal = (int)((const int32_t *)mxGetData(paramsArray))[3];
     }
+	check_inputs(nlhs, nrhs, prhs);
 
 	// Call the wrapper function according to the input type
 	switch (in_class) {
+		case mxINT16_CLASS:
+			integer_wrapper_func<int16_t>(nlhs, plhs, nrhs, prhs, largerInternal);
+			break;
 		case mxINT32_CLASS:
-			if (largerInternal)
-				wrapper_func<int32_t, int64_t>(nlhs, plhs, nrhs, prhs, (int64_t)1<<47);
-			else
-				wrapper_func<int32_t, int32_t>(nlhs, plhs, nrhs, prhs, (int32_t)1<<20);
+			integer_wrapper_func<int32_t>(nlhs, plhs, nrhs, prhs, largerInternal);
 			break;
 		case mxINT64_CLASS:
-			wrapper_func<int64_t, int64_t>(nlhs, plhs, nrhs, prhs, (int64_t)1<<47);
+			integer_wrapper_func<int64_t>(nlhs, plhs, nrhs, prhs, largerInternal);
+			break;
+		case mxSINGLE_CLASS:
+			mexPrintf("Warning: using non-integer energies removes optimality guarantees!\n");
+			if (largerInternal)
+				wrapper_func<float, double>(nlhs, plhs, nrhs, prhs, (double)1e100);
+			else
+				wrapper_func<float, float>(nlhs, plhs, nrhs, prhs, (float)1e30);
 			break;
 		case mxDOUBLE_CLASS:
 			mexPrintf("Warning: using non-integer energies removes optimality guarantees!\n");
@@ -72,7 +93,8 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 	return;
 }
 
-template<class INPUT, class INTERNAL> static inline void wrapper_func(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[], INTERNAL infinite_edge_cost)
+// Checks the dimensions and types of the inputs
+static void check_inputs(int nlhs, int nrhs, const mxArray *prhs[])
 {
 	// Check inputs and outputs
 	if (nlhs < 1 || nlhs > 2)
@@ -82,74 +104,44 @@ template<class INPUT, class INTERNAL> static inline void wrapper_func(int nlhs,
 			mexErrMsgTxt("Inputs must be real.");
 	}
 
-	// Check types and dimensions, and get pointers
+	// Check types and dimensions
 	int Pindices = mxGetM(prhs[1]);
 	if (Pindices != 2 && Pindices != 3)
 		mexErrMsgTxt("Unexpected dimensions for PI");
-	int nP = mxGetN(prhs[1]);
-	int nPE = mxGetN(prhs[2]);
-	if (Pindices == 2 && nP != nPE)
+	if (Pindices == 2 && mxGetN(prhs[1]) != mxGetN(prhs[2]))
 		mexErrMsgTxt("Without explicit indices, PI and PE should have the same number of columns");
 	if (mxGetM(prhs[2]) != 4)
 		mexErrMsgTxt("Unexpected dimensions for PE");
 	if (!mxIsUint32(prhs[1]))
 		mexErrMsgTxt("PI should be uint32s");
-	int nU;
-	if (mxGetNumberOfElements(prhs[0]) == 1)
-		nU = (int)mxGetScalar(prhs[0]);
-	else {
-		if (mxGetM(prhs[0]) != 2)
-			mexErrMsgTxt("Unexpected dimensions for U");
-		nU = mxGetN(prhs[0]);
-	}
-	int nT = 0;
-	int nTE = 0;
-	int Tindices = 0;
-	const INPUT *U = (const INPUT *)mxGetData(prhs[0]);
-	const INPUT *PE = (const INPUT *)mxGetData(prhs[2]);
-	const INPUT *TE = (const INPUT *)NULL;
-	const uint32_t *PI = (const uint32_t *)mxGetData(prhs[1]);
-	const uint32_t *TI = (const uint32_t *)NULL;
+	if (mxGetNumberOfElements(prhs[0]) != 1 && mxGetM(prhs[0]) != 2)
+		mexErrMsgTxt("Unexpected dimensions for U");
 	if (nrhs > 4) {
-		Tindices = mxGetM(prhs[3]);
+		int Tindices = mxGetM(prhs[3]);
 		if (Tindices != 3 && Tindices != 4)
 			mexErrMsgTxt("Unexpected dimensions for TI");
-		nT = mxGetN(prhs[3]);
-		nTE = mxGetN(prhs[4]);
-		if (Tindices == 3 && nT != nTE)
+		if (Tindices == 3 && mxGetN(prhs[3]) != mxGetN(prhs[4]))
 			mexErrMsgTxt("Without explicit indices, TI and TE should have the same number of columns");
 		if (mxGetM(prhs[4]) != 8)
 			mexErrMsgTxt("Unexpected dimensions for TE");
 		if (!mxIsUint32(prhs[3]))
 			mexErrMsgTxt("TI should be uint32s");
-		TE = (const INPUT *)mxGetData(prhs[4]);
-		TI = (const uint32_t *)mxGetData(prhs[3]);
-	}
-	// Default options
-	int firstNNodes = nU; // Only return labels of first N nodes
-	int improveMethod = 0; // Method to improve unknown nodes: 0 - none, 1 - improve (assume 0 best), 2 - optimal splice
-	int contractIters = 0; // Number of contract cycles to try
-	if (nrhs == 4 || nrhs == 6) {
-        const mxArray *paramsArray = prhs[nrhs-1];
-        if (mxIsCell(paramsArray))
-            paramsArray = mxGetCell(paramsArray, 0);
-		const int32_t *params = (const int32_t *)mxGetData(paramsArray);
-		switch (mxGetNumberOfElements(paramsArray)) {
-			default:
-			case 3:
-				contractIters = (int)params[2];
-			case 2:
-				improveMethod = (int)params[1];
-			case 1:
-				firstNNodes = (int)params[0];
-				firstNNodes = nU < firstNNodes ? nU : firstNNodes;
-			case 0:
-				break;
-		}
 	}
+}
 
-	// Define the graph
-	QPBO<INTERNAL> *graph = new QPBO<INTERNAL>(nU+nT, nP+6*nT, erfunc);
+// Adds the unary, pairwise and triple clique terms of the inputs to graph,
+// which is a QPBO<REAL> or a CapacityBound. Returns the number of nodes,
+// including those added for triple cliques.
+template<class INPUT, class REAL, class GRAPH> static int add_terms(GRAPH *graph, int nrhs, const mxArray *prhs[])
+{
+	// Get pointers and dimensions
+	int nU = mxGetNumberOfElements(prhs[0]) == 1 ? (int)mxGetScalar(prhs[0]) : mxGetN(prhs[0]);
+	int Pindices = mxGetM(prhs[1]);
+	int nP = mxGetN(prhs[1]);
+	int nPE = mxGetN(prhs[2]);
+	const INPUT *U = (const INPUT *)mxGetData(prhs[0]);
+	const INPUT *PE = (const INPUT *)mxGetData(prhs[2]);
+	const uint32_t *PI = (const uint32_t *)mxGetData(prhs[1]);
 
 	// Create graph nodes
 	int start_node = graph->AddNode(nU);
@@ -159,7 +151,7 @@ template<class INPUT, class INTERNAL> static inline void wrapper_func(int nlhs,
 	if (mxGetNumberOfElements(prhs[0]) > 1) {
 		for (int nodeInd = 0; nodeInd < nU; nodeInd++) {
 			// Add unary potetial
-			graph->AddUnaryTerm(nodeInd, (INTERNAL)U[0], (INTERNAL)U[1]);
+			graph->AddUnaryTerm(nodeInd, (REAL)U[0], (REAL)U[1]);
 			U += 2;
 		}
 	}
@@ -183,12 +175,17 @@ template<class INPUT, class INTERNAL> static inline void wrapper_func(int nlhs,
 		//if (PE_ptr[0] + PE_ptr[3] > PE_ptr[1] + PE_ptr[2])
 		//	countIrregular++;
 
-		graph->AddPairwiseTerm(PI[0]-1, PI[1]-1, (INTERNAL)INPUT_ptr[0], (INTERNAL)INPUT_ptr[1], (INTERNAL)INPUT_ptr[2], (INTERNAL)INPUT_ptr[3]);
+		graph->AddPairwiseTerm(PI[0]-1, PI[1]-1, (REAL)INPUT_ptr[0], (REAL)INPUT_ptr[1], (REAL)INPUT_ptr[2], (REAL)INPUT_ptr[3]);
 	}
 
 	// Enter triple clique terms
 	int nNodes = nU;
-	if (nT) {
+	if (nrhs > 4 && mxGetN(prhs[3])) {
+		int Tindices = mxGetM(prhs[3]);
+		int nT = mxGetN(prhs[3]);
+		int nTE = mxGetN(prhs[4]);
+		const INPUT *TE = (const INPUT *)mxGetData(prhs[4]);
+		const uint32_t *TI = (const uint32_t *)mxGetData(prhs[3]);
 		INPUT_ptr = TE - 8;
 		UL_end = &TI[Tindices*nT];
 		for (; TI < UL_end; TI += Tindices) {
@@ -206,16 +203,16 @@ template<class INPUT, class INTERNAL> static inline void wrapper_func(int nlhs,
 			int node2 = TI[1] - 1;
 			int	node3 = TI[2] - 1;
 
-			INTERNAL A = (INTERNAL)INPUT_ptr[0]; // E000
-			INTERNAL B = (INTERNAL)INPUT_ptr[1]; // E001
-			INTERNAL C = (INTERNAL)INPUT_ptr[2]; // E010
-			INTERNAL D = (INTERNAL)INPUT_ptr[3]; // E011
-			INTERNAL E = (INTERNAL)INPUT_ptr[4]; // E100
-			INTERNAL F = (INTERNAL)INPUT_ptr[5]; // E101
-			INTERNAL G = (INTERNAL)INPUT_ptr[6]; // E110
-			INTERNAL H = (INTERNAL)INPUT_ptr[7]; // E111
+			REAL A = (REAL)INPUT_ptr[0]; // E000
+			REAL B = (REAL)INPUT_ptr[1]; // E001
+			REAL C = (REAL)INPUT_ptr[2]; // E010
+			REAL D = (REAL)INPUT_ptr[3]; // E011
+			REAL E = (REAL)INPUT_ptr[4]; // E100
+			REAL F = (REAL)INPUT_ptr[5]; // E101
+			REAL G = (REAL)INPUT_ptr[6]; // E110
+			REAL H = (REAL)INPUT_ptr[7]; // E111
 
-			INTERNAL pi = (A + D + F + G) - (B + C + E + H);
+			REAL pi = (A + D + F + G) - (B + C + E + H);
 
 			if (pi >= 0) {
 				graph->AddPairwiseTerm(node1, node2, 0, C-A, 0, G-E);
@@ -260,6 +257,263 @@ template<class INPUT, class INTERNAL> static inline void wrapper_func(int nlhs,
 		// Merge edges
 		graph->MergeParallelEdges();
 	}
+	return nNodes;
+}
+
+// Calls the wrapper function for integer energies with an internal type
+// chosen by largerInternal (0 - the input type, 1 - a type twice as large,
+// 2 - the smallest type the graph fits in), after bounding the capacities
+// of the graph. Errors if the capacities can overflow the chosen type,
+// rather than return a wrong cut.
+template<class INPUT> static void integer_wrapper_func(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[], int largerInternal)
+{
+	// Bound the capacities and terms
+	double capacity, max_term;
+	{
+		CapacityBound bound(mxGetNumberOfElements(prhs[0]) == 1 ? (int)mxGetScalar(prhs[0]) : mxGetN(prhs[0]));
+		add_terms<INPUT, double>(&bound, nrhs, prhs);
+		capacity = bound.MaxCapacity();
+		max_term = bound.MaxTerm();
+	}
+	if (nrhs > 4) {
+		// Triple clique energies are summed in fours in the internal type
+		const INPUT *TE = (const INPUT *)mxGetData(prhs[4]);
+		for (int i = 0; i < (int)mxGetNumberOfElements(prhs[4]); i++)
+			max_term = std::max(max_term, 4 * fabs((double)TE[i]));
+	}
+
+	// Choose the internal type. int16 energies use int32 capacities, as the
+	// nodes and arcs of the graph would be no smaller with int16 ones.
+	int bytes = sizeof(INPUT);
+	if (largerInternal == 1)
+		bytes = std::min(2 * bytes, 8);
+	else if (largerInternal == 2) {
+		bytes = 4;
+		while (bytes < 8 && !integer_type_fits(bytes, capacity, max_term))
+			bytes *= 2;
+	}
+	bytes = std::max(bytes, 4);
+	if (!integer_type_fits(bytes, capacity, max_term))
+		mexErrMsgTxt("Energies too large: the capacities of the graph may overflow. Use a larger internal type (LargerInternal option), or smaller energies.");
+
+	switch (bytes) {
+		case 4:
+			wrapper_func<INPUT, int32_t>(nlhs, plhs, nrhs, prhs, (int32_t)1<<20);
+			break;
+		default:
+			wrapper_func<INPUT, int64_t>(nlhs, plhs, nrhs, prhs, (int64_t)1<<47);
+			break;
+	}
+}
+
+// Random permutation of order, using rand()
+static void shuffle(int *order, int n)
+{
+	for (int i = 0; i < n-1; i++) {
+		int j = i + (int)(((double)rand() / ((double)RAND_MAX+1)) * (n - i));
+		code_assert(j<n);
+		int k = order[j];
+		order[j] = order[i];
+		order[i] = k;
+	}
+}
+
+// Orders nodes by the region they belong to
+struct RegionOrder
+{
+	const int *region;
+	RegionOrder(const int *r) : region(r) {}
+	bool operator()(int a, int b) const { return region[a] < region[b] || (region[a] == region[b] && a < b); }
+};
+
+// Parallel QPBO-P: each iteration tests every unlabelled node (see
+// QPBO::ProbeNodes()), the nodes being shared among the threads, each of
+// which works on its own copy of the graph. The nodes are tested region by
+// region, so that each thread mostly works on one part of the graph. The
+// labels found are then fixed in the graph with hard constraints, and it is
+// solved again. Unlike QPBO::Probe() nodes are not contracted, so the graph
+// keeps its nodes. The result does not depend on the number of threads.
+// Only the first nTest nodes are tested. Returns false if a node could not
+// be fixed.
+template<class INTERNAL> static bool parallel_probe(QPBO<INTERNAL> *graph, int nTest, int iters, int num_threads, INTERNAL infinite_edge_cost)
+{
+	int nNodes = graph->GetNodeNum();
+	int *fixed = new int[3*nNodes];
+	int *order = fixed + nNodes;
+	int *region = order + nNodes;
+	bool okay = true;
+
+	for (int iter = 0; iter < iters && okay; iter++) {
+		// Unlabelled nodes, grouped by region
+		int nOrder = 0;
+		for (int i = 0; i < nNodes; i++) {
+			fixed[i] = -1;
+			if (i < nTest && graph->GetLabel(i) < 0) {
+				region[i] = graph->GetRegion(i);
+				order[nOrder++] = i;
+			}
+		}
+		if (!nOrder)
+			break;
+		std::sort(order, order+nOrder, RegionOrder(region));
+
+		int nFixed = 0;
+#ifdef _OPENMP
+		#pragma omp parallel num_threads(num_threads)
+#endif
+		{
+			QPBO<INTERNAL> copy(*graph);
+			copy.Solve();
+			int *fixed_local = new int[nNodes];
+			for (int i = 0; i < nNodes; i++)
+				fixed_local[i] = -1;
+			bool okay_local = true;
+#ifdef _OPENMP
+			#pragma omp for schedule(dynamic, 16)
+#endif
+			for (int k = 0; k < nOrder; k++) {
+				if (okay_local && copy.ProbeNodes(1, &order[k], fixed_local) < 0)
+					okay_local = false;
+			}
+#ifdef _OPENMP
+			#pragma omp critical
+#endif
+			{
+				okay = okay && okay_local;
+				for (int i = 0; i < nNodes; i++) {
+					if (fixed_local[i] >= 0 && fixed[i] < 0) {
+						fixed[i] = fixed_local[i];
+						nFixed++;
+					}
+				}
+			}
+			delete[] fixed_local;
+		}
+		if (!nFixed)
+			break;
+
+		// Fix the labels found, and solve again
+		for (int i = 0; i < nNodes; i++) {
+			if (fixed[i] == 0)
+				graph->AddUnaryTerm(i, 0, infinite_edge_cost);
+			else if (fixed[i] == 1)
+				graph->AddUnaryTerm(i, infinite_edge_cost, 0);
+		}
+		graph->Solve();
+		graph->ComputeWeakPersistencies();
+	}
+
+	delete[] fixed;
+	return okay;
+}
+
+// Twice the energy of a labelling, up to a constant. Unlike
+// QPBO::ComputeTwiceEnergy() it is summed in double, so cannot overflow a
+// small internal type.
+template<class INTERNAL> static double twice_energy(QPBO<INTERNAL> *graph, const int *labels)
+{
+	double energy = 0;
+	INTERNAL E1[2], E2[2][2];
+	for (int i = 0; i < graph->GetNodeNum(); i++) {
+		graph->GetTwiceUnaryTerm(i, E1[0], E1[1]);
+		if (labels[i] == 1)
+			energy += (double)E1[1];
+	}
+	int i, j;
+	for (int e = graph->GetNextEdgeId(-1); e >= 0; e = graph->GetNextEdgeId(e)) {
+		graph->GetTwicePairwiseTerm(e, i, j, E2[0][0], E2[0][1], E2[1][0], E2[1][1]);
+		energy += (double)E2[labels[i] == 1][labels[j] == 1] - (double)E2[0][0];
+	}
+	return energy;
+}
+
+// QPBO-I from several random orders of the nodes in parallel, each on its
+// own copy of the graph. The orders are generated before the threads start,
+// so the result only depends on the state of rand(). Writes the labelling
+// of lowest energy (the first one in case of ties) to labels, of size
+// graph->GetNodeNum().
+template<class INTERNAL> static void parallel_improve(QPBO<INTERNAL> *graph, int N, const int *improve_order, int starts, int num_threads, int *labels)
+{
+	int nGraph = graph->GetNodeNum();
+	int *orders = new int[starts*N];
+	int *all_labels = new int[starts*nGraph];
+	for (int s = 0; s < starts; s++) {
+		for (int i = 0; i < N; i++)
+			orders[s*N+i] = improve_order[i];
+		shuffle(&orders[s*N], N);
+	}
+
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(dynamic, 1) num_threads(num_threads)
+#endif
+	for (int s = 0; s < starts; s++) {
+		QPBO<INTERNAL> copy(*graph);
+		copy.Improve(N, &orders[s*N]);
+		for (int i = 0; i < nGraph; i++)
+			all_labels[s*nGraph+i] = copy.GetLabel(i);
+	}
+
+	// Keep the best labelling
+	int best = 0;
+	double best_energy = twice_energy(graph, all_labels);
+	for (int s = 1; s < starts; s++) {
+		double energy = twice_energy(graph, &all_labels[s*nGraph]);
+		if (energy < best_energy) {
+			best_energy = energy;
+			best = s;
+		}
+	}
+	for (int i = 0; i < nGraph; i++)
+		labels[i] = all_labels[best*nGraph+i];
+	delete[] all_labels;
+	delete[] orders;
+}
+
+template<class INPUT, class INTERNAL> static inline void wrapper_func(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[], INTERNAL infinite_edge_cost)
+{
+	// Number of nodes, and number of edges and triple cliques
+	int nU = mxGetNumberOfElements(prhs[0]) == 1 ? (int)mxGetScalar(prhs[0]) : mxGetN(prhs[0]);
+	int nP = mxGetN(prhs[1]);
+	int nT = nrhs > 4 ? mxGetN(prhs[3]) : 0;
+
+	// Default options
+	int firstNNodes = nU; // Only return labels of first N nodes
+	int improveMethod = 0; // Method to improve unknown nodes: 0 - none, 1 - improve (assume 0 best), 2 - optimal splice
+	int contractIters = 0; // Number of contract cycles to try
+	int numThreads = 1; // Number of threads for QPBO-P and QPBO-I; > 1 selects parallel QPBO-P
+	int improveStarts = 1; // Number of random orders to run QPBO-I from
+	int seed = 0; // Seed of rand(), if > 0
+	if (nrhs == 4 || nrhs == 6) {
+        const mxArray *paramsArray = prhs[nrhs-1];
+        if (mxIsCell(paramsArray))
+            paramsArray = mxGetCell(paramsArray, 0);
+		const int32_t *params = (const int32_t *)mxGetData(paramsArray);
+		switch (mxGetNumberOfElements(paramsArray)) {
+			default:
+			case 7:
+				seed = (int)params[6];
+			case 6:
+				improveStarts = (int)params[5];
+			case 5:
+				numThreads = (int)params[4];
+			case 4:
+			case 3:
+				contractIters = (int)params[2];
+			case 2:
+				improveMethod = (int)params[1];
+			case 1:
+				firstNNodes = (int)params[0];
+				firstNNodes = nU < firstNNodes ? nU : firstNNodes;
+			case 0:
+				break;
+		}
+	}
+
+	// Define the graph
+	QPBO<INTERNAL> *graph = new QPBO<INTERNAL>(nU+nT, nP+6*nT, erfunc);
+
+	// Enter the terms
+	int nNodes = add_terms<INPUT, INTERNAL>(graph, nrhs, prhs);
 
 	// Solve for optimimum
 	graph->Solve();
@@ -289,7 +543,23 @@ template<class INPUT, class INTERNAL> static inline void wrapper_func(int nlhs,
 		for (int i = 0; i < nNodes; i++)
 			mapping[i] = i * 2;
 
-		if (contractIters > 0) {
+		if (contractIters > 0 && numThreads > 1) {
+			// Parallel probe steps (no contraction, so the mapping stays the same)
+			if (!parallel_probe(graph, firstNNodes, contractIters, numThreads, infinite_edge_cost)) {
+				delete[] mapping;
+				delete[] listUnlabel;
+				delete graph;
+				mexErrMsgTxt("Probe can't fix nodes - overflow likely.");
+			}
+
+			// Read out entire labelling again
+			countUnlabelAfterProbe = 0;
+			for (int nodeCount = 0; nodeCount < firstNNodes; nodeCount++) {
+				labelOutPtr[nodeCount] = (int32_t)graph->GetLabel(nodeCount);
+				if (labelOutPtr[nodeCount] < 0)
+					listUnlabel[countUnlabelAfterProbe++] = nodeCount;
+			}
+		} else if (contractIters > 0) {
 			// Probe options
 			typename QPBO<INTERNAL>::ProbeOptions options;
 			options.C = infinite_edge_cost;
@@ -384,22 +654,30 @@ skip_point:
                 }
             }
             
-            // Randomize order
-            for (int i = 0; i < countUnlabelAfterProbe-1; i++) {
-                int j = i + (int)(((double)rand() / ((double)RAND_MAX+1)) * (countUnlabelAfterProbe - i));
-                code_assert(j<countUnlabelAfterProbe);
-                int k = improve_order[j];
-                improve_order[j] = improve_order[i];
-                improve_order[i] = k;
+            if (seed > 0)
+                srand(seed);
+            if (improveStarts > 1) {
+                // Run QPBO-I from several random orders, keeping the best
+                int *improved = new int[graph->GetNodeNum()];
+                parallel_improve(graph, countUnlabelAfterProbe, improve_order, improveStarts, numThreads, improved);
+                delete improve_order;
+
+                // Read out the labels
+                for (int nodeCount=0; nodeCount<countUnlabelAfterProbe; nodeCount++)
+                    labelOutPtr[listUnlabel[nodeCount]] = (int32_t)((improved[mapping[listUnlabel[nodeCount]]/2] + mapping[listUnlabel[nodeCount]]) % 2);
+                delete[] improved;
+            } else {
+                // Randomize order
+                shuffle(improve_order, countUnlabelAfterProbe);
+
+                // Run QPBO-I
+                graph->Improve(countUnlabelAfterProbe, improve_order);
+                delete improve_order;
+
+                // Read out the labels
+                for (int nodeCount=0; nodeCount<countUnlabelAfterProbe; nodeCount++)
+                    labelOutPtr[listUnlabel[nodeCount]] = (int32_t)((graph->GetLabel(mapping[listUnlabel[nodeCount]]/2) + mapping[listUnlabel[nodeCount]]) % 2);
             }
-            
-            // Run QPBO-I
-            graph->Improve(countUnlabelAfterProbe, improve_order);
-            delete improve_order;
-            
-            // Read out the labels
-            for (int nodeCount=0; nodeCount<countUnlabelAfterProbe; nodeCount++)
-                labelOutPtr[listUnlabel[nodeCount]] = (int32_t)((graph->GetLabel(mapping[listUnlabel[nodeCount]]/2) + mapping[listUnlabel[nodeCount]]) % 2);
         }
 		delete mapping;
 	}
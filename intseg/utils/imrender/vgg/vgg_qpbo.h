@@ -0,0 +1,137 @@
+// Shared by vgg_qpbo and vgg_qpbo_divmbest: bounds on the capacities of the
+// graph that QPBO builds, used to check that integer energies cannot
+// overflow the internal type.
+
+#ifndef __VGG_QPBO_H__
+#define __VGG_QPBO_H__
+
+#include <mex.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+// Define types
+#ifdef _MSC_VER
+typedef __int16 int16_t;
+typedef __int32 int32_t;
+typedef __int64 int64_t;
+#else
+#include <stdint.h>
+#endif
+
+// Bound on the capacities of the graph that QPBO builds from a set of
+// terms, given the same calls as a QPBO object. Each pairwise term is split
+// into edge weights as in QPBO::ComputeWeights(). Augmenting paths only
+// reduce the magnitude of the terminal capacity of a node, and keep the sum
+// of the residual capacities of an arc and its sister, so no capacity at a
+// node exceeds its initial terminal capacity plus the weights of its edges.
+class CapacityBound
+{
+public:
+	CapacityBound(int node_num_max) : max_term(0) { tr_cap.reserve(node_num_max); arc_cap.reserve(node_num_max); }
+
+	int AddNode(int num = 1)
+	{
+		int first = (int)tr_cap.size();
+		tr_cap.resize(first+num, 0);
+		arc_cap.resize(first+num, 0);
+		return first;
+	}
+
+	void AddUnaryTerm(int i, double E0, double E1)
+	{
+		check_node(i);
+		max_term = std::max(max_term, std::max(fabs(E0), fabs(E1)));
+		tr_cap[i] += E1 - E0;
+	}
+
+	void AddPairwiseTerm(int i, int j, double E00, double E01, double E10, double E11)
+	{
+		check_node(i);
+		check_node(j);
+		max_term = std::max(max_term, std::max(std::max(fabs(E00), fabs(E01)), std::max(fabs(E10), fabs(E11))));
+
+		// Non-submodular terms are edges to the mate of j, i.e. the labels of j are swapped
+		bool submodular = E01 + E10 >= E00 + E11;
+		if (!submodular) {
+			std::swap(E00, E01);
+			std::swap(E10, E11);
+		}
+		double ci = E11 - E00, cj = 0;
+		double B = E01 - E00, C = E10 - E11;
+		if (B < 0) {
+			ci -= B;
+			cj = B;
+		} else if (C < 0) {
+			ci += C;
+			cj = -C;
+		}
+		tr_cap[i] += ci;
+		tr_cap[j] += submodular ? cj : -cj;
+		arc_cap[i] += B + C;
+		arc_cap[j] += B + C;
+	}
+
+	void MergeParallelEdges() {}
+
+	// Allows for terms to be added at node i later (e.g. dynamically, between
+	// solves) that add up to at most c to its capacities
+	void AddMargin(int i, double c)
+	{
+		check_node(i);
+		arc_cap[i] += fabs(c);
+	}
+
+	// Largest capacity at any node
+	double MaxCapacity() const
+	{
+		double c = 0;
+		for (size_t i = 0; i < tr_cap.size(); i++)
+			c = std::max(c, fabs(tr_cap[i]) + arc_cap[i]);
+		return c;
+	}
+
+	// Largest magnitude of any energy of a term
+	double MaxTerm() const { return max_term; }
+
+private:
+	std::vector<double> tr_cap;
+	std::vector<double> arc_cap;
+	double max_term;
+
+	void check_node(int i) const
+	{
+		if (i < 0 || i >= (int)tr_cap.size())
+			mexErrMsgTxt("Edge or triple clique references invalid node");
+	}
+};
+
+// Cost of an infinite edge, and largest value, of the integer internal type
+// of the given size in bytes (4 or 8)
+static inline void integer_type_limits(int bytes, double &infinite_edge_cost, double &max_value)
+{
+	switch (bytes) {
+		case 4:
+			infinite_edge_cost = (double)((int32_t)1<<20);
+			max_value = 2147483647.0;
+			break;
+		default:
+			infinite_edge_cost = (double)((int64_t)1<<47);
+			max_value = 9223372036854775807.0;
+			break;
+	}
+}
+
+// Whether the graph fits in the integer internal type of the given size.
+// QPBO-I fixes a node with a unary term of up to twice its capacity, and
+// QPBO-P adds edges of infinite cost, so capacities must fit with a margin
+// of 4 times. The terms must fit with a margin of 2, as E00 + E11 is
+// computed in the internal type.
+static inline bool integer_type_fits(int bytes, double capacity, double max_term)
+{
+	double infinite_edge_cost, max_value;
+	integer_type_limits(bytes, infinite_edge_cost, max_value);
+	return 4 * (capacity + infinite_edge_cost) + 2 <= max_value && 2 * max_term <= max_value;
+}
+
+#endif
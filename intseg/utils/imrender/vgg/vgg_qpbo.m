@@ -25,9 +25,9 @@
 %
 % IN:
 %   UE - 2xM matrix of unary terms for M nodes, or M = UE(1) if numel(UE)
-%        == 1 (assumes all unary terms are zero). UE can be any type, but
-%        PE and TE must be of the same type; also, optimality is not
-%        guaranteed for non-integer types.
+%        == 1 (assumes all unary terms are zero). UE can be int16, int32,
+%        int64, single or double, but PE and TE must be of the same type;
+%        also, optimality is not guaranteed for non-integer types.
 %   PI - {2,3}xN uint32 matrix, each column containing the following
 %        information on an edge: [start_node end_node
 %        [pairwise_energy_table_index]]. If there are only 2 rows then
@@ -43,7 +43,7 @@
 %   TE - 8xR triple clique energy table, each column containing the
 %        energies [E000 E001 E010 E011 E100 E101 E110 E111] for a given
 %        triple clique.
-%   options - 2x1 cell array. options{1} is a 1x4 uint32 vector of optional
+%   options - 2x1 cell array. options{1} is a 1x7 uint32 vector of optional
 %             parameters: 
 %      FirstNNodes - Only labels of nodes 1:FirstNNodes will be output.
 %                    Also limits nodes considered in QPBO-P and QPBO-I.
@@ -56,7 +56,25 @@
 %      LargerInternal - 0: input type also used internally; 1: code uses a
 %                       larger representation (i.e. more bits) for energies
 %                       than that provided, reducing the possibility of
-%                       edges becoming saturated. Default: 0.
+%                       edges becoming saturated; 2: for integer types, the
+%                       smaller of int32 and int64 that the graph is
+%                       guaranteed to fit in, which can save memory on
+%                       large graphs with small energies. int16 energies
+%                       are always solved with int32. For integer types
+%                       the largest capacity of the graph is bounded before
+%                       it is built, and an error is given if it could
+%                       overflow the internal type. Default: 0.
+%      NumThreads - number of threads. If > 1, QPBO-P is done in parallel,
+%                   each thread fixing nodes to 0 and 1 on its own copy of
+%                   the graph. This labels the same nodes for any number
+%                   of threads, but nodes are not contracted, so it may
+%                   label fewer nodes than QPBO-P. Also the number of
+%                   QPBO-I runs done at the same time. Requires
+%                   compilation with OpenMP. Default: 1.
+%      ImproveStarts - number of random node orders to run QPBO-I from,
+%                      keeping the labelling of lowest energy. Default: 1.
+%      Seed - if > 0, seed of the random node orders of QPBO-I, so that
+%             the output is reproducible. Default: 0 (not seeded).
 %             options{2} - callback_func, a function name or handle which,
 %                          given the labelling L (the first output of this
 %                          function), returns a logical array of the same
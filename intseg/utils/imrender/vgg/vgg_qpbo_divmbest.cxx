@@ -0,0 +1,376 @@
+//[L energy] = vgg_qpbo_divmbest(UE, PI, PE, lambda, M, [options]);
+//[L energy] = vgg_qpbo_divmbest(UE, PI, PE, lambda, M, {options, callback_func});
+
+// Diverse M-best solutions of a binary MRF with QPBO. The graph is built and
+// solved once. Each further mode adds diversity terms for the previous mode
+// to the graph, then re-solves with dynamic graph cuts, reusing the flow and
+// search trees of the previous mode (for submodular energies only the nodes
+// whose labels are affected are recomputed). lambda = [Hamming Boundary
+// Segment SegmentCap] weights the terms:
+// - Hamming: a unary penalty on the label taken by every node.
+// - Boundary: a Potts penalty on every edge whose nodes took different labels.
+// - Segment: a penalty for each node of a segment (connected component of
+//   nodes with the same label) keeping its label, capped at SegmentCap for
+//   the whole segment. This higher order term is reduced to pairwise terms
+//   with an auxiliary node per segment, as for robust P^n Potts models
+//   ("Robust higher order potentials for enforcing label consistency", Kohli
+//   et al., IJCV 2009). The terms stay submodular, as all the nodes of a
+//   segment took the same label.
+
+#include "QPBO.h"
+#include "vgg_qpbo.h"
+#include <limits>
+
+static void erfunc(char *err) {mexErrMsgTxt(err);}
+template<class INPUT, class INTERNAL> static inline void wrapper_func(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]);
+
+// Define types
+#ifdef _MSC_VER
+#pragma warning(disable: 4661)
+typedef __int32 int32_t;
+typedef __int64 int64_t;
+typedef unsigned __int32 uint32_t;
+#else
+#include <stdint.h>
+#endif
+
+// Calls callback_func with the labelling of a mode as soon as it is computed.
+// Returns false if the callback fails. Its error is trapped, so that the
+// caller can free its memory before raising an error.
+static bool call_back(const mxArray *callback, const int32_t *L, int nU)
+{
+	mxArray *inputArrays[2];
+	inputArrays[0] = (mxArray *)callback;
+	inputArrays[1] = mxCreateNumericMatrix(nU, 1, mxINT32_CLASS, mxREAL);
+	memcpy(mxGetData(inputArrays[1]), L, nU*sizeof(int32_t));
+	mxArray *exception = mexCallMATLABWithTrap(0, NULL, 2, inputArrays, "feval");
+	mxDestroyArray(inputArrays[1]);
+	if (!exception)
+		return true;
+	mxDestroyArray(exception);
+	return false;
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+	// Check number of inputs
+	if (nrhs < 5 || nrhs > 6)
+		mexErrMsgTxt("Unexpected number of input arguments.");
+	if (nlhs < 1 || nlhs > 2)
+		mexErrMsgTxt("Unexpected number of outputs.");
+	for (int i = 0; i < nrhs; i++) {
+		if (mxIsComplex(prhs[i]))
+			mexErrMsgTxt("Inputs must be real.");
+	}
+	if (!mxIsDouble(prhs[3]) || mxGetNumberOfElements(prhs[3]) < 1 || mxGetNumberOfElements(prhs[3]) > 4)
+		mexErrMsgTxt("lambda must be a double vector of 1 to 4 elements.");
+	if (mxGetNumberOfElements(prhs[4]) != 1)
+		mexErrMsgTxt("M must be a scalar.");
+	if (mxGetScalar(prhs[4]) < 1)
+		mexErrMsgTxt("M must be at least 1.");
+
+	// Check input types are valid
+	mxClassID in_class = mxGetClassID(prhs[2]);
+	if (in_class != mxGetClassID(prhs[0]))
+		mexErrMsgTxt("Types of the input arguments don't agree.");
+
+	// Do we want a larger internal representation
+	bool largerInternal = false;
+	if (nrhs > 5) {
+		const mxArray *paramsArray = prhs[5];
+		if (mxIsCell(paramsArray)) {
+			if (mxGetNumberOfElements(paramsArray) < 1 || mxGetNumberOfElements(paramsArray) > 2)
+				mexErrMsgTxt("options cell array has unexpected size.");
+			paramsArray = mxGetCell(paramsArray, 0);
+		}
+		if (!mxIsInt32(paramsArray))
+			mexErrMsgTxt("options should be int32s");
+		largerInternal = mxGetNumberOfElements(paramsArray) > 0 && ((const int32_t *)mxGetData(paramsArray))[0];
+	}
+
+	// Call the wrapper function according to the input type
+	switch (in_class) {
+		case mxINT32_CLASS:
+			if (largerInternal)
+				wrapper_func<int32_t, int64_t>(nlhs, plhs, nrhs, prhs);
+			else
+				wrapper_func<int32_t, int32_t>(nlhs, plhs, nrhs, prhs);
+			break;
+		case mxINT64_CLASS:
+			wrapper_func<int64_t, int64_t>(nlhs, plhs, nrhs, prhs);
+			break;
+		case mxDOUBLE_CLASS:
+			wrapper_func<double, double>(nlhs, plhs, nrhs, prhs);
+			break;
+		default:
+			mexErrMsgTxt("Inputs are of an unsupported type");
+			break;
+	}
+	return;
+}
+
+template<class INPUT, class INTERNAL> static inline void wrapper_func(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+	// Check types and dimensions, and get pointers
+	int Pindices = mxGetM(prhs[1]);
+	if (Pindices != 2 && Pindices != 3)
+		mexErrMsgTxt("Unexpected dimensions for PI");
+	int nP = mxGetN(prhs[1]);
+	int nPE = mxGetN(prhs[2]);
+	if (Pindices == 2 && nP != nPE)
+		mexErrMsgTxt("Without explicit indices, PI and PE should have the same number of columns");
+	if (mxGetM(prhs[2]) != 4)
+		mexErrMsgTxt("Unexpected dimensions for PE");
+	if (!mxIsUint32(prhs[1]))
+		mexErrMsgTxt("PI should be uint32s");
+	if (mxGetM(prhs[0]) != 2)
+		mexErrMsgTxt("Unexpected dimensions for U");
+	int nU = mxGetN(prhs[0]);
+	const INPUT *U = (const INPUT *)mxGetData(prhs[0]);
+	const INPUT *PE = (const INPUT *)mxGetData(prhs[2]);
+	const uint32_t *PI = (const uint32_t *)mxGetData(prhs[1]);
+	int M = (int)mxGetScalar(prhs[4]);
+	const mxArray *callback = NULL;
+	if (nrhs > 5 && mxIsCell(prhs[5]) && mxGetNumberOfElements(prhs[5]) > 1)
+		callback = mxGetCell(prhs[5], 1);
+
+	// Weights of the diversity terms
+	const double *lambda = mxGetPr(prhs[3]);
+	int nLambda = mxGetNumberOfElements(prhs[3]);
+	INTERNAL hamming = (INTERNAL)lambda[0];
+	INTERNAL boundary = nLambda > 1 ? (INTERNAL)lambda[1] : 0;
+	INTERNAL segment = nLambda > 2 ? (INTERNAL)lambda[2] : 0;
+	INTERNAL segment_cap = nLambda > 3 ? (INTERNAL)lambda[3] : segment;
+
+	// Check the edges, and find the energy table of each
+	const INPUT **edge_table = new const INPUT *[nP];
+	for (int i = 0; i < nP; i++) {
+		const uint32_t *edge = &PI[Pindices*i];
+		if (edge[0] < 1 || (int)edge[0] > nU || edge[1] < 1 || (int)edge[1] > nU) {
+			delete[] edge_table;
+			mexErrMsgTxt("PI references invalid node");
+		}
+		if (Pindices == 2)
+			edge_table[i] = &PE[4*i];
+		else {
+			if (edge[2] < 1 || (int)edge[2] > nPE) {
+				delete[] edge_table;
+				mexErrMsgTxt("Column of PI references invalid column of PE");
+			}
+			edge_table[i] = &PE[4*(edge[2]-1)];
+		}
+	}
+
+	// Parallel edges are merged into the first edge between the same two
+	// nodes, so that each boundary penalty is added to a single edge
+	int *edge_merged = new int[nP]; // input edge into which each edge is merged
+	{
+		std::vector<std::pair<uint64_t, int> > keys(nP);
+		for (int i = 0; i < nP; i++) {
+			uint64_t a = PI[Pindices*i], b = PI[Pindices*i+1];
+			keys[i] = std::make_pair(a < b ? (a << 32) | b : (b << 32) | a, i);
+		}
+		std::sort(keys.begin(), keys.end());
+		for (int k = 0; k < nP; k++)
+			edge_merged[keys[k].second] = (k > 0 && keys[k].first == keys[k-1].first) ? edge_merged[keys[k-1].second] : keys[k].second;
+	}
+
+	// Integer capacities accumulate the diversity terms of all the modes, so
+	// check that they fit in the internal type, as in vgg_qpbo
+	if (std::numeric_limits<INTERNAL>::is_integer) {
+		CapacityBound bound(nU);
+		bound.AddNode(nU);
+		for (int i = 0; i < nU; i++)
+			bound.AddUnaryTerm(i, (double)U[2*i], (double)U[2*i+1]);
+		for (int i = 0; i < nP; i++) {
+			const INPUT *E = edge_table[i];
+			bound.AddPairwiseTerm(PI[Pindices*i]-1, PI[Pindices*i+1]-1, (double)E[0], (double)E[1], (double)E[2], (double)E[3]);
+		}
+		// Each further mode adds at most the Hamming penalty, a segment
+		// penalty, and a boundary penalty on each edge at every node
+		for (int i = 0; i < nU; i++)
+			bound.AddMargin(i, (M-1) * (fabs((double)hamming) + fabs((double)segment)));
+		for (int i = 0; i < nP; i++) {
+			if (edge_merged[i] != i)
+				continue;
+			bound.AddMargin(PI[Pindices*i]-1, (M-1) * 2 * fabs((double)boundary));
+			bound.AddMargin(PI[Pindices*i+1]-1, (M-1) * 2 * fabs((double)boundary));
+		}
+		// An auxiliary node has the segment cap and an edge to each node of its segment
+		double capacity = std::max(bound.MaxCapacity(), fabs((double)segment_cap) + nU * fabs((double)segment));
+		double max_term = std::max(bound.MaxTerm(), std::max(std::max(fabs((double)hamming), fabs((double)boundary)), std::max(fabs((double)segment), fabs((double)segment_cap))));
+		if (!integer_type_fits(sizeof(INTERNAL), capacity, max_term)) {
+			delete[] edge_table;
+			delete[] edge_merged;
+			mexErrMsgTxt("Energies too large: the capacities of the graph may overflow. Use a larger internal type (LargerInternal option), or smaller energies or lambda.");
+		}
+	}
+
+	// Define the graph. Each mode adds at most one auxiliary node per segment of
+	// two or more nodes, with an edge to each of them. They are allocated now,
+	// as reallocating the graph would lose the search trees.
+	int nNodesMax = nU;
+	int nEdgesMax = nP;
+	if (segment) {
+		nNodesMax += (M-1) * (nU/2);
+		nEdgesMax += (M-1) * nU;
+	}
+	QPBO<INTERNAL> *graph = new QPBO<INTERNAL>(nNodesMax, nEdgesMax, erfunc);
+	graph->AddNode(nU);
+	for (int nodeInd = 0; nodeInd < nU; nodeInd++)
+		graph->AddUnaryTerm(nodeInd, (INTERNAL)U[2*nodeInd], (INTERNAL)U[2*nodeInd+1]);
+	int *edge_id = new int[nP];
+	for (int i = 0; i < nP; i++) {
+		const INPUT *E = edge_table[i];
+		if (edge_merged[i] == i)
+			edge_id[i] = graph->AddPairwiseTerm(PI[Pindices*i]-1, PI[Pindices*i+1]-1, (INTERNAL)E[0], (INTERNAL)E[1], (INTERNAL)E[2], (INTERNAL)E[3]);
+		else {
+			edge_id[i] = edge_id[edge_merged[i]];
+			graph->AddPairwiseTerm(edge_id[i], PI[Pindices*i]-1, PI[Pindices*i+1]-1, (INTERNAL)E[0], (INTERNAL)E[1], (INTERNAL)E[2], (INTERNAL)E[3]);
+		}
+	}
+
+	// Create the outputs
+	plhs[0] = mxCreateNumericMatrix(nU, M, mxINT32_CLASS, mxREAL);
+	int32_t *L = (int32_t *)mxGetData(plhs[0]);
+	double *energy = NULL;
+	if (nlhs > 1) {
+		plhs[1] = mxCreateDoubleMatrix(1, M, mxREAL);
+		energy = mxGetPr(plhs[1]);
+	}
+
+	// Neighbours of each node, for finding the segments
+	int *adj_start = NULL, *adj = NULL, *visited = NULL, *order = NULL, *seg_start = NULL;
+	if (segment) {
+		adj_start = new int[nU+1];
+		adj = new int[2*nP];
+		for (int i = 0; i <= nU; i++)
+			adj_start[i] = 0;
+		for (int i = 0; i < nP; i++) {
+			adj_start[PI[Pindices*i]]++;
+			adj_start[PI[Pindices*i+1]]++;
+		}
+		for (int i = 0; i < nU; i++)
+			adj_start[i+1] += adj_start[i];
+		for (int i = 0; i < nP; i++) {
+			int a = PI[Pindices*i] - 1;
+			int b = PI[Pindices*i+1] - 1;
+			adj[adj_start[a]++] = b;
+			adj[adj_start[b]++] = a;
+		}
+		for (int i = nU; i > 0; i--)
+			adj_start[i] = adj_start[i-1];
+		adj_start[0] = 0;
+		visited = new int[3*nU+1];
+		order = visited + nU;
+		seg_start = order + nU;
+		for (int i = 0; i < nU; i++)
+			visited[i] = 0;
+	}
+
+	int m;
+	for (m = 0; m < M; m++, L += nU) {
+		if (m == 0) {
+			graph->Solve();
+		} else {
+			const int32_t *L_prev = L - nU;
+
+			// Penalize the labels of the previous mode (unlabelled nodes are not penalized)
+			if (hamming) {
+				for (int i = 0; i < nU; i++) {
+					if (L_prev[i] == 0)
+						graph->AddUnaryTermDynamic(i, hamming, 0);
+					else if (L_prev[i] == 1)
+						graph->AddUnaryTermDynamic(i, 0, hamming);
+				}
+			}
+
+			// Penalize the boundaries of the previous mode
+			if (boundary) {
+				for (int i = 0; i < nP; i++) {
+					if (edge_merged[i] != i)
+						continue;
+					int a = PI[Pindices*i] - 1;
+					int b = PI[Pindices*i+1] - 1;
+					if (L_prev[a] >= 0 && L_prev[b] >= 0 && L_prev[a] != L_prev[b])
+						graph->AddPairwiseTermDynamic(edge_id[i], a, b, 0, boundary, boundary, 0);
+				}
+			}
+
+			// Penalize the nodes of each segment of the previous mode keeping their label
+			if (segment) {
+				// Find the segments, breadth first
+				int nSeg = 0, nOrder = 0;
+				for (int s = 0; s < nU; s++) {
+					if (visited[s] == m || L_prev[s] < 0)
+						continue;
+					seg_start[nSeg++] = nOrder;
+					visited[s] = m;
+					order[nOrder++] = s;
+					for (int k = seg_start[nSeg-1]; k < nOrder; k++) {
+						int i = order[k];
+						for (int a = adj_start[i]; a < adj_start[i+1]; a++) {
+							int j = adj[a];
+							if (visited[j] != m && L_prev[j] == L_prev[i]) {
+								visited[j] = m;
+								order[nOrder++] = j;
+							}
+						}
+					}
+				}
+				seg_start[nSeg] = nOrder;
+
+				for (int s = 0; s < nSeg; s++) {
+					const int *seg = &order[seg_start[s]];
+					int n = seg_start[s+1] - seg_start[s];
+					int label = L_prev[seg[0]];
+					if (n == 1 || (double)segment_cap >= (double)segment * n) {
+						// The cap is never reached
+						for (int k = 0; k < n; k++)
+							graph->AddUnaryTermDynamic(seg[k], label ? 0 : segment, label ? segment : 0);
+						continue;
+					}
+					// min(segment_cap, segment * (number of nodes keeping their label))
+					// = min over w of: segment_cap if w == label, else segment for
+					// each node keeping its label
+					int w = graph->AddNode();
+					graph->AddUnaryTermDynamic(w, label ? 0 : segment_cap, label ? segment_cap : 0);
+					for (int k = 0; k < n; k++) {
+						if (label)
+							graph->AddPairwiseTermDynamic(w, seg[k], 0, segment, 0, 0);
+						else
+							graph->AddPairwiseTermDynamic(w, seg[k], 0, 0, segment, 0);
+					}
+				}
+			}
+			graph->SolveDynamic();
+		}
+
+		// Read out labelling
+		for (int i = 0; i < nU; i++)
+			L[i] = (int32_t)graph->GetLabel(i);
+
+		// Energy of the labelling, without the diversity terms (unlabelled nodes taken as 0)
+		if (energy) {
+			double E = 0;
+			for (int i = 0; i < nU; i++)
+				E += (double)U[2*i+(L[i] == 1)];
+			for (int i = 0; i < nP; i++)
+				E += (double)edge_table[i][2*(L[PI[Pindices*i]-1] == 1) + (L[PI[Pindices*i+1]-1] == 1)];
+			energy[m] = E;
+		}
+		if (callback && !call_back(callback, L, nU))
+			break;
+	}
+
+	delete graph;
+	delete[] edge_table;
+	delete[] edge_id;
+	delete[] edge_merged;
+	delete[] adj_start;
+	delete[] adj;
+	delete[] visited;
+	if (m < M)
+		mexErrMsgTxt("Callback fails.");
+	return;
+}
@@ -0,0 +1,67 @@
+%VGG_QPBO_DIVMBEST  Diverse M-best solutions of a binary MRF using QPBO
+%
+%   [L energy] = vgg_qpbo_divmbest(UE, PI, PE, lambda, M, [options])
+%   [L energy] = vgg_qpbo_divmbest(UE, PI, PE, lambda, M, {options, callback_func})
+%
+% Computes M diverse low energy labellings of a binary MRF, as in "Diverse
+% M-Best Solutions in Markov Random Fields", Batra et al., ECCV 2012. Each
+% labelling minimizes the energy plus diversity terms penalizing its
+% similarity to each of the previous labellings:
+%   Hamming - lambda(1) for each node taking the same label.
+%   Boundary - lambda(2) for each edge whose nodes took different labels
+%              and still take different labels, so that boundaries move.
+%   Segment - lambda(3) for each node of a segment (a connected component
+%             of nodes with the same label) keeping its label, up to at most
+%             lambda(4) for the whole segment, so that whole segments change
+%             label. These higher order terms are reduced to pairwise terms
+%             with an auxiliary node per segment. Memory for the
+%             auxiliary nodes and edges of all M labellings is allocated
+%             up front.
+% All the terms are submodular if the energy is.
+%
+% The graph is only constructed and solved from scratch once. The
+% following labellings are computed with dynamic graph cuts ("Efficiently
+% solving dynamic Markov random fields using graph cuts", Kohli & Torr,
+% ICCV 2005), reusing the flow and search trees of the previous
+% labelling, which is much faster than calling vgg_qpbo M times. The
+% labellings are optimal if the energy is submodular.
+%
+% IN:
+%   UE - 2xN matrix of unary terms for N nodes, of type int32, int64 or
+%        double (optimality is not guaranteed for non-integer types).
+%   PI - {2,3}xP uint32 matrix of edges, as for vgg_qpbo. Edges between
+%        the same two nodes are merged.
+%   PE - 4xQ pairwise energy table, as for vgg_qpbo, of the same type as
+%        UE.
+%   lambda - 1x4 vector [Hamming Boundary Segment SegmentCap] of weights
+%            of the diversity terms. Missing elements are taken as 0, except
+%            SegmentCap, which defaults to Segment (a segment is penalized
+%            unless all its nodes change label). A scalar gives Hamming
+%            diversity only.
+%   M - number of labellings to compute.
+%   options - int32 scalar LargerInternal, as for vgg_qpbo. Default: 0.
+%             For integer energies, an error is raised if the capacities
+%             of the graph, with the diversity terms of all M labellings,
+%             could overflow the internal type.
+%   callback_func - a function name or handle which is called with the Nx1
+%                   int32 labelling of each mode (a column of L) as soon as
+%                   it is computed, e.g. to store or process the modes
+%                   while the next ones are computed. Its output is ignored.
+%
+% OUT:
+%   L - NxM int32 matrix, the mth column giving the label (0 or 1) of each
+%       node in the mth labelling. Labels < 0 indicate unlabelled nodes
+%       (only for non-submodular energies); these are not penalized.
+%   energy - 1xM vector giving the energy of each labelling, without the
+%            diversity terms, with unlabelled nodes taken as 0.
+%
+% See also VGG_QPBO, VGG_TRW_DIVMBEST.
+
+function varargout = vgg_qpbo_divmbest(varargin)
+funcName = mfilename;
+sd = 'qpbo/';
+sourceList = {['-I' sd], [funcName '.cxx'], [sd 'QPBO.cpp'],...
+              [sd 'QPBO_maxflow.cpp'], [sd 'QPBO_extra.cpp'],...
+              [sd 'QPBO_postprocessing.cpp']};
+vgg_mexcompile_script; % Compilation happens in this script
+return
@@ -0,0 +1,166 @@
+//[seg stats] = vgg_seg_stats(L, splabels, [gt]);
+
+// Paints a batch of superpixel labellings into pixel segmentations, and
+// accumulates the counts needed for the accuracy statistics of each
+// segmentation against the ground truth in the same pass over the pixels.
+
+#include <mex.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Copies an array of any numeric type into ints
+template<class T> static inline void copy_ints(const T *in, int *out, int n)
+{
+	for (int i = 0; i < n; i++)
+		out[i] = (int)in[i];
+}
+
+static int *read_ints(const mxArray *A)
+{
+	int n = mxGetNumberOfElements(A);
+	int *out = new int[n];
+	const void *in = mxGetData(A);
+	switch (mxGetClassID(A)) {
+		case mxDOUBLE_CLASS:
+			copy_ints((const double *)in, out, n);
+			break;
+		case mxSINGLE_CLASS:
+			copy_ints((const float *)in, out, n);
+			break;
+		case mxINT32_CLASS:
+			copy_ints((const int *)in, out, n);
+			break;
+		case mxUINT32_CLASS:
+			copy_ints((const unsigned int *)in, out, n);
+			break;
+		case mxINT16_CLASS:
+			copy_ints((const short *)in, out, n);
+			break;
+		case mxUINT16_CLASS:
+			copy_ints((const unsigned short *)in, out, n);
+			break;
+		case mxLOGICAL_CLASS:
+		case mxUINT8_CLASS:
+			copy_ints((const unsigned char *)in, out, n);
+			break;
+		case mxINT8_CLASS:
+			copy_ints((const signed char *)in, out, n);
+			break;
+		default:
+			delete[] out;
+			mexErrMsgTxt("Unsupported input type.");
+			break;
+	}
+	return out;
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+	// Check number of inputs
+	if (nrhs < 2 || nrhs > 3)
+		mexErrMsgTxt("Unexpected number of input arguments.");
+	if (nlhs > 2)
+		mexErrMsgTxt("Unexpected number of outputs.");
+	if (nlhs > 1 && nrhs < 3)
+		mexErrMsgTxt("gt is required to compute the statistics.");
+	for (int i = 0; i < nrhs; i++) {
+		if (mxIsComplex(prhs[i]))
+			mexErrMsgTxt("Inputs must be real.");
+	}
+
+	// Superpixel labellings, one per column (a row vector is one labelling)
+	int nsp = mxGetM(prhs[0]);
+	int M = mxGetN(prhs[0]);
+	if (nsp == 1) {
+		nsp = M;
+		M = 1;
+	}
+	int npix = mxGetNumberOfElements(prhs[1]);
+	if (nrhs > 2 && (int)mxGetNumberOfElements(prhs[2]) != npix)
+		mexErrMsgTxt("gt must be the same size as splabels.");
+
+	// Superpixel indices (0-based)
+	int *sp = read_ints(prhs[1]);
+	for (int p = 0; p < npix; p++) {
+		if (sp[p] < 0 || sp[p] >= nsp) {
+			delete[] sp;
+			mexErrMsgTxt("splabels must be in the range 0 to numel(L)-1.");
+		}
+	}
+	int *gt = nrhs > 2 ? read_ints(prhs[2]) : NULL;
+	double *L = new double[nsp*M];
+	switch (mxGetClassID(prhs[0])) {
+		case mxDOUBLE_CLASS:
+			for (int i = 0; i < nsp*M; i++)
+				L[i] = ((const double *)mxGetData(prhs[0]))[i];
+			break;
+		default:
+			{
+				int *Li = read_ints(prhs[0]);
+				for (int i = 0; i < nsp*M; i++)
+					L[i] = Li[i];
+				delete[] Li;
+			}
+			break;
+	}
+
+	// Create the outputs: one segmentation the size of splabels per labelling
+	int ndims = mxGetNumberOfDimensions(prhs[1]);
+	const mwSize *dims_in = mxGetDimensions(prhs[1]);
+	mwSize *dims = new mwSize[ndims+1];
+	for (int i = 0; i < ndims; i++)
+		dims[i] = dims_in[i];
+	dims[ndims] = M;
+	plhs[0] = mxCreateNumericArray(M > 1 ? ndims+1 : ndims, dims, mxDOUBLE_CLASS, mxREAL);
+	delete[] dims;
+	double *seg = mxGetPr(plhs[0]);
+	double *stats = NULL;
+	if (nlhs > 1) {
+		plhs[1] = mxCreateDoubleMatrix(5, M, mxREAL);
+		stats = mxGetPr(plhs[1]);
+	}
+
+	// For each labelling
+	int m;
+#pragma omp parallel for if (M > 1) num_threads(omp_get_num_procs()) default(shared) private(m)
+	for (m = 0; m < M; m++) {
+		const double *Lm = &L[nsp*m];
+		double *segm = &seg[npix*m];
+		if (!gt) {
+			for (int p = 0; p < npix; p++)
+				segm[p] = Lm[sp[p]];
+			continue;
+		}
+
+		// Counts of pixels: true positives, true negatives, labelled 1, 1 in the ground truth, void
+		int tp = 0, tn = 0, seg1 = 0, gt1 = 0, nvoid = 0;
+		for (int p = 0; p < npix; p++) {
+			double s = Lm[sp[p]];
+			segm[p] = s;
+			int g = gt[p];
+			seg1 += s == 1;
+			gt1 += g == 1;
+			nvoid += g == 255;
+			tp += s == 1 && g == 1;
+			tn += s == 0 && g == 0;
+		}
+
+		// Statistics, as computed by computeStats.m
+		if (stats) {
+			double *out = &stats[5*m];
+			double precision = (double)tp / seg1;
+			double recall = (double)tp / gt1;
+			out[0] = (double)(tp + tn) / (npix - nvoid);
+			out[1] = precision;
+			out[2] = recall;
+			out[3] = (double)tp / (gt1 + seg1 - tp);
+			out[4] = 2 * precision * recall / (precision + recall);
+		}
+	}
+
+	delete[] L;
+	delete[] gt;
+	delete[] sp;
+	return;
+}
@@ -0,0 +1,30 @@
+%VGG_SEG_STATS  Pixel segmentations and accuracies of superpixel labellings
+%
+%   [seg stats] = vgg_seg_stats(L, splabels, [gt])
+%
+% Paints each of a batch of superpixel labellings into a pixel
+% segmentation, and computes the statistics of each segmentation against
+% a binary ground truth in the same pass, as LABEL2SEG and COMPUTESTATS
+% would for each labelling in turn. Labellings are processed in parallel if
+% compiled with OpenMP.
+%
+% IN:
+%   L - NxM matrix, the mth column giving the labels of N superpixels in
+%       the mth labelling. A row vector is treated as a single labelling.
+%   splabels - HxW superpixel map, with values in the range 0 to N-1.
+%   gt - HxW ground truth, with values 0, 1 or 255 (void). Required for the
+%        statistics output.
+%
+% OUT:
+%   seg - HxWxM double array of the pixel segmentations.
+%   stats - 5xM matrix, the mth column giving [accuracy; precision;
+%           recall; iou; fmeasure] for the mth segmentation. Void pixels
+%           are excluded from the accuracy only, as in COMPUTESTATS.
+%
+% See also LABEL2SEG, COMPUTESTATS.
+
+function varargout = vgg_seg_stats(varargin)
+funcName = mfilename;
+sourceList = {[funcName '.cxx']};
+vgg_mexcompile_script; % Compilation happens in this script
+return
@@ -26,60 +26,67 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 	if (nlhs != 1)
 		mexErrMsgTxt("Unexpected number of output arguments.");
 	int ndims = mxGetNumberOfDimensions(prhs[0]);
-	const int *dims = mxGetDimensions(prhs[0]);
+	const mwSize *dims = mxGetDimensions(prhs[0]);
 	if (!mxIsUint8(prhs[0]) || ndims != 3 || dims[2] != 3)
 		mexErrMsgTxt("A must be an HxWx3 uint8 array.");
 
-	// Read in the input variables
+	// Read in the input variables. Several k (and min_sz) give several
+	// segmentations.
 	float sigma = (float)mxGetScalar(prhs[1]);
-	float k = (float)mxGetScalar(prhs[2]);
-	int min_size = (int)mxGetScalar(prhs[3]);
+	int num_k = mxGetNumberOfElements(prhs[2]);
+	int num_min = mxGetNumberOfElements(prhs[3]);
+	if (num_k < 1 || !mxIsDouble(prhs[2]))
+		mexErrMsgTxt("k must be a non-empty double array.");
+	if ((num_min != 1 && num_min != num_k) || !mxIsDouble(prhs[3]))
+		mexErrMsgTxt("min_sz must be a double scalar, or have one element per k.");
+	float *k = new float[num_k];
+	int *min_size = new int[num_k];
+	for (int i = 0; i < num_k; i++) {
+		k[i] = (float)mxGetPr(prhs[2])[i];
+		min_size[i] = (int)mxGetPr(prhs[3])[num_min > 1 ? i : 0];
+	}
 
 	// Read in the input image
 	image<rgb> *input = new image<rgb>(dims[1], dims[0]);
 	const uint8_t *A = (const uint8_t *)mxGetData(prhs[0]);
 	uint8_t *B = (uint8_t *)imPtr(input, 0, 0);
-	for (int h = 0; h < dims[0]; h++) {
-		for (int w = 0; w < dims[0]*dims[1]; w += dims[0]) {
+	for (int h = 0; h < (int)dims[0]; h++) {
+		for (int w = 0; w < (int)(dims[0]*dims[1]); w += dims[0]) {
 				*B++ = A[h+w];
 				*B++ = A[h+w+dims[0]*dims[1]];
 				*B++ = A[h+w+dims[0]*dims[1]*2];
 		}
 	}
 
-	// Create the output image
-	plhs[0] = mxCreateNumericMatrix(dims[0], dims[1], mxUINT32_CLASS, mxREAL);
+	// Create the output image, one segmentation per k
+	mwSize out_dims[3] = {dims[0], dims[1], (mwSize)num_k};
+	plhs[0] = mxCreateNumericArray(num_k > 1 ? 3 : 2, out_dims, mxUINT32_CLASS, mxREAL);
     uint32_t *C = (uint32_t *)mxGetData(plhs[0]);
 
-	// Segment the image
-	int num_sets;
-	segment_image(input, sigma, k, min_size, &num_sets, C);
+	// Segment the image, sorting its edges once for all the k
+	int *num_sets = new int[num_k];
+	segment_image_multi(input, sigma, k, min_size, num_k, num_sets, C);
 	delete input;
+	delete[] k;
+	delete[] min_size;
+	delete[] num_sets;
 	
 	if (nrhs > 4 && mxGetScalar(prhs[4])) {
-		// Compress the labelling
-		num_sets++;
-		uint32_t *map = new uint32_t[num_sets];
-		int labels = 0;
-		for (int w = 0; w < dims[0]*dims[1]; w += dims[0]) {
-			for (int h = 0; h < dims[0]; h++) {
-				int label = 0;
-				while (label < labels) {
-					if (map[label++] == C[h+w])
-						goto skip_point;
-				}
-				label = labels++;
-				if (labels > num_sets) {
-					char str[30];
-					sprintf(str, "At least %d sets found.\n", labels);
-					mexErrMsgTxt(str);
-				}
-				map[label++] = C[h+w];
-skip_point:
-				C[h+w] = (uint32_t)label;
+		// Compress the labelling, numbering the segments in order of first
+		// appearance. Segment indices are pixel indices.
+		int n = dims[0]*dims[1];
+		uint32_t *map = new uint32_t[n];
+		for (int i = 0; i < num_k; i++, C += n) {
+			for (int j = 0; j < n; j++)
+				map[j] = 0;
+			uint32_t labels = 0;
+			for (int j = 0; j < n; j++) {
+				if (!map[C[j]])
+					map[C[j]] = ++labels;
+				C[j] = map[C[j]];
 			}
 		}
-		delete map;
+		delete[] map;
 	}
 
 	return;
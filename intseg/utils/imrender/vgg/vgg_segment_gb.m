@@ -1,6 +1,6 @@
 %VGG_SEGMENT_GB  Graph-based image segmentation
 %
-%   S = vgg_segment_gb(A, sigma, K, min_sz[, compress])
+%   S = vgg_segment_gb(A, sigma, k, min_sz[, compress])
 %
 % Segmentation of an image using the graph-based method described in:
 %   "Efficient Graph-Based Image Segmentation.", Pedro F. Felzenszwalb and
@@ -13,15 +13,18 @@
 %   A - HxWx3 uint8 image for segmentation.
 %   sigma - scalar parameter on smoothing kernel to use prior to
 %           segmentation.
-%   k - scalar parameter on prefered segment size.
-%   min_sz - scalar indicating the minimum number of pixels per segment.
+%   k - scalar parameter on prefered segment size, or a vector of values,
+%       giving one segmentation per value. The image is smoothed and its
+%       edges sorted only once for all the values.
+%   min_sz - scalar indicating the minimum number of pixels per segment, or
+%            a vector giving the minimum for each value of k.
 %   compress - scalar boolean indicating whether the user wants the segment
 %              indices compressed to the range [1 num_segments].
 %              Default: 0.
 %
 %OUT:
-%   S - HxW uint32 segmentation matrix, each value of which gives the index
-%       of the region said pixel belongs to.
+%   S - HxWxnumel(k) uint32 array of segmentations, each value of which
+%       gives the index of the region said pixel belongs to.
 
 % $Id: vgg_segment_gb.m,v 1.1 2007/12/10 10:59:30 ojw Exp $
 
@@ -30,4 +33,4 @@ funcName = mfilename;
 sd = 'seg_gb/';
 sourceList = {['-I' sd], [funcName '.cxx']};
 vgg_mexcompile_script; % Compilation happens in this script
-return
\ No newline at end of file
+return
\ No newline at end of file
@@ -0,0 +1,397 @@
+//h = vgg_solution_store('open', N, [filename]);
+//[index d] = vgg_solution_store('add', h, L);
+//D = vgg_solution_store('distances', h, [index]);
+//L = vgg_solution_store('labels', h);
+//vgg_solution_store('close', h);
+
+// Store of distinct binary labellings, kept in the MEX file between calls,
+// so that a run of modes can be added one mode at a time. Labellings are
+// packed 64 nodes to a word, and each new one is hashed, so that exact
+// duplicates of a stored labelling (or of an earlier one in the batch) are
+// found without comparing against every stored labelling. Only the Hamming
+// distances of an added labelling to the stored ones are computed, with
+// popcount, extending the lower triangle of the distance matrix of the
+// store, and the added labellings can be appended to a file as they are
+// accepted.
+
+#include <mex.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Define types
+#ifdef _MSC_VER
+#include <intrin.h>
+typedef unsigned __int32 uint32_t;
+typedef unsigned __int64 uint64_t;
+#else
+#include <stdint.h>
+#endif
+
+static inline int popcount64(uint64_t x)
+{
+#if defined(__GNUC__)
+	return __builtin_popcountll(x);
+#elif defined(_MSC_VER) && defined(_M_X64)
+	return (int)__popcnt64(x);
+#else
+	x = x - ((x >> 1) & 0x5555555555555555ULL);
+	x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+	x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return (int)((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+// Hash of a packed labelling (splitmix64 finalizer of each word, combined)
+static uint64_t hash_words(const uint64_t *w, int W)
+{
+	uint64_t h = 0x9E3779B97F4A7C15ULL * (uint64_t)W;
+	for (int k = 0; k < W; k++) {
+		uint64_t z = w[k] + h + 0x9E3779B97F4A7C15ULL;
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		h = z ^ (z >> 31);
+	}
+	return h;
+}
+
+// Packs K labellings of N nodes, one per column of in, into W words each.
+// Returns false if a label is not 0 or 1.
+template<class T> static bool pack_labels(const T *in, int N, int K, int W, uint64_t *out)
+{
+	for (int k = 0; k < K; k++, in += N, out += W) {
+		for (int w = 0; w < W; w++)
+			out[w] = 0;
+		for (int i = 0; i < N; i++) {
+			if (in[i] == 1)
+				out[i>>6] |= (uint64_t)1 << (i & 63);
+			else if (in[i] != 0)
+				return false;
+		}
+	}
+	return true;
+}
+
+// Chained hash table of the stored labellings, which doubles its buckets
+// as labellings are added
+class SolutionHash
+{
+public:
+	// Index of the solution equal to w, the solutions being stored W words
+	// each at words, or -1
+	int Find(const uint64_t *w, uint64_t h, const uint64_t *words, int W) const
+	{
+		if (first.empty())
+			return -1;
+		for (int s = first[h & (first.size()-1)]; s >= 0; s = next[s]) {
+			if (hash[s] == h && !memcmp(&words[(size_t)W*s], w, W*sizeof(uint64_t)))
+				return s;
+		}
+		return -1;
+	}
+
+	// Adds the next solution, of hash h
+	void Add(uint64_t h)
+	{
+		hash.push_back(h);
+		next.push_back(-1);
+		if (2*hash.size() <= first.size()) {
+			Link((int)hash.size()-1);
+			return;
+		}
+		// Rehash all the solutions
+		first.assign(first.empty() ? 16 : 2*first.size(), -1);
+		for (int s = 0; s < (int)hash.size(); s++)
+			Link(s);
+	}
+
+private:
+	std::vector<int> first;
+	std::vector<int> next;
+	std::vector<uint64_t> hash;
+
+	void Link(int s)
+	{
+		size_t b = hash[s] & (first.size()-1);
+		next[s] = first[b];
+		first[b] = s;
+	}
+};
+
+// One store
+struct SolutionStore
+{
+	int N; // number of nodes
+	int W; // words per labelling
+	int Q; // number of labellings
+	std::vector<uint64_t> words; // labellings, W words each
+	std::vector<uint32_t> dist; // distances of labelling s to labellings 0..s-1, from s*(s-1)/2
+	SolutionHash table;
+	FILE *fp;
+
+	SolutionStore(int N_) : N(N_), W((N_ + 63) / 64), Q(0), fp(NULL) {}
+	~SolutionStore() { if (fp) fclose(fp); }
+
+	// Appends the distances of labelling s, the last one, to the ones before
+	void AddDistances(int s)
+	{
+		size_t start = dist.size();
+		dist.resize(start + s);
+		uint32_t *row = s ? &dist[start] : NULL;
+		const uint64_t *ws = &words[(size_t)W*s];
+		int t;
+#pragma omp parallel for if ((size_t)s*W > 100000) num_threads(omp_get_num_procs()) default(shared) private(t)
+		for (t = 0; t < s; t++) {
+			const uint64_t *wt = &words[(size_t)W*t];
+			uint32_t d = 0;
+			for (int k = 0; k < W; k++)
+				d += popcount64(ws[k] ^ wt[k]);
+			row[t] = d;
+		}
+	}
+
+	uint32_t Distance(int s, int t) const
+	{
+		if (s == t)
+			return 0;
+		if (s < t) {
+			int u = s;
+			s = t;
+			t = u;
+		}
+		return dist[(size_t)s*(s-1)/2 + t];
+	}
+};
+
+// Open stores, indexed by handle - 1. Closed ones are NULL.
+static std::vector<SolutionStore *> stores;
+
+static void free_stores()
+{
+	for (size_t h = 0; h < stores.size(); h++)
+		delete stores[h];
+	stores.clear();
+}
+
+static SolutionStore *get_store(const mxArray *handle, int &h)
+{
+	if (!mxIsDouble(handle) || mxGetNumberOfElements(handle) != 1)
+		mexErrMsgTxt("Invalid store handle.");
+	double v = mxGetScalar(handle);
+	h = (int)v - 1;
+	if (h < 0 || h != v - 1 || h >= (int)stores.size() || !stores[h])
+		mexErrMsgTxt("Invalid store handle.");
+	return stores[h];
+}
+
+static void open_store(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+	if (nrhs < 2 || nrhs > 3)
+		mexErrMsgTxt("Unexpected number of input arguments.");
+	if (nlhs > 1)
+		mexErrMsgTxt("Unexpected number of outputs.");
+	if (!mxIsNumeric(prhs[1]) || mxGetNumberOfElements(prhs[1]) != 1 || mxGetScalar(prhs[1]) < 1)
+		mexErrMsgTxt("N must be a positive scalar.");
+	FILE *fp = NULL;
+	if (nrhs > 2) {
+		if (!mxIsChar(prhs[2]))
+			mexErrMsgTxt("filename must be a string.");
+		char filename[4096];
+		mxGetString(prhs[2], filename, 4096);
+		fp = fopen(filename, "ab");
+		if (!fp)
+			mexErrMsgTxt("Could not open file for appending.");
+	}
+
+	SolutionStore *store = new SolutionStore((int)mxGetScalar(prhs[1]));
+	store->fp = fp;
+	size_t h = 0;
+	while (h < stores.size() && stores[h])
+		h++;
+	if (h == stores.size())
+		stores.push_back(store);
+	else
+		stores[h] = store;
+	mexAtExit(free_stores);
+	mexLock(); // keep the stores until they are closed
+	plhs[0] = mxCreateDoubleScalar((double)(h + 1));
+}
+
+static void add_labels(SolutionStore &store, int nlhs, mxArray *plhs[], const mxArray *L_array)
+{
+	if (nlhs > 2)
+		mexErrMsgTxt("Unexpected number of outputs.");
+	if (mxIsComplex(L_array))
+		mexErrMsgTxt("Inputs must be real.");
+	if ((int)mxGetM(L_array) != store.N)
+		mexErrMsgTxt("L must have one row per node of the store.");
+	int N = store.N;
+	int K = mxGetN(L_array);
+	int W = store.W;
+	int P = store.Q;
+
+	// Pack the new labellings after the stored ones
+	store.words.resize((size_t)W*(P+K));
+	uint64_t *in = K ? &store.words[(size_t)W*P] : NULL;
+	const char *error = "L must be binary (labels 0 and 1).";
+	bool okay = false;
+	const void *L = mxGetData(L_array);
+	switch (mxGetClassID(L_array)) {
+		case mxDOUBLE_CLASS:
+			okay = pack_labels((const double *)L, N, K, W, in);
+			break;
+		case mxSINGLE_CLASS:
+			okay = pack_labels((const float *)L, N, K, W, in);
+			break;
+		case mxINT32_CLASS:
+			okay = pack_labels((const int *)L, N, K, W, in);
+			break;
+		case mxUINT32_CLASS:
+			okay = pack_labels((const unsigned int *)L, N, K, W, in);
+			break;
+		case mxINT16_CLASS:
+			okay = pack_labels((const short *)L, N, K, W, in);
+			break;
+		case mxUINT16_CLASS:
+			okay = pack_labels((const unsigned short *)L, N, K, W, in);
+			break;
+		case mxLOGICAL_CLASS:
+		case mxUINT8_CLASS:
+			okay = pack_labels((const unsigned char *)L, N, K, W, in);
+			break;
+		case mxINT8_CLASS:
+			okay = pack_labels((const signed char *)L, N, K, W, in);
+			break;
+		default:
+			error = "Unsupported input type.";
+			break;
+	}
+	if (!okay) {
+		store.words.resize((size_t)W*P);
+		mexErrMsgTxt(error);
+	}
+
+	// Look up each new labelling. Accepted ones are moved down to follow the
+	// stored ones.
+	plhs[0] = mxCreateDoubleMatrix(1, K, mxREAL);
+	double *index = mxGetPr(plhs[0]);
+	int Q = P;
+	for (int k = 0; k < K; k++) {
+		const uint64_t *w = &store.words[(size_t)W*(P+k)];
+		uint64_t h = hash_words(w, W);
+		int s = store.table.Find(w, h, &store.words[0], W);
+		if (s < 0) {
+			// Accept it
+			s = Q++;
+			if (s != P+k)
+				memmove(&store.words[(size_t)W*s], w, W*sizeof(uint64_t));
+			store.table.Add(h);
+			store.AddDistances(s);
+			if (store.fp)
+				fwrite(&store.words[(size_t)W*s], sizeof(uint64_t), W, store.fp);
+		}
+		index[k] = s + 1;
+	}
+	store.words.resize((size_t)W*Q);
+	store.Q = Q;
+	if (store.fp)
+		fflush(store.fp);
+
+	// Distances of the new labellings to all the stored ones
+	if (nlhs > 1) {
+		plhs[1] = mxCreateDoubleMatrix(K, Q, mxREAL);
+		double *d = mxGetPr(plhs[1]);
+		for (int t = 0; t < Q; t++) {
+			for (int k = 0; k < K; k++)
+				d[(size_t)K*t+k] = store.Distance((int)index[k]-1, t);
+		}
+	}
+}
+
+static void get_distances(const SolutionStore &store, int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+	if (nrhs > 3)
+		mexErrMsgTxt("Unexpected number of input arguments.");
+	if (nlhs > 1)
+		mexErrMsgTxt("Unexpected number of outputs.");
+
+	// Indices of the rows and columns, all the labellings by default
+	int n = store.Q;
+	std::vector<int> index;
+	if (nrhs > 2) {
+		if (!mxIsDouble(prhs[2]) || mxIsComplex(prhs[2]))
+			mexErrMsgTxt("index must be real doubles.");
+		n = mxGetNumberOfElements(prhs[2]);
+		const double *in = mxGetPr(prhs[2]);
+		index.resize(n);
+		for (int i = 0; i < n; i++) {
+			index[i] = (int)in[i] - 1;
+			if (index[i] < 0 || index[i] >= store.Q || index[i] != in[i] - 1)
+				mexErrMsgTxt("index references invalid labelling.");
+		}
+	} else {
+		index.resize(n);
+		for (int i = 0; i < n; i++)
+			index[i] = i;
+	}
+
+	plhs[0] = mxCreateDoubleMatrix(n, n, mxREAL);
+	double *D = mxGetPr(plhs[0]);
+	for (int j = 0; j < n; j++) {
+		for (int i = 0; i < n; i++)
+			D[(size_t)n*j+i] = store.Distance(index[i], index[j]);
+	}
+}
+
+static void get_labels(const SolutionStore &store, int nlhs, mxArray *plhs[])
+{
+	if (nlhs > 1)
+		mexErrMsgTxt("Unexpected number of outputs.");
+	plhs[0] = mxCreateNumericMatrix(store.N, store.Q, mxUINT8_CLASS, mxREAL);
+	unsigned char *L = (unsigned char *)mxGetData(plhs[0]);
+	for (int s = 0; s < store.Q; s++, L += store.N) {
+		const uint64_t *w = &store.words[(size_t)store.W*s];
+		for (int i = 0; i < store.N; i++)
+			L[i] = (unsigned char)((w[i>>6] >> (i & 63)) & 1);
+	}
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+	if (nrhs < 1 || !mxIsChar(prhs[0]))
+		mexErrMsgTxt("The first input must be a command string.");
+	char command[16];
+	mxGetString(prhs[0], command, 16);
+	if (!strcmp(command, "open")) {
+		open_store(nlhs, plhs, nrhs, prhs);
+		return;
+	}
+
+	if (nrhs < 2)
+		mexErrMsgTxt("Unexpected number of input arguments.");
+	int h;
+	SolutionStore *store = get_store(prhs[1], h);
+	if (!strcmp(command, "add")) {
+		if (nrhs != 3)
+			mexErrMsgTxt("Unexpected number of input arguments.");
+		add_labels(*store, nlhs, plhs, prhs[2]);
+	} else if (!strcmp(command, "distances")) {
+		get_distances(*store, nlhs, plhs, nrhs, prhs);
+	} else if (!strcmp(command, "labels")) {
+		if (nrhs != 2)
+			mexErrMsgTxt("Unexpected number of input arguments.");
+		get_labels(*store, nlhs, plhs);
+	} else if (!strcmp(command, "close")) {
+		if (nrhs != 2 || nlhs > 0)
+			mexErrMsgTxt("Unexpected number of arguments.");
+		delete store;
+		stores[h] = NULL;
+		mexUnlock();
+	} else {
+		mexErrMsgTxt("Unknown command.");
+	}
+	return;
+}
@@ -0,0 +1,50 @@
+%VGG_SOLUTION_STORE  Store of distinct binary labellings
+%
+%   h = vgg_solution_store('open', N, [filename])
+%   [index d] = vgg_solution_store('add', h, L)
+%   D = vgg_solution_store('distances', h, [index])
+%   L = vgg_solution_store('labels', h)
+%   vgg_solution_store('close', h)
+%
+% Keeps a store of distinct binary labellings in memory between calls, so
+% that labellings can be added one at a time (e.g. each mode of a DivMBest
+% run, as soon as it is computed) at a cost independent of the number of
+% calls. Labellings are kept bit-packed (64 nodes to a uint64 word). Each
+% new labelling is hashed, so that exact duplicates of a stored labelling,
+% or of an earlier labelling in the batch, are found without comparing it
+% to every stored labelling, and are not added. Only the Hamming distances
+% of an added labelling to the stored ones are computed, with popcount, the
+% store keeping the distance matrix. The added labellings can also be
+% appended to a file, so that a long run of modes can be streamed to disk.
+%
+% The store is kept until it is closed, and the MEX file is locked while
+% any store is open.
+%
+% IN:
+%   N - number of nodes of each labelling.
+%   filename - name of a file to which the added labellings are appended,
+%              ceil(N/64) uint64 words per labelling, node i being bit
+%              mod(i-1,64) of word floor((i-1)/64). Read them back with
+%              fread(fid, [ceil(N/64) inf], 'uint64=>uint64').
+%   h - handle of the store, as output by 'open'.
+%   L - NxK matrix, the kth column giving the labels (0 or 1) of N nodes
+%       in the kth new labelling. Can be logical, double, single or any
+%       integer type up to 32 bits.
+%   index - vector of indices of stored labellings. Default: all of them.
+%
+% OUT:
+%   h - handle of the new store.
+%   index - 1xK vector giving the index of each labelling in the store.
+%           Added labellings have indices greater than the number of
+%           labellings previously stored.
+%   d - KxQ matrix of the Hamming distances of the new labellings to the Q
+%       labellings in the store.
+%   D - Hamming distance matrix of the labellings in the store, or
+%       D(index,index) if index is given.
+%   L - NxQ uint8 matrix of the labellings in the store.
+
+function varargout = vgg_solution_store(varargin)
+funcName = mfilename;
+sourceList = {[funcName '.cxx']};
+vgg_mexcompile_script; % Compilation happens in this script
+return
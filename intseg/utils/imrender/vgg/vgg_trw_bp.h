@@ -0,0 +1,546 @@
+// Shared MEX glue for vgg_trw_bp and the functions built on top of it.
+// Reads the UE, PI, PE inputs documented in vgg_trw_bp.m into an MRFEnergy
+// graph, and keeps the graph alive so that it can be modified and
+// re-optimized (warm-started from the previous messages) several times.
+
+#ifndef __VGG_TRW_BP_H__
+#define __VGG_TRW_BP_H__
+
+#include <mex.h>
+#include "MRFEnergy.h"
+
+// Define types
+#ifdef _MSC_VER
+typedef unsigned __int16 uint16_t;
+typedef __int32 int32_t;
+typedef unsigned __int32 uint32_t;
+#else
+#include <stdint.h>
+#endif
+
+static inline void erfunc(char *err) {mexErrMsgTxt(err);}
+
+// Error of the MRF construction or minimization, thrown by throw_erfunc
+// instead of raising it through the MATLAB API. The caller catches it (e.g.
+// on a worker thread), frees its memory, then raises the error itself.
+struct MRFError
+{
+	const char *msg;
+	MRFError(const char *msg_) : msg(msg_) {}
+};
+static inline void throw_erfunc(char *err) {throw MRFError(err);}
+
+// Functions for general type
+template<class REAL> static inline typename MRFEnergy<TypeGeneralT<REAL> >::NodeId add_node(MRFEnergy<TypeGeneralT<REAL> > *mrf, int local_modes, REAL *graph_data)
+{
+	return mrf->AddNode(typename TypeGeneralT<REAL>::LocalSize(local_modes), typename TypeGeneralT<REAL>::NodeData(graph_data));
+}
+template<class REAL> static inline void add_node_data(MRFEnergy<TypeGeneralT<REAL> > *mrf, typename MRFEnergy<TypeGeneralT<REAL> >::NodeId node, int local_modes, REAL *graph_data)
+{
+	mrf->AddNodeData(node, typename TypeGeneralT<REAL>::NodeData(graph_data));
+}
+template<class REAL> static inline void add_edge(MRFEnergy<TypeGeneralT<REAL> > *mrf, typename MRFEnergy<TypeGeneralT<REAL> >::NodeId node1, typename MRFEnergy<TypeGeneralT<REAL> >::NodeId node2, REAL *graph_data)
+{
+	mrf->AddEdge(node1, node2, typename TypeGeneralT<REAL>::EdgeData(TypeGeneralT<REAL>::GENERAL, graph_data));
+}
+
+// Functions for binary type
+template<class REAL> static inline typename MRFEnergy<TypeBinaryT<REAL> >::NodeId add_node(MRFEnergy<TypeBinaryT<REAL> > *mrf, int local_modes, REAL *graph_data)
+{
+	return mrf->AddNode(typename TypeBinaryT<REAL>::LocalSize(), typename TypeBinaryT<REAL>::NodeData(graph_data[0], graph_data[1]));
+}
+template<class REAL> static inline void add_node_data(MRFEnergy<TypeBinaryT<REAL> > *mrf, typename MRFEnergy<TypeBinaryT<REAL> >::NodeId node, int local_modes, REAL *graph_data)
+{
+	mrf->AddNodeData(node, typename TypeBinaryT<REAL>::NodeData(graph_data[0], graph_data[1]));
+}
+template<class REAL> static inline void add_edge(MRFEnergy<TypeBinaryT<REAL> > *mrf, typename MRFEnergy<TypeBinaryT<REAL> >::NodeId node1, typename MRFEnergy<TypeBinaryT<REAL> >::NodeId node2, REAL *graph_data)
+{
+	mrf->AddEdge(node1, node2, typename TypeBinaryT<REAL>::EdgeData(graph_data[0], graph_data[2], graph_data[1], graph_data[3]));
+}
+
+// Functions for binary fast type
+template<class REAL> static inline typename MRFEnergy<TypeBinaryFastT<REAL> >::NodeId add_node(MRFEnergy<TypeBinaryFastT<REAL> > *mrf, int local_modes, REAL *graph_data)
+{
+	return mrf->AddNode(typename TypeBinaryFastT<REAL>::LocalSize(), typename TypeBinaryFastT<REAL>::NodeData(graph_data[0], graph_data[1]));
+}
+template<class REAL> static inline void add_node_data(MRFEnergy<TypeBinaryFastT<REAL> > *mrf, typename MRFEnergy<TypeBinaryFastT<REAL> >::NodeId node, int local_modes, REAL *graph_data)
+{
+	mrf->AddNodeData(node, typename TypeBinaryFastT<REAL>::NodeData(graph_data[0], graph_data[1]));
+}
+template<class REAL> static inline void add_edge(MRFEnergy<TypeBinaryFastT<REAL> > *mrf, typename MRFEnergy<TypeBinaryFastT<REAL> >::NodeId node1, typename MRFEnergy<TypeBinaryFastT<REAL> >::NodeId node2, REAL *graph_data)
+{
+	mrf->AddEdge(node1, node2, typename TypeBinaryFastT<REAL>::EdgeData(graph_data[0], graph_data[2], graph_data[1], graph_data[3]));
+}
+
+// Functions for truncated quadratic type
+template<class REAL> static inline typename MRFEnergy<TypeTruncatedQuadraticT<REAL> >::NodeId add_node(MRFEnergy<TypeTruncatedQuadraticT<REAL> > *mrf, int local_modes, REAL *graph_data)
+{
+	return mrf->AddNode(typename TypeTruncatedQuadraticT<REAL>::LocalSize(), typename TypeTruncatedQuadraticT<REAL>::NodeData(graph_data));
+}
+template<class REAL> static inline void add_node_data(MRFEnergy<TypeTruncatedQuadraticT<REAL> > *mrf, typename MRFEnergy<TypeTruncatedQuadraticT<REAL> >::NodeId node, int local_modes, REAL *graph_data)
+{
+	mrf->AddNodeData(node, typename TypeTruncatedQuadraticT<REAL>::NodeData(graph_data));
+}
+template<class REAL> static inline void add_edge(MRFEnergy<TypeTruncatedQuadraticT<REAL> > *mrf, typename MRFEnergy<TypeTruncatedQuadraticT<REAL> >::NodeId node1, typename MRFEnergy<TypeTruncatedQuadraticT<REAL> >::NodeId node2, REAL *graph_data)
+{
+	mrf->AddEdge(node1, node2, typename TypeTruncatedQuadraticT<REAL>::EdgeData(graph_data[0], graph_data[1]));
+}
+
+// Functions for truncated linear type
+template<class REAL> static inline typename MRFEnergy<TypeTruncatedLinearT<REAL> >::NodeId add_node(MRFEnergy<TypeTruncatedLinearT<REAL> > *mrf, int local_modes, REAL *graph_data)
+{
+	return mrf->AddNode(typename TypeTruncatedLinearT<REAL>::LocalSize(), typename TypeTruncatedLinearT<REAL>::NodeData(graph_data));
+}
+template<class REAL> static inline void add_node_data(MRFEnergy<TypeTruncatedLinearT<REAL> > *mrf, typename MRFEnergy<TypeTruncatedLinearT<REAL> >::NodeId node, int local_modes, REAL *graph_data)
+{
+	mrf->AddNodeData(node, typename TypeTruncatedLinearT<REAL>::NodeData(graph_data));
+}
+template<class REAL> static inline void add_edge(MRFEnergy<TypeTruncatedLinearT<REAL> > *mrf, typename MRFEnergy<TypeTruncatedLinearT<REAL> >::NodeId node1, typename MRFEnergy<TypeTruncatedLinearT<REAL> >::NodeId node2, REAL *graph_data)
+{
+	mrf->AddEdge(node1, node2, typename TypeTruncatedLinearT<REAL>::EdgeData(graph_data[0], graph_data[1]));
+}
+
+// Number of nodes of UE, which is either a cell array with one cell per
+// node, or a dense n_labels x n_nodes matrix
+static inline int num_nodes(const mxArray *UE)
+{
+	return mxIsCell(UE) ? mxGetNumberOfElements(UE) : mxGetN(UE);
+}
+
+// Output array for the labelling of UE: the size of UE for a cell array,
+// n_nodes x 1 for a dense matrix
+static inline mxArray *create_labelling(const mxArray *UE)
+{
+	if (mxIsCell(UE))
+		return mxCreateNumericMatrix(mxGetM(UE), mxGetN(UE), mxUINT16_CLASS, mxREAL);
+	return mxCreateNumericMatrix(mxGetN(UE), 1, mxUINT16_CLASS, mxREAL);
+}
+
+// Reads UE and sets nlabels to the number of labels of each node (delete[]
+// by the caller), along with the smallest and largest of these. single is set
+// if all the unary terms are singles, in which case the energy is minimized in
+// single precision. Returns an error message, or NULL, rather than raising it;
+// nlabels is NULL on an error.
+static inline const char *try_read_nlabels(const mxArray *UE, int *&nlabels, int &min_labels, int &max_labels, bool &single)
+{
+	nlabels = NULL;
+	min_labels = max_labels = 0;
+	single = false;
+	if (!mxIsCell(UE)) {
+		// Dense n_labels x n_nodes matrix
+		if (!mxIsDouble(UE) && !mxIsSingle(UE))
+			return "UE must be a cell array, or a double or single matrix.";
+		min_labels = max_labels = mxGetM(UE);
+		single = mxIsSingle(UE);
+		if (max_labels > 65536)
+			return "A maximum of 65536 nodes per label are supported.";
+		int n_nodes = mxGetN(UE);
+		nlabels = new int[n_nodes];
+		for (int i = 0; i < n_nodes; i++)
+			nlabels[i] = mxGetM(UE);
+		return NULL;
+	}
+	int n_nodes = mxGetNumberOfElements(UE);
+	int *labels = new int[n_nodes];
+	max_labels = 0;
+	min_labels = 65537;
+	single = n_nodes > 0;
+	for (int i = 0; i < n_nodes; i++) {
+		mxArray *data_array = mxGetCell(UE, i);
+		if (!mxIsDouble(data_array) && !mxIsSingle(data_array)) {
+			delete[] labels;
+			return "UE cells must be doubles or singles.";
+		}
+		single = single && mxIsSingle(data_array);
+		if (mxIsComplex(data_array)) {
+			delete[] labels;
+			return "UE cells must be real.";
+		}
+		labels[i] = mxGetN(data_array);
+		max_labels = labels[i] > max_labels ? labels[i] : max_labels;
+		min_labels = labels[i] < min_labels ? labels[i] : min_labels;
+	}
+	if (max_labels > 65536) {
+		delete[] labels;
+		return "A maximum of 65536 nodes per label are supported.";
+	}
+	nlabels = labels;
+	return NULL;
+}
+
+// As try_read_nlabels(), but returns nlabels and raises errors
+static inline int *read_nlabels(const mxArray *UE, int &min_labels, int &max_labels, bool &single)
+{
+	int *nlabels;
+	const char *error = try_read_nlabels(UE, nlabels, min_labels, max_labels, single);
+	if (error)
+		mexErrMsgTxt(error);
+	return nlabels;
+}
+
+// Reads the optional int32 options vector {UseTRW, Type, MaxIters, NumThreads,
+// Ordering} into options[2..6] (see vgg_trw_bp.m).
+static void read_options(const mxArray *opts, int options[])
+{
+	if (!mxIsInt32(opts))
+		mexErrMsgTxt("options should be int32s");
+	const int32_t *params = (const int32_t *)mxGetData(opts);
+	switch (mxGetNumberOfElements(opts)) {
+		default:
+		case 5:
+			options[6] = (int)params[4];
+			if (options[6] < 0 || options[6] > 3)
+				mexErrMsgTxt("Ordering should be 0, 1, 2 or 3.");
+		case 4:
+			options[5] = (int)params[3];
+		case 3:
+			options[4] = (int)params[2];
+		case 2:
+			options[3] = (int)params[1];
+		case 1:
+			options[2] = (int)params[0] != 0;
+		case 0:
+			break;
+	}
+}
+
+// Stopping criteria of the minimization, in addition to MaxIters
+struct StopCriteria
+{
+	double eps; // TRW-S: stop if the lower bound increases by at most eps in an iteration (< 0: never)
+	double gap; // TRW-S: stop if energy - lower bound <= gap (< 0: never)
+	double time_max; // stop after time_max seconds (<= 0: no limit)
+	int energy_iter; // compute the energy every energy_iter iterations (<= 0: only at the end)
+
+	StopCriteria() : eps(0), gap(-1), time_max(0), energy_iter(0) {}
+};
+
+// Reads the optional double vector {Epsilon, Gap, MaxTime, EnergyInterval}
+// (see vgg_trw_bp.m).
+static inline void read_stop(const mxArray *stop, StopCriteria &criteria)
+{
+	if (!mxIsDouble(stop))
+		mexErrMsgTxt("stop should be doubles");
+	const double *params = mxGetPr(stop);
+	switch (mxGetNumberOfElements(stop)) {
+		default:
+		case 4:
+			criteria.energy_iter = (int)params[3];
+		case 3:
+			criteria.time_max = params[2];
+		case 2:
+			criteria.gap = params[1];
+		case 1:
+			criteria.eps = params[0];
+		case 0:
+			break;
+	}
+}
+
+// Returns n values of a double or single array, read with the given
+// stride, as REALs. If the array is already of type REAL and the values are
+// contiguous, its data is returned directly; otherwise the values are
+// converted into buf.
+template<class REAL> static inline REAL *read_reals(const void *data, bool single, int n, int stride, REAL *buf)
+{
+	if (single) {
+		if (sizeof(REAL) == sizeof(float) && stride == 1)
+			return (REAL *)data;
+		for (int j = 0; j < n; j++)
+			buf[j] = (REAL)((const float *)data)[j*stride];
+	} else {
+		if (sizeof(REAL) == sizeof(double) && stride == 1)
+			return (REAL *)data;
+		for (int j = 0; j < n; j++)
+			buf[j] = (REAL)((const double *)data)[j*stride];
+	}
+	return buf;
+}
+
+// The UE, PI and PE inputs of one MRF, checked and unpacked from the
+// MATLAB arrays by Read(). UE and PE may be cell arrays or dense matrices
+// (see vgg_trw_bp.m); the energies are not copied. The MRF can then be constructed from it without
+// calling the MATLAB API, e.g. from a worker thread.
+struct MRFInput
+{
+	int n_nodes;
+	int n_edges;
+	const int *nlabels;
+	const void **unary; // first unary energy of each node
+	int *unary_stride; // distance between the energies of consecutive labels
+	bool *unary_single;
+	int *edge_nodes; // 0-based start and end node of each edge
+	const void **pairwise; // energy table of each edge
+	int *pairwise_len;
+	bool *pairwise_single;
+
+	MRFInput() : n_nodes(0), n_edges(0), nlabels(NULL), unary(NULL), unary_stride(NULL), unary_single(NULL),
+		edge_nodes(NULL), pairwise(NULL), pairwise_len(NULL), pairwise_single(NULL) {}
+	~MRFInput()
+	{
+		delete[] unary; delete[] unary_stride; delete[] unary_single;
+		delete[] edge_nodes; delete[] pairwise; delete[] pairwise_len; delete[] pairwise_single;
+	}
+
+	// options as in vgg_trw_bp.cxx, nlabels as returned by read_nlabels().
+	// Returns an error message, or NULL. It isn't raised, so that the caller
+	// can free its memory first; the arrays read so far are freed by the
+	// destructor.
+	const char *Read(const mxArray *UE, const mxArray *PI, const mxArray *PE, const int options[], const int *nlabels);
+};
+
+inline const char *MRFInput::Read(const mxArray *UE, const mxArray *PI_array, const mxArray *PE, const int options[], const int *nlabels_)
+{
+	nlabels = nlabels_;
+	n_nodes = num_nodes(UE);
+
+	// edges
+	int Pindices = mxGetM(PI_array);
+	if (Pindices != 2 && Pindices != 3)
+		return "Unexpected dimensions for PI";
+	int nP = mxGetN(PI_array);
+	bool PEcells = mxIsCell(PE);
+	if (!PEcells && !mxIsDouble(PE) && !mxIsSingle(PE))
+		return "PE must be a cell array, or a double or single matrix.";
+	int nPE = PEcells ? mxGetNumberOfElements(PE) : mxGetN(PE);
+	if (Pindices == 2 && nP != nPE)
+		return "Without explicit indices, PI should have the same number of PE as pairwise hase cells";
+	if (!mxIsUint32(PI_array))
+		return "PI should be uint32s";
+	const uint32_t *PI = (const uint32_t *)mxGetData(PI_array);
+
+	// Unary energies
+	unary = new const void *[n_nodes];
+	unary_stride = new int[n_nodes];
+	unary_single = new bool[n_nodes];
+	if (mxIsCell(UE)) {
+		for (int i = 0; i < n_nodes; i++) {
+			mxArray *data_array = mxGetCell(UE, i);
+			unary[i] = mxGetData(data_array);
+			unary_stride[i] = mxGetM(data_array);
+			unary_single[i] = mxIsSingle(data_array);
+		}
+	} else {
+		// Columns of the matrix, read in place
+		const char *data = (const char *)mxGetData(UE);
+		int column_bytes = mxGetM(UE) * mxGetElementSize(UE);
+		for (int i = 0; i < n_nodes; i++) {
+			unary[i] = data + (size_t)i*column_bytes;
+			unary_stride[i] = 1;
+			unary_single[i] = mxIsSingle(UE);
+		}
+	}
+
+	// Pairwise energies
+	n_edges = nP;
+	edge_nodes = new int[2*nP];
+	pairwise = new const void *[nP];
+	pairwise_len = new int[nP];
+	pairwise_single = new bool[nP];
+	for (int i = 0; i < nP; i++, PI += Pindices) {
+		// Calculate index of energy table
+		int table = i;
+		if (Pindices == 3) {
+			if (PI[2] < 1 || (int)PI[2] > nPE)
+				return "Column of PI references invalid cell of PE";
+			table = PI[2] - 1;
+		}
+
+		if (PI[0] < 1 || (int)PI[0] > n_nodes || PI[1] < 1 || (int)PI[1] > n_nodes)
+			return "PI references invalid node";
+		int n1 = PI[0] - 1;
+		int n2 = PI[1] - 1;
+		edge_nodes[2*i] = n1;
+		edge_nodes[2*i+1] = n2;
+
+		if (!PEcells) {
+			// Each column of the matrix is one energy table, read in place
+			int len = options[0] < 0 ? nlabels[n1] * nlabels[n2] : options[0];
+			if ((int)mxGetM(PE) != len)
+				return "PE matrix has unexpected number of rows.";
+			pairwise[i] = (const char *)mxGetData(PE) + (size_t)table*mxGetM(PE)*mxGetElementSize(PE);
+			pairwise_len[i] = mxGetM(PE);
+			pairwise_single[i] = mxIsSingle(PE);
+			continue;
+		}
+
+		mxArray *data_array = mxGetCell(PE, table);
+		if (!mxIsDouble(data_array) && !mxIsSingle(data_array))
+			return "pairwise cells must be doubles or singles.";
+		if (mxIsComplex(data_array))
+			return "pairwise cells must be real.";
+		if (options[0] < 0) {
+			if ((int)mxGetM(data_array) != nlabels[n1] || (int)mxGetN(data_array) != nlabels[n2])
+				return "PE cell has unexpected dimensions.";
+			pairwise_len[i] = nlabels[n1] * nlabels[n2];
+		} else {
+			if ((int)mxGetNumberOfElements(data_array) != options[0])
+				return "PE cell has unexpected number of elements.";
+			pairwise_len[i] = options[0];
+		}
+		pairwise[i] = mxGetData(data_array);
+		pairwise_single[i] = mxIsSingle(data_array);
+	}
+	return NULL;
+}
+
+// Persistent MRF: the graph is constructed once from the MATLAB inputs,
+// after which unary terms can be added to and the energy re-minimized any
+// number of times. Messages are never cleared between calls to Minimize(),
+// so each optimization is warm-started from the previous one.
+template<class TYPE> class MRFHandle
+{
+public:
+	typedef typename TYPE::REAL REAL;
+	typedef typename MRFEnergy<TYPE>::NodeId NodeId;
+
+	// options as in vgg_trw_bp.cxx: {ParamsPerEdge, max_labels, UseTRW, Type, max_iters, num_threads, ordering}
+	// errorFn is called by MRFEnergy on an error: erfunc raises it in MATLAB,
+	// throw_erfunc throws an MRFError, after which the handle can still be
+	// destroyed.
+	MRFHandle(const mxArray *UE, const mxArray *PI, const mxArray *PE, const int options[], const int *nlabels, void (*errorFn)(char *) = erfunc);
+	// Doesn't call the MATLAB API (with errorFn = throw_erfunc), so may be
+	// used from any thread. input needs to stay valid only during the call.
+	MRFHandle(const MRFInput &input, const int options[], void (*errorFn)(char *) = erfunc);
+	~MRFHandle();
+
+	int NumNodes() const { return n_nodes; }
+	int NumLabels(int i) const { return nlabels[i]; }
+
+	// Adds value to the unary term of label (0-based) of node i
+	void AddUnary(int i, int label, REAL value);
+	// Adds values[0..NumLabels(i)-1] to the unary terms of node i
+	void AddUnaries(int i, const REAL *values) { add_node_data(mrf, nodes[i], nlabels[i], const_cast<REAL *>(values)); }
+
+	// Runs TRW-S or BP from the current messages. Returns the number of
+	// iterations, and sets energy (and lowerBound, for TRW-S only)
+	int Minimize(REAL &energy, REAL &lowerBound);
+
+	void SetStopCriteria(const StopCriteria &criteria) { stop = criteria; }
+
+	// Arrays of max(max_iters, 1) elements, filled by Minimize() with the lower
+	// bound, energy (NaN if not computed) and time of each iteration. Any
+	// of them may be NULL.
+	void SetTrace(double *lower_bound, double *energy, double *time) { trace_lower_bound = lower_bound; trace_energy = energy; trace_time = time; }
+
+	// Label (0-based) of node i after the last call to Minimize()
+	int GetSolution(int i) { return (int)mrf->GetSolution(nodes[i]); }
+
+	// Don't print progress (which is not allowed from worker threads)
+	void SetQuiet() { verbose = false; }
+
+private:
+	MRFEnergy<TYPE> *mrf;
+	NodeId *nodes;
+	const int *nlabels;
+	int n_nodes;
+	int use_trw;
+	int max_iters;
+	int num_threads;
+	typename MRFEnergy<TYPE>::OrderingType ordering;
+	bool ordered;
+	bool verbose;
+	StopCriteria stop;
+	double *trace_lower_bound, *trace_energy, *trace_time;
+	REAL *graph_data; // staging buffer of max_labels^2 elements (for inputs not already of type REAL), kept zeroed between calls to AddUnary()
+
+	void Build(const MRFInput &input, const int options[], void (*errorFn)(char *));
+	void Free();
+};
+
+template<class TYPE> MRFHandle<TYPE>::MRFHandle(const mxArray *UE, const mxArray *PI, const mxArray *PE, const int options[], const int *nlabels_, void (*errorFn)(char *))
+	: mrf(NULL), nodes(NULL), nlabels(nlabels_), n_nodes(num_nodes(UE)),
+	  use_trw(options[2]), max_iters(options[4]), num_threads(options[5]), ordering((typename MRFEnergy<TYPE>::OrderingType)options[6]), ordered(false), verbose(true),
+	  trace_lower_bound(NULL), trace_energy(NULL), trace_time(NULL), graph_data(NULL)
+{
+	MRFInput input;
+	const char *error = input.Read(UE, PI, PE, options, nlabels);
+	if (error)
+		errorFn(const_cast<char *>(error));
+	Build(input, options, errorFn);
+}
+
+template<class TYPE> MRFHandle<TYPE>::MRFHandle(const MRFInput &input, const int options[], void (*errorFn)(char *))
+	: mrf(NULL), nodes(NULL), nlabels(input.nlabels), n_nodes(input.n_nodes),
+	  use_trw(options[2]), max_iters(options[4]), num_threads(options[5]), ordering((typename MRFEnergy<TYPE>::OrderingType)options[6]), ordered(false), verbose(true),
+	  trace_lower_bound(NULL), trace_energy(NULL), trace_time(NULL), graph_data(NULL)
+{
+	Build(input, options, errorFn);
+}
+
+template<class TYPE> void MRFHandle<TYPE>::Build(const MRFInput &input, const int options[], void (*errorFn)(char *))
+{
+	try {
+		mrf = new MRFEnergy<TYPE>(typename TYPE::GlobalSize(options[1]), errorFn);
+		nodes = new NodeId[n_nodes];
+		graph_data = new REAL[options[1]*options[1]];
+
+		// Add unary energies
+		for (int i = 0; i < n_nodes; i++)
+			nodes[i] = add_node(mrf, nlabels[i], read_reals(input.unary[i], input.unary_single[i], nlabels[i], input.unary_stride[i], graph_data));
+
+		// Add pairwise energies
+		for (int i = 0; i < input.n_edges; i++)
+			add_edge(mrf, nodes[input.edge_nodes[2*i]], nodes[input.edge_nodes[2*i+1]], read_reals(input.pairwise[i], input.pairwise_single[i], input.pairwise_len[i], 1, graph_data));
+	} catch (...) {
+		// The destructor isn't called if the constructor throws
+		Free();
+		throw;
+	}
+
+	memset(graph_data, 0, options[1]*options[1]*sizeof(REAL));
+}
+
+template<class TYPE> MRFHandle<TYPE>::~MRFHandle()
+{
+	Free();
+}
+
+template<class TYPE> void MRFHandle<TYPE>::Free()
+{
+	delete[] graph_data;
+	delete[] nodes;
+	delete mrf;
+	graph_data = NULL;
+	nodes = NULL;
+	mrf = NULL;
+}
+
+template<class TYPE> void MRFHandle<TYPE>::AddUnary(int i, int label, REAL value)
+{
+	graph_data[label] = value;
+	add_node_data(mrf, nodes[i], nlabels[i], graph_data);
+	graph_data[label] = 0;
+}
+
+template<class TYPE> int MRFHandle<TYPE>::Minimize(REAL &energy, REAL &lowerBound)
+{
+	if (!ordered) {
+		// Function below is optional - it may help if, for example, nodes are added in a random order
+		mrf->SetAutomaticOrdering(ordering);
+		ordered = true;
+	}
+
+	typename MRFEnergy<TYPE>::Options mrf_options;
+	mrf_options.m_iterMax = max_iters; // maximum number of iterations
+	mrf_options.m_numThreads = num_threads;
+	mrf_options.m_verbose = verbose;
+	mrf_options.m_eps = (REAL)stop.eps;
+	mrf_options.m_gap = (REAL)stop.gap;
+	mrf_options.m_timeMax = stop.time_max;
+	if (stop.energy_iter > 0)
+		mrf_options.m_printIter = mrf_options.m_printMinIter = stop.energy_iter;
+	mrf_options.m_traceLowerBound = trace_lower_bound;
+	mrf_options.m_traceEnergy = trace_energy;
+	mrf_options.m_traceTime = trace_time;
+	lowerBound = 0;
+
+	if (use_trw) {
+		/////////////////////// TRW-S algorithm //////////////////////
+		return mrf->Minimize_TRW_S(mrf_options, lowerBound, energy);
+	}
+	//////////////////////// BP algorithm ////////////////////////
+	return mrf->Minimize_BP(mrf_options, energy);
+}
+
+#endif
@@ -1,6 +1,6 @@
 %VGG_TRW_BP  Multi-label MRF energy minimization using TRW-S & LBP
 %
-%   [L energy lower_bound] = vgg_trw_bp(UE, PI, PE, [options])
+%   [L energy lower_bound info] = vgg_trw_bp(UE, PI, PE, [options], [stop])
 %
 % Uses the message passing algorithms TRW-S or LBP to solve an MRF energy
 % minimization problem with binary or multiple labels.
@@ -12,9 +12,15 @@
 %
 % IN:
 %   UE - HxW cell array of unary terms for H*W nodes in the graph. Each
-%        cell contains a KxL double matrix, with the first row being the L
-%        energies for each of the L possible labels for that node. The
-%        number of labels does not need to be constant across nodes.
+%        cell contains a KxL double or single matrix, with the first row
+%        being the L energies for each of the L possible labels for that
+%        node. The number of labels does not need to be constant across
+%        nodes. If all the cells are single then the optimization is done
+%        in single precision, which halves the memory used by the
+%        messages; singles are then read without conversion when K == 1.
+%        Alternatively, UE can be an LxN double or single matrix, column i
+%        giving the energies of node i, for N nodes with L labels each.
+%        The matrix is read in place, without building a cell per node.
 %   PI - {2,3}xN uint32 matrix, each column containing the following
 %        information on an edge: [start_node end_node
 %        [pairwise_energy_table_index]]. If there are only 2 rows then
@@ -24,21 +30,52 @@
 %        a pairwise function of the form defined by options(1). If the form
 %        is general (i.e. lookup table) then the cell conatins a L1xL2
 %        matrix, where L1 and L2 are the number of labels for the start and
-%        end nodes respectively.
-%   options - 1x3 int32 vector of optional parameters:
+%        end nodes respectively. Cells can be double or single.
+%        Alternatively, PE can be a double or single matrix with one
+%        column per pairwise function: L1*L2 rows for the general form
+%        (the L1xL2 table stored column-wise), 2 rows otherwise.
+%   options - 1x5 int32 vector of optional parameters:
 %      UseTRW - 0: use LBP; otherwise: use TRW-S. Default: 1.
 %      Type - Pairwise energy functional type. 0: general. 1: truncated
 %             quadratic - min(a*(l1-l2)^2,b). 2: truncated linear -
 %             min(a*abs(l1-l2),b). Easy to add support for others. Default:
 %             0.
 %      MaxIters - number of iterations of LBP or TRW to do. Default: 30.
+%      NumThreads - number of threads to use. Nodes that do not share an
+%                   edge are updated in parallel, in an order which gives
+%                   the same result as the single threaded passes.
+%                   Requires compilation with OpenMP. Default: 1.
+%      Ordering - order in which the nodes are processed. 0: greedy
+%                 minimum degree heuristic. 1: order of UE (e.g. raster
+%                 order for grids). 2: breadth first search. 3: reverse
+%                 Cuthill-McKee. Default: 0.
+%   stop - 1x4 double vector of optional stopping criteria, used in
+%          addition to MaxIters:
+%      Epsilon - TRW-S stops when the lower bound increases by no more than
+%                Epsilon in an iteration. Negative: never. Default: 0.
+%      Gap - TRW-S stops when energy - lower_bound <= Gap, checked whenever
+%            the energy is computed. Negative: never. Default: -1.
+%      MaxTime - stop after MaxTime seconds of optimization. 0: no limit.
+%                Default: 0.
+%      EnergyInterval - compute the energy of the current labelling every
+%                       EnergyInterval iterations (which costs about as
+%                       much as an iteration). 0: only at the end.
+%                       Default: 0.
 %
 % OUT:
 %   L - HxW uint16 matrix of the energy minimizing state of each
-%       node.
+%       node (Nx1 if UE is a matrix).
 %   energy - scalar giving E(L).
 %   lower_bound - scalar giving a lower bound on E(L) for any L. Only
 %                 calculated by TRW-S (i.e. 0 for LBP).
+%   info - structure with fields:
+%      iterations - number of iterations done.
+%      lower_bound - 1xiterations vector of the lower bound after each
+%                    iteration (0 for LBP).
+%      energy - 1xiterations vector of the energy after each iteration,
+%               NaN for iterations in which it wasn't computed.
+%      time - 1xiterations vector of the time in seconds from the start
+%             of the optimization to the end of each iteration.
 
 % $Id: vgg_trw_bp.m,v 1.2 2008/03/10 18:45:27 ojw Exp $
 
@@ -0,0 +1,187 @@
+//[L energy lower_bound] = vgg_trw_bp_batch(UE, PI, PE, options);
+
+// Solves a batch of independent MRFs in one call. The inputs of all the
+// MRFs are checked and unpacked on the MATLAB thread, then the MRFs are
+// constructed and minimized by a pool of OpenMP threads, each thread taking
+// the next unsolved MRF. Nothing in the parallel part calls the MATLAB API:
+// the errors of an MRF are thrown by throw_erfunc and recorded in its item,
+// and the first of them is raised on the MATLAB thread after the loop.
+
+#include <new>
+#include "vgg_trw_bp.h"
+
+// One MRF of the batch
+struct BatchItem
+{
+	MRFInput input;
+	int *nlabels;
+	int min_labels, max_labels;
+	bool single;
+	int options[7]; // as in vgg_trw_bp.cxx
+	uint16_t *L; // output labelling
+	double energy, lower_bound;
+	const char *error; // error of the construction or minimization, or NULL
+
+	BatchItem() : nlabels(NULL), L(NULL), energy(0), lower_bound(0), error(NULL) {}
+	~BatchItem() { delete[] nlabels; }
+};
+
+template<class TYPE> static void solve(BatchItem &item)
+{
+	typedef typename TYPE::REAL REAL;
+	MRFHandle<TYPE> mrf(item.input, item.options, throw_erfunc);
+	mrf.SetQuiet();
+
+	REAL energy, lowerBound = 0;
+	mrf.Minimize(energy, lowerBound);
+
+	for (int i = 0; i < item.input.n_nodes; i++)
+		item.L[i] = (uint16_t)mrf.GetSolution(i) + 1;
+	item.energy = (double)energy;
+	item.lower_bound = (double)lowerBound;
+}
+
+// The checks on the options have been done by check_type()
+template<class REAL> static void select_type(BatchItem &item, bool fast_binary)
+{
+	if (item.min_labels == 2 && item.max_labels == 2) {
+		if (fast_binary)
+			solve<TypeBinaryFastT<REAL> >(item);
+		else
+			solve<TypeBinaryT<REAL> >(item);
+		return;
+	}
+	switch (item.options[3]) {
+		case 0:
+			solve<TypeGeneralT<REAL> >(item);
+			break;
+		case 1:
+			solve<TypeTruncatedQuadraticT<REAL> >(item);
+			break;
+		case 2:
+			solve<TypeTruncatedLinearT<REAL> >(item);
+			break;
+	}
+}
+
+// Sets the number of parameters per edge, as vgg_trw_bp does. Returns an
+// error message, or NULL
+static const char *check_type(BatchItem &item)
+{
+	if (item.min_labels == 2 && item.max_labels == 2) {
+		// Binary mode
+		if (item.options[3] != 0)
+			return "For binary graphs, only the general form of energies is supported.";
+		item.options[0] = 4; // 4 costs per edge
+		return NULL;
+	}
+	switch (item.options[3]) {
+		case 0:
+			break;
+		case 1:
+		case 2:
+			item.options[0] = 2; // 2 parameters per edge: alpha & trunc thresh
+			break;
+		default:
+			return "Energy type not yet implemented. Why not give it a go yourself.";
+	}
+	return NULL;
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+	// Check number of inputs
+	if (nrhs < 3 || nrhs > 4)
+		mexErrMsgTxt("Unexpected number of input arguments.");
+	if (nlhs < 1 || nlhs > 3)
+		mexErrMsgTxt("Unexpected number of outputs.");
+	for (int i = 0; i < 3; i++) {
+		if (!mxIsCell(prhs[i]))
+			mexErrMsgTxt("UE, PI and PE must be cell arrays, with one cell per MRF.");
+	}
+	int n_mrfs = mxGetNumberOfElements(prhs[0]);
+	if ((int)mxGetNumberOfElements(prhs[1]) != n_mrfs || (int)mxGetNumberOfElements(prhs[2]) != n_mrfs)
+		mexErrMsgTxt("UE, PI and PE must have the same number of cells.");
+
+	// Check options. The threads are used across MRFs, each MRF being
+	// minimized by a single thread
+	int options[] = {-1, 0, 1, 0, 30, 1, 0}; // ParamsPerEdge, max_labels, UseTRW, Type, max_iters, num_threads, ordering
+	if (nrhs == 4)
+		read_options(prhs[3], options);
+	int num_threads = options[5] > 0 ? options[5] : 1;
+	options[5] = 1;
+
+	for (int b = 0; b < n_mrfs; b++) {
+		if (!mxGetCell(prhs[0], b) || !mxGetCell(prhs[1], b) || !mxGetCell(prhs[2], b))
+			mexErrMsgTxt("Empty cell in UE, PI or PE.");
+	}
+
+	// Read all the MRFs. Their errors are raised once the items are freed
+	BatchItem *items = new BatchItem[n_mrfs];
+	plhs[0] = mxCreateCellMatrix(mxGetM(prhs[0]), mxGetN(prhs[0]));
+	for (int b = 0; b < n_mrfs; b++) {
+		BatchItem &item = items[b];
+		const mxArray *UE = mxGetCell(prhs[0], b);
+		const mxArray *PI = mxGetCell(prhs[1], b);
+		const mxArray *PE = mxGetCell(prhs[2], b);
+		const char *error = try_read_nlabels(UE, item.nlabels, item.min_labels, item.max_labels, item.single);
+		if (!error) {
+			memcpy(item.options, options, sizeof(options));
+			item.options[1] = item.max_labels;
+			error = check_type(item);
+		}
+		if (!error)
+			error = item.input.Read(UE, PI, PE, item.options, item.nlabels);
+		if (error) {
+			delete[] items;
+			mexErrMsgTxt(error);
+		}
+
+		mxArray *L = create_labelling(UE);
+		mxSetCell(plhs[0], b, L);
+		item.L = (uint16_t *)mxGetData(L);
+	}
+
+	// Solve them
+	bool fast_binary = nlhs < 2; // energy & lower bound not required
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(dynamic, 1) num_threads(num_threads)
+#endif
+	for (int b = 0; b < n_mrfs; b++) {
+		try {
+			if (items[b].single)
+				select_type<float>(items[b], fast_binary);
+			else
+				select_type<double>(items[b], fast_binary);
+		} catch (MRFError &e) {
+			items[b].error = e.msg;
+		} catch (std::bad_alloc &) {
+			items[b].error = "Not enough memory";
+		}
+	}
+	for (int b = 0; b < n_mrfs; b++) {
+		if (items[b].error) {
+			const char *error = items[b].error;
+			delete[] items;
+			mexErrMsgTxt(error);
+		}
+	}
+
+	// Energies and lower bounds
+	if (nlhs > 1) {
+		plhs[1] = mxCreateDoubleMatrix(mxGetM(prhs[0]), mxGetN(prhs[0]), mxREAL);
+		double *E = mxGetPr(plhs[1]);
+		for (int b = 0; b < n_mrfs; b++)
+			E[b] = items[b].energy;
+		if (nlhs > 2) {
+			plhs[2] = mxCreateDoubleMatrix(mxGetM(prhs[0]), mxGetN(prhs[0]), mxREAL);
+			double *LB = mxGetPr(plhs[2]);
+			for (int b = 0; b < n_mrfs; b++)
+				LB[b] = items[b].lower_bound;
+		}
+	}
+
+	// Clean up
+	delete[] items;
+	return;
+}
@@ -0,0 +1,32 @@
+%VGG_TRW_BP_BATCH  Solve many MRFs with TRW-S & LBP in one call
+%
+%   [L energy lower_bound] = vgg_trw_bp_batch(UE, PI, PE, [options])
+%
+% Equivalent to calling vgg_trw_bp on each MRF in turn, but with a single
+% MEX call. The MRFs are solved in parallel, each by one thread.
+%
+% IN:
+%   UE, PI, PE - cell arrays of the same size, the bth cells giving the
+%                UE, PI and PE inputs of vgg_trw_bp for the bth MRF.
+%   options - 1x5 int32 vector of optional parameters, as for vgg_trw_bp,
+%             applied to every MRF, except that NumThreads gives the
+%             number of MRFs solved at the same time. Requires
+%             compilation with OpenMP.
+%
+% OUT:
+%   L - cell array the size of UE, the bth cell giving the output L of
+%       vgg_trw_bp for the bth MRF.
+%   energy - array the size of UE of the energies of the labellings.
+%   lower_bound - array the size of UE of the lower bounds on the
+%                 energies. Only calculated by TRW-S (i.e. 0 for LBP).
+%
+% See also VGG_TRW_BP.
+
+function varargout = vgg_trw_bp_batch(varargin)
+funcName = mfilename;
+sd = 'trw-s/';
+sourceList = {['-I' sd], [funcName '.cxx'], [sd 'MRFEnergy.cpp'],...
+              [sd 'minimize.cpp'], [sd 'ordering.cpp'],...
+              [sd 'treeProbabilities.cpp']};
+vgg_mexcompile_script; % Compilation happens in this script
+return
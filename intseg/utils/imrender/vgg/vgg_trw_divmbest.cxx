@@ -0,0 +1,258 @@
+//[L energy lower_bound] = vgg_trw_divmbest(UE, PI, PE, lambda, M, options, diversity, callback_func);
+
+// Diverse M-best solutions with TRW-S/BP. The graph is built once, and each
+// mode changes the unary terms in place according to the previous mode, then
+// re-optimizes starting from the messages of the previous mode:
+//   Hamming: adds lambda to the unary term of the label taken by every node
+//   Boundary: as Hamming, but only for nodes with a neighbour of another label
+//   Perturb: replaces the unary terms by the original ones plus lambda times
+//            i.i.d. samples of log(-log(U)), U uniform in (0,1) (perturb & MAP)
+
+#include "vgg_trw_bp.h"
+#include <math.h>
+#include <string.h>
+#include <new>
+
+enum { HAMMING = 0, BOUNDARY = 1, PERTURB = 2 };
+
+// Seeded generator of uniform samples (splitmix64), so that perturbations
+// are the same across runs and platforms
+class UniformSampler
+{
+public:
+	UniformSampler(uint64_t seed) : state(seed) {}
+
+	// Returns a sample in the open interval (0,1)
+	double Next()
+	{
+		uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		z ^= z >> 31;
+		return ((z >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+	}
+
+private:
+	uint64_t state;
+};
+
+template<class TYPE> static inline const char *wrapper_func(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[], int options[], int *nlabels, int type, double seed);
+template<class REAL> static const char *select_type(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[], int options[], int *nlabels, int min_labels, int max_labels, int type, double seed);
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+	// Check number of inputs
+	if (nrhs < 5 || nrhs > 8)
+		mexErrMsgTxt("Unexpected number of input arguments.");
+	if (nlhs < 1 || nlhs > 3)
+		mexErrMsgTxt("Unexpected number of outputs.");
+	for (int i = 0; i < nrhs; i++) {
+		if (mxIsComplex(prhs[i]))
+			mexErrMsgTxt("Inputs must be real.");
+	}
+	if (mxGetNumberOfElements(prhs[3]) != 1 || mxGetNumberOfElements(prhs[4]) != 1)
+		mexErrMsgTxt("lambda and M must be scalars.");
+	if (mxGetScalar(prhs[4]) < 1)
+		mexErrMsgTxt("M must be at least 1.");
+
+	// Check options
+	int options[] = {-1, 0, 1, 0, 30, 1, 0}; // ParamsPerEdge, max_labels, UseTRW, Type, max_iters, num_threads, ordering
+	if (nrhs >= 6 && !mxIsEmpty(prhs[5]))
+		read_options(prhs[5], options);
+	if (options[3] < 0 || options[3] > 2)
+		mexErrMsgTxt("Energy type not yet implemented. Why not give it a go yourself.");
+
+	// Type of diversity, and seed of the perturbations
+	int type = HAMMING;
+	double seed = 0;
+	if (nrhs > 6 && !mxIsEmpty(prhs[6])) {
+		if (!mxIsDouble(prhs[6]) || mxGetNumberOfElements(prhs[6]) < 1 || mxGetNumberOfElements(prhs[6]) > 2)
+			mexErrMsgTxt("diversity should be a double vector [Type Seed].");
+		type = (int)mxGetPr(prhs[6])[0];
+		if (mxGetNumberOfElements(prhs[6]) > 1)
+			seed = mxGetPr(prhs[6])[1];
+		if (type != HAMMING && type != BOUNDARY && type != PERTURB)
+			mexErrMsgTxt("Diversity type should be 0, 1 or 2.");
+	}
+
+	// Check unary terms
+	int max_labels, min_labels;
+	bool single;
+	int *nlabels = read_nlabels(prhs[0], min_labels, max_labels, single);
+	options[1] = max_labels;
+
+	// Single precision UE cells select single precision messages. Errors are
+	// raised once nlabels is freed.
+	const char *error;
+	if (single)
+		error = select_type<float>(nlhs, plhs, nrhs, prhs, options, nlabels, min_labels, max_labels, type, seed);
+	else
+		error = select_type<double>(nlhs, plhs, nrhs, prhs, options, nlabels, min_labels, max_labels, type, seed);
+	delete[] nlabels;
+	if (error)
+		mexErrMsgTxt(error);
+	return;
+}
+
+template<class REAL> static const char *select_type(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[], int options[], int *nlabels, int min_labels, int max_labels, int type, double seed)
+{
+	if (min_labels == 2 && max_labels == 2) {
+		// Binary mode. The energies of the modes are needed, so the fast
+		// binary type can't be used
+		if (options[3] != 0)
+			return "For binary graphs, only the general form of energies is supported.";
+		options[0] = 4; // 4 costs per edge
+		return wrapper_func<TypeBinaryT<REAL> >(nlhs, plhs, nrhs, prhs, options, nlabels, type, seed);
+	}
+	// Non-binary mode
+	// Which type of pairwise energies are used (checked by mexFunction)
+	switch (options[3]) {
+		case 1:
+			// Truncated quadratic
+			options[0] = 2; // 2 parameters per edge: alpha & trunc thresh
+			return wrapper_func<TypeTruncatedQuadraticT<REAL> >(nlhs, plhs, nrhs, prhs, options, nlabels, type, seed);
+		case 2:
+			// Truncated linear
+			options[0] = 2; // 2 parameters per edge: alpha & trunc thresh
+			return wrapper_func<TypeTruncatedLinearT<REAL> >(nlhs, plhs, nrhs, prhs, options, nlabels, type, seed);
+		default:
+			// General form
+			return wrapper_func<TypeGeneralT<REAL> >(nlhs, plhs, nrhs, prhs, options, nlabels, type, seed);
+	}
+}
+
+// Calls callback_func with the labelling of a mode as soon as it is computed.
+// Returns false if the callback fails. Its error is trapped, so that the
+// caller can free its memory before raising an error.
+static bool call_back(const mxArray *callback, const uint16_t *L, int n_nodes)
+{
+	mxArray *inputArrays[2];
+	inputArrays[0] = (mxArray *)callback;
+	inputArrays[1] = mxCreateNumericMatrix(n_nodes, 1, mxUINT16_CLASS, mxREAL);
+	memcpy(mxGetData(inputArrays[1]), L, n_nodes*sizeof(uint16_t));
+	mxArray *exception = mexCallMATLABWithTrap(0, NULL, 2, inputArrays, "feval");
+	mxDestroyArray(inputArrays[1]);
+	if (!exception)
+		return true;
+	mxDestroyArray(exception);
+	return false;
+}
+
+// Sets boundary[i] for the nodes i of every edge of PI (already checked by
+// MRFInput::Read()) whose two nodes have different labels in L
+static void mark_boundary(const mxArray *PI_array, const uint16_t *L, bool *boundary)
+{
+	int Pindices = mxGetM(PI_array);
+	int nP = mxGetN(PI_array);
+	const uint32_t *PI = (const uint32_t *)mxGetData(PI_array);
+	for (int e = 0; e < nP; e++, PI += Pindices) {
+		if (L[PI[0]-1] != L[PI[1]-1])
+			boundary[PI[0]-1] = boundary[PI[1]-1] = true;
+	}
+}
+
+// Returns an error message, or NULL, to be raised by the caller once its own
+// memory has been freed
+template<class TYPE> static inline const char *wrapper_func(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[], int options[], int *nlabels, int type, double seed)
+{
+	typedef typename TYPE::REAL REAL;
+	int n_nodes = num_nodes(prhs[0]);
+	REAL lambda = (REAL)mxGetScalar(prhs[3]);
+	int M = (int)mxGetScalar(prhs[4]);
+	const mxArray *callback = nrhs > 7 && !mxIsEmpty(prhs[7]) ? prhs[7] : NULL;
+
+	// Create the outputs
+	plhs[0] = mxCreateNumericMatrix(n_nodes, M, mxUINT16_CLASS, mxREAL);
+	uint16_t *L = (uint16_t *)mxGetData(plhs[0]);
+	double *E = NULL, *LB = NULL;
+	if (nlhs > 1) {
+		plhs[1] = mxCreateDoubleMatrix(1, M, mxREAL);
+		E = mxGetPr(plhs[1]);
+		if (nlhs > 2) {
+			plhs[2] = mxCreateDoubleMatrix(1, M, mxREAL);
+			LB = mxGetPr(plhs[2]);
+		}
+	}
+
+	// Diversity terms added to each node so far, so that the energy of each
+	// mode can be reported without them
+	int K = options[1];
+	REAL *penalty = (REAL *)mxCalloc((size_t)n_nodes*K, sizeof(REAL));
+	REAL *delta = (REAL *)mxCalloc(K, sizeof(REAL));
+	bool *boundary = type == BOUNDARY ? (bool *)mxCalloc(n_nodes, sizeof(bool)) : NULL;
+	UniformSampler sampler((uint64_t)seed);
+
+	// The MRF is on the stack, and its errors are thrown rather than raised,
+	// so that it is freed however the modes end. Errors are raised once
+	// everything has been freed.
+	const char *error = NULL;
+	try {
+		MRFHandle<TYPE> mrf(prhs[0], prhs[1], prhs[2], options, nlabels, throw_erfunc);
+		for (int m = 0; m < M; m++, L += n_nodes) {
+			REAL energy, lowerBound;
+			mrf.Minimize(energy, lowerBound);
+
+			// Read solution, and remove the diversity terms from its energy
+			for (int i = 0; i < n_nodes; i++) {
+				L[i] = (uint16_t)mrf.GetSolution(i);
+				energy -= penalty[(size_t)i*K+L[i]];
+			}
+			if (E)
+				E[m] = (double)energy;
+			if (LB)
+				LB[m] = (double)lowerBound;
+
+			// Penalize the labels of this mode
+			if (m+1 < M) {
+				switch (type) {
+					case HAMMING:
+						for (int i = 0; i < n_nodes; i++) {
+							mrf.AddUnary(i, L[i], lambda);
+							penalty[(size_t)i*K+L[i]] += lambda;
+						}
+						break;
+					case BOUNDARY:
+						// Nodes at the end of an edge whose nodes have different labels
+						mark_boundary(prhs[1], L, boundary);
+						for (int i = 0; i < n_nodes; i++) {
+							if (!boundary[i])
+								continue;
+							mrf.AddUnary(i, L[i], lambda);
+							penalty[(size_t)i*K+L[i]] += lambda;
+							boundary[i] = false;
+						}
+						break;
+					case PERTURB:
+						// New perturbation, replacing the previous one
+						for (int i = 0; i < n_nodes; i++) {
+							REAL *p = penalty + (size_t)i*K;
+							for (int k = 0; k < nlabels[i]; k++) {
+								REAL g = lambda * (REAL)log(-log(sampler.Next()));
+								delta[k] = g - p[k];
+								p[k] = g;
+							}
+							mrf.AddUnaries(i, delta);
+						}
+						break;
+				}
+			}
+			for (int i = 0; i < n_nodes; i++)
+				L[i]++;
+			if (callback && !call_back(callback, L, n_nodes)) {
+				error = "Callback fails.";
+				break;
+			}
+		}
+	} catch (MRFError &e) {
+		error = e.msg;
+	} catch (std::bad_alloc &) {
+		error = "Not enough memory";
+	}
+
+	// Clean up
+	mxFree(penalty);
+	mxFree(delta);
+	if (boundary)
+		mxFree(boundary);
+	return error;
+}
@@ -0,0 +1,51 @@
+%VGG_TRW_DIVMBEST  Diverse M-best solutions of an MRF using TRW-S & LBP
+%
+%   [L energy lower_bound] = vgg_trw_divmbest(UE, PI, PE, lambda, M, [options], [diversity], [callback_func])
+%
+% Computes M diverse low energy labellings of an MRF, as in "Diverse M-Best
+% Solutions in Markov Random Fields", Batra et al., ECCV 2012. By default
+% each labelling minimizes the energy plus a Hamming penalty of lambda for
+% each node taking the same label as in any of the previous labellings.
+%
+% The graph is only constructed once, and each mode is computed from the
+% messages of the previous mode, which is much faster than calling
+% vgg_trw_bp M times.
+%
+% IN:
+%   UE, PI, PE - The MRF, as for vgg_trw_bp.
+%   lambda - scalar weight of the Hamming diversity term.
+%   M - number of labellings to compute.
+%   options - 1x5 int32 vector of optional parameters, as for vgg_trw_bp.
+%             May be empty.
+%   diversity - 1x2 double vector [Type Seed]. Type 0: Hamming penalty
+%               (default). 1: Hamming penalty only for the nodes with a
+%               neighbour of a different label in the previous labelling.
+%               2: perturb & MAP - each labelling after the first
+%               minimizes the energy plus lambda*log(-log(U)), for new
+%               i.i.d. samples U uniform in (0,1), generated from Seed
+%               (default: 0), so that results are reproducible. May be
+%               empty.
+%   callback_func - a function name or handle which is called with the Nx1
+%                   uint16 labelling of each mode (a column of L) as soon as
+%                   it is computed, e.g. to store or process the modes
+%                   while the next ones are computed. Its output is ignored.
+%
+% OUT:
+%   L - NxM uint16 matrix, the mth column giving the state of each of the
+%       N nodes in the mth labelling.
+%   energy - 1xM vector giving E(L(:,m)), without the diversity terms or
+%            perturbations.
+%   lower_bound - 1xM vector giving a lower bound on the energy plus the
+%                 diversity terms used to compute each labelling. Only
+%                 calculated by TRW-S (i.e. 0 for LBP).
+%
+% See also VGG_TRW_BP.
+
+function varargout = vgg_trw_divmbest(varargin)
+funcName = mfilename;
+sd = 'trw-s/';
+sourceList = {['-I' sd], [funcName '.cxx'], [sd 'MRFEnergy.cpp'],...
+              [sd 'minimize.cpp'], [sd 'ordering.cpp'],...
+              [sd 'treeProbabilities.cpp']};
+vgg_mexcompile_script; % Compilation happens in this script
+return
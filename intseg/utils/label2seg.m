@@ -1,12 +1,8 @@
 function seg = label2seg(L, splabels)
 
-nsp = length(unique(splabels));
-assert(nsp == length(L));
-
-seg = zeros(size(splabels));
-for j=1:nsp
-    inds = (splabels==j-1);
-    
-    seg(inds) = L(j);
-end
+% Paints the superpixel labelling L (one label per superpixel of the 0-based
+% superpixel map splabels) into a segmentation the size of splabels. If L
+% has several columns, seg has one segmentation per column along the third
+% dimension. Superpixel indices outside the range of L are an error.
 
+seg = vgg_seg_stats(L, splabels);
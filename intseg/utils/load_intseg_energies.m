@@ -0,0 +1,86 @@
+function params = load_intseg_energies(datadir, gtdir, fname, params)
+
+%
+% function params = load_intseg_energies(datadir, gtdir, fname, [params])
+%
+% Function to load the ground truth and the binary segmentation energies of one image of the
+% interactive segmentation data, in the form taken by DivMBest_intseg. If <fname>.bin (written by
+% convert_intseg_energies) exists in datadir, it is memory-mapped instead of loading <fname>.mat.
+%
+% Inputs
+% 1. datadir  -- directory of the <fname>.mat files holding data_term, labels and sparse_term.
+% 2. gtdir    -- directory of the <fname>.png ground truth images.
+% 3. fname    -- image name, without extension.
+% 4. params   -- (optional) structure to add the fields to.
+%
+% Outputs
+% 1. params   -- params with the fields fname, gt, labels (superpixel map), ne (2 x nnodes node
+%                energies), el (2 x nedges edge list) and ee (4 x nedges edge energies) set.
+
+if ~exist('params','var')
+  params = struct();
+end
+
+params.fname = fname;
+params.gt = imread(sprintf('%s/%s.png',gtdir,fname));
+
+binfile = sprintf('%s/%s.bin',datadir,fname);
+if exist(binfile,'file')
+  params = map_energies(binfile, params);
+  return
+end
+
+load_struct = load(sprintf('%s/%s.mat',datadir,fname));
+data_term = load_struct.data_term;
+params.labels = load_struct.labels;
+sparse_term = load_struct.sparse_term;
+
+% ne
+nnodes = size(data_term,2);
+assert(nnodes==length(unique(params.labels)));
+ne = data_term;
+
+% DB:  swap 1 and 0 terms because something funny seems to be going on. Maybe Payman was maximizing. Or maybe these are outputs of classifiers (so scores, not energies)
+ne([1 2],:) = ne([2 1],:); params.ne = ne;
+
+% el
+[node1 node2 wt] = find(triu(sparse_term));
+nedges = length(wt);
+params.el = [node1 node2]';
+
+% ee
+ee = zeros(4,nedges);
+ee(2,:) = wt;
+ee(3,:) = wt;
+params.ee = ee;
+end
+
+% Reads the binary format written by convert_intseg_energies
+function params = map_energies(binfile, params)
+
+m = memmapfile(binfile, 'Format', {'uint32', [1 8], 'header'}, 'Repeat', 1);
+header = double(m.Data.header);
+if header(1) ~= double(typecast(uint8('ISEG'),'uint32')) || header(2) ~= 1
+  error('%s is not an energy file of a supported version', binfile);
+end
+nnodes = header(3);
+nedges = header(4);
+m = memmapfile(binfile, 'Format', {'uint32', [1 8], 'header';
+                                   'double', [2 nnodes], 'ne';
+                                   'double', [1 nedges], 'wt';
+                                   'uint32', [1 nnodes+1], 'first';
+                                   'uint32', [1 nedges], 'node1';
+                                   'uint32', header(5:6), 'labels'}, 'Repeat', 1);
+data = m.Data;
+params.labels = data.labels;
+params.ne = data.ne;
+
+% Expand the compressed edge list: the second node of edge k is the last node whose edges start at
+% or before k
+node2 = cumsum(accumarray(double(data.first(1:end-1))'+1, 1, [nedges+1 1]));
+params.el = [data.node1; uint32(node2(1:nedges))'];
+
+params.ee = zeros(4,nedges);
+params.ee(2,:) = data.wt;
+params.ee(3,:) = data.wt;
+end
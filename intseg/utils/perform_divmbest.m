@@ -0,0 +1,77 @@
+function [L energy lower_bound] = perform_divmbest(node_energy, edge_list, edge_energy, lambda, nummodes, ...
+                                                   inference_opt, max_iter, div_type, seed, callback)
+
+%
+% function [L energy lower_bound] = perform_divmbest(node_energy, edge_list, edge_energy, lambda, nummodes,
+%                                   inference_opt, max_iter, div_type, seed, callback)
+%
+% Function to compute diverse M-best solutions of a pairwise MRF, in a single call to
+% vgg_trw_divmbest. The graph is built once, the diversity terms are applied to it in place and each
+% mode is warm-started from the messages of the previous one.
+%
+% Inputs:
+% 1-3. node_energy, edge_list, edge_energy -- as in perform_inference (tabular energies only).
+%
+% 4. lambda          weight of the diversity term.
+%
+% 5. nummodes        number of solutions M.
+%
+% 6. inference_opt   'trw' (default) or 'bp'.
+%
+% 7. max_iter        maximum number of iterations per mode (default 30).
+%
+% 8. div_type        'hamming' (default): Hamming diversity on all nodes.
+%                    'boundary': Hamming diversity only on nodes with a neighbour of a different label.
+%                    'perturb': perturb & MAP, adding lambda * log(-log(U)) to the node energies.
+%
+% 9. seed            seed of the perturbations (default 0).
+%
+% 10. callback       function handle called with the n_nodes x 1 labels (0-based numbering) of each mode
+%                    as soon as it is computed (default: none).
+%
+% Outputs:
+% 1. L               n_nodes x M matrix of labels (0-based numbering), one column per mode.
+%
+% 2. energy          1 x M vector holding the energy of each labelling (without diversity terms).
+%
+% 3. lower_bound     1 x M vector holding the TRW lower bound of the energy (with diversity terms) 
+%                    minimized for each mode. Set to -inf for bp.
+
+error(nargchk(5,10,nargin));
+
+if (~exist('inference_opt','var') || isempty(inference_opt))
+  inference_opt = 'trw';
+end
+if (~exist('max_iter','var') || isempty(max_iter))
+  max_iter = 30; 
+end
+if (~exist('div_type','var') || isempty(div_type))
+  div_type = 'hamming';
+end
+if (~exist('seed','var') || isempty(seed))
+  seed = 0;
+end
+div_code = find(strcmpi(div_type, {'hamming', 'boundary', 'perturb'})) - 1;
+if isempty(div_code)
+  error('unknown diversity type %s', div_type);
+end
+
+n_labels = size(node_energy,1);
+if (size(edge_energy,1) ~= n_labels^2)
+  error('perform_divmbest only supports tabular energies');
+end
+
+opts = int32([~isequal(inference_opt,'bp') 0 max_iter]);
+
+% The solver outputs 1-based labels
+mode_callback = [];
+if (exist('callback','var') && ~isempty(callback))
+  mode_callback = @(l) callback(double(l)-1);
+end
+
+[L energy lower_bound] = vgg_trw_divmbest(node_energy, uint32(edge_list), edge_energy, lambda, nummodes, opts, [div_code seed], mode_callback);
+L = double(L)-1;
+
+if isequal(inference_opt,'bp')
+  lower_bound(:) = -inf;
+end
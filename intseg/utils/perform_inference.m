@@ -1,9 +1,9 @@
-function [L energy lower_bound] = perform_inference(node_energy, edge_list, edge_energy, inference_opt, ...
-                                                  max_iter, planes, sp_data, en_type)
+function [L energy lower_bound info] = perform_inference(node_energy, edge_list, edge_energy, inference_opt, ...
+                                                  max_iter, planes, sp_data, en_type, stop)
 
 %
-% function [L energy lower_bound] = perform_inference(node_energy, edge_list, edge_energy,
-%                                   inference_opt, max_iter, planes, sp_data)
+% function [L energy lower_bound info] = perform_inference(node_energy, edge_list, edge_energy,
+%                                   inference_opt, max_iter, planes, sp_data, en_type, stop)
 %
 % Function to perform inference on a pairwise MRF. 
 %
@@ -30,6 +30,9 @@ function [L energy lower_bound] = perform_inference(node_energy, edge_list, edge
 %                    boolean label problem with the Ramalingam Battleship transformation, and then
 %                    apply the remaining method on this boolean problem.
 %
+% 9. stop            (optional, 'trw' and 'bp' only) [epsilon gap max_time energy_interval] early
+%                    stopping criteria, in addition to max_iter (see vgg_trw_bp).
+%
 %
 % Outputs:
 % 1. L               n_nodes x 1 vector of MAP labels (0-based numbering). If algorithm is 'qpbo' and
@@ -42,6 +45,9 @@ function [L energy lower_bound] = perform_inference(node_energy, edge_list, edge
 % 3. lower_bound     scalar holding lower bound on MAP energy. Only meaningful in the case of TRW. For
 %                    others, set to -inf.
 %
+% 4. info            for 'trw' and 'bp', structure of per-iteration lower bounds, energies and times
+%                    returned by vgg_trw_bp. Empty for other algorithms.
+%
 %
 % Dhruv Batra (batradhruv -at- cmu.edu)
 % Created: 04/21/2009
@@ -53,7 +59,7 @@ function [L energy lower_bound] = perform_inference(node_energy, edge_list, edge
 % Updated: 11/5/2009: Added en_type so that truncated quadratic and linear models maybe used with trw-s.
 % Updated: 03/15/2012: vgg_trw_bp bug fixes and workaround removed. 
 
-error(nargchk(4,8,nargin));
+error(nargchk(4,9,nargin));
 
 if (~exist('max_iter','var') || isempty(max_iter))
   max_iter = 30; 
@@ -63,6 +69,7 @@ n_labels = size(node_energy,1);
 n_nodes = size(node_energy,2);
 verbose_level = 0;
 lower_bound = -inf;
+info = [];
 
 if (~exist('en_type','var') || isempty(en_type))
   if (size(edge_energy,1) == n_labels^2) % tabular input
@@ -295,13 +302,14 @@ switch lower(inference_opt)
 %     if (n_labels == 2)
 %       edge_energy([2 3],:) = edge_energy([3 2],:); % vgg trw/bp code has a known bug for 2-label case.
 %     end
-    edge_energy = reshape(edge_energy(:),n_labels,n_labels,[]);
-    edge_energy = permute(num2cell(edge_energy,[1 2]),[2 3 1]);
+    % vgg_trw_bp reads the n_labels^2 x P matrix in place, one table per column
+    if (size(edge_energy,1)~=n_labels^2)
+      error('incorrect size of edge_energy');
+    end
   else
     if (size(edge_energy,1)~=2)
       error('incorrect size of edge_energy');
     end
-    edge_energy = num2cell(edge_energy,1)';
   end
     
   if isequal(inference_opt,'bp')
@@ -310,7 +318,10 @@ switch lower(inference_opt)
     opts = int32([1 en_type max_iter]);
   end
 
-  [L energy lower_bound] = vgg_trw_bp(num2cell(node_energy',2), uint32(edge_list), edge_energy, opts);
+  if (~exist('stop','var'))
+    stop = [];
+  end
+  [L energy lower_bound info] = vgg_trw_bp(node_energy, uint32(edge_list), edge_energy, opts, double(stop));
   L = L-1;
 
   if isequal(inference_opt,'bp')
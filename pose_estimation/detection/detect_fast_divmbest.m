@@ -37,157 +37,47 @@ numlevels = length(pyra.feat);
 
 
 % Cache various statistics derived from model
-[components,filters,resp] = modelcomponents(model,pyra);
-
-%boxes = zeros(10000,length(components{1})*4+2);
-%cnt   = 0;
-% AGR: one boxes array per mode each will hold a MAP for each level/scale
-boxes_rowsize = length(components{1})*4+2;
-boxes = zeros(numlevels,boxes_rowsize,nummodes);
-boxes(:,end,1:end) = -inf; % set scores to -inf
-
-% AGR: we'll have 3 copies of the model:
-parts_unmod = cell(numlevels,1); % unmodified to recover orignal scores
-parts_smode = cell(numlevels,1); % modified potentials for mmodes
-parts_wmsgs = cell(numlevels,1); % temporary for inference/traceback
+[components,bank] = modelcomponents(model,pyra);
 
+% The modes are only tracked per level, which assumes 1 component
+assert(length(model.components) == 1);
+parts    = components{1};
+numparts = length(parts);
 
-% Iterate over scales and components,
+% Filter responses of all the levels the parts need, in one call
+needed = false(numlevels,1);
 for rlevel = levels,
-    for c  = 1:length(model.components),
-        parts    = components{c};
-        numparts = length(parts);
-        
-        % Local scores
-        for k = 1:numparts,
-            f     = parts(k).filterid;
-            level = rlevel-parts(k).scale*interval;
-            if isempty(resp{level}),
-                resp{level} = fconv(pyra.feat{level},filters,1,length(filters));
-            end
-            for fi = 1:length(f)
-                parts(k).score(:,:,fi) = resp{level}{f(fi)};
-            end
-            parts(k).level = level;
-        end
-
-        % AGR: save copy before message passing
-        parts_smode{rlevel} = parts;
-        parts_unmod{rlevel} = parts;
-        
-        % Walk from leaves to root of tree, passing message to parent
-        for k = numparts:-1:2,
-            par = parts(k).parent;
-            [msg,parts(k).Ix,parts(k).Iy,parts(k).Ik] = passmsg(parts(k),parts(par));
-            parts(par).score = parts(par).score + msg;
-        end
-        
-        % Add bias to root score
-        parts(1).score = parts(1).score + parts(1).b;
-        parts_unmod{rlevel}(1).score = parts_unmod{rlevel}(1).score ...
-            + parts_unmod{rlevel}(1).b;
-
-        % AGR: traceback from max
-        [rscore Ik]    = max(parts(1).score,[],3);
-        [ss ys] = max(rscore);
-        [s x]   = max(ss);
-        y       = ys(x);
-        t       = Ik(y,x);
-        parts(1).XYT = [x y t];
-        [box score_unmod] = backtrack(x,y,t,parts,pyra,parts_unmod{rlevel});
-        if abs(rscore(y,x) - score_unmod) > 0.0001
-            fprintf('ERROR: rscore(y,x)=%f ~= score_unmod=%f\n',rscore(y,x),score_unmod);
-        end
-        
-        % AGR: save copy after message passing (used when suppressing mode)
-        parts_wmsgs{rlevel} = parts;
-        
-        if rscore(y,x) >= thresh
-            boxes(rlevel,:,1) = [box c rscore(y,x)];
-        else
-            parts_smode{rlevel} = [];
-            parts_wmsgs{rlevel} = [];
-            boxes(rlevel,end,1) = -inf;
-        end
+    for k = 1:numparts,
+        needed(rlevel-parts(k).scale*interval) = true;
     end
 end
+resp = fconvbank(bank,pyra.feat,find(needed));
 
-% AGR: suppress (overall) map
-[score_map level_map] = max(boxes(:,end,1));
-if score_map > -inf
-    parts = parts_wmsgs{level_map};
-    x = parts(1).XYT(1);
-    y = parts(1).XYT(2);
-    t = parts(1).XYT(3);
-    parts_smode{level_map} = ...
-        suppress_mode(parts_smode{level_map},parts,x,y,t,lambda,type);
-else
-    boxes(:,end,1:end) = -inf;
-    return;
+% Local scores of each part at each level
+scores = cell(numlevels,1);
+for rlevel = levels,
+    scores{rlevel} = cell(numparts,1);
+    for k = 1:numparts,
+        f     = parts(k).filterid;
+        level = rlevel-parts(k).scale*interval;
+        scores{rlevel}{k} = cat(3,resp{level}{f});
+    end
 end
 
-% AGR: so far we have the MAP, now find next best MAPs
-
-% Iterate over modes
-for mode = 2:nummodes
-    % Iterate over scales and components,
-    for rlevel = levels,
-        for c  = 1:length(model.components),
-            parts    = parts_smode{rlevel}; % components{c};
-            if isempty(parts)
-                boxes(rlevel,end,mode) = -inf;
-                continue;
-            end
-            numparts = length(parts);
-            
-            % Walk from leaves to root of tree, passing message to parent
-            for k = numparts:-1:2,
-                par = parts(k).parent;
-                [msg,parts(k).Ix,parts(k).Iy,parts(k).Ik] = passmsg(parts(k),parts(par));
-                parts(par).score = parts(par).score + msg;
-            end
-            
-            % Add bias to root score
-            parts(1).score = parts(1).score + parts(1).b;
-            [rscore Ik]    = max(parts(1).score,[],3);
-            
-            % AGR: traceback from max
-            [ss ys] = max(rscore);
-            [s x]   = max(ss);
-            y       = ys(x);
-            t = Ik(y,x);
-            parts(1).XYT = [x y t];
-            [box score_unmod] = backtrack(x,y,t,parts,pyra,parts_unmod{rlevel});
-            
-            % AGR: save copy after message passing (used when suppressing mode)
-            parts_wmsgs{rlevel} = parts;
-            
-            if score_unmod >= thresh
-                boxes(rlevel,:,mode) = [box c score_unmod];
-            else
-                parts_smode{rlevel} = [];
-                parts_wmsgs{rlevel} = [];
-                boxes(rlevel,end,mode) = -inf;
-            end
-        end
-    end
-    % AGR: suppress (overall) map
-    [score_map level_map] = max(boxes(:,end,mode));
-    if score_map > -inf
-        parts = parts_wmsgs{level_map};
-        x = parts(1).XYT(1);
-        y = parts(1).XYT(2);
-        t = parts(1).XYT(3);
-        parts_smode{level_map} = ...
-            suppress_mode(parts_smode{level_map},parts,x,y,t,lambda,type);
-    else
-        boxes(:,end,mode:end) = -inf;
-        return;
-    end
+% Message passing, backtracking and mode suppression for all the modes and
+% levels, natively. The suppressed mode's root score is changed by lambda;
+% the other parts' by lambda ('divmbest') or lambda*log(-log(U)) with U
+% uniform ('perturb'). The U of each mode form a column, drawn here.
+if strcmp(type, 'perturb')
+    U = rand(numparts-1,nummodes);
+else
+    U = [];
 end
+% AGR: one boxes array per mode each will hold a MAP for each level/scale
+boxes = divmbest_tree(scores,parts,pyra,thresh,nummodes,lambda,type,U);
 
 % Cache various statistics from the model data structure for later use
-function [components,filters,resp] = modelcomponents(model,pyra)
+function [components,bank] = modelcomponents(model,pyra)
 components = cell(length(model.components),1);
 for c = 1:length(model.components),
     for k = 1:length(model.components{c}),
@@ -231,98 +121,10 @@ for c = 1:length(model.components),
     end
 end
 
-resp    = cell(length(pyra.feat),1);
-filters = cell(length(model.filters),1);
-for i = 1:length(filters),
-    filters{i} = model.filters(i).w;
-end
-
-% Given a 2D array of filter scores 'child',
-% (1) Apply distance transform
-% (2) Shift by anchor position of part wrt parent
-% (3) Downsample if necessary
-function [score,Ix,Iy,Ik] = passmsg(child,parent)
-INF = 1e10;
-K   = length(child.filterid);
-Ny  = size(parent.score,1);
-Nx  = size(parent.score,2);
-[Ix0,Iy0,score0] = deal(zeros([Ny Nx K]));
-
-for k = 1:K
-    [score0(:,:,k),Ix0(:,:,k),Iy0(:,:,k)] = shiftdt(child.score(:,:,k), child.w(1,k), child.w(2,k), child.w(3,k), child.w(4,k),child.startx(k),child.starty(k),Nx,Ny,child.step);
-end
-
-% At each parent location, for each parent mixture 1:L, compute best child mixture 1:K
-L  = length(parent.filterid);
-N  = Nx*Ny;
-i0 = reshape(1:N,Ny,Nx);
-[score,Ix,Iy,Ix,Ik] = deal(zeros(Ny,Nx,L));
-for l = 1:L
-    b = child.b(1,l,:);
-    [score(:,:,l),I] = max(bsxfun(@plus,score0,b),[],3);
-    i = i0 + N*(I-1);
-    Ix(:,:,l)    = Ix0(i);
-    Iy(:,:,l)    = Iy0(i);
-    Ik(:,:,l)    = I;
-end
-
-% Backtrack through DP msgs to collect ptrs to part locations
-%function box = backtrack(x,y,mix,parts,pyra)
-function [box score_unmod] = backtrack(x,y,mix,parts,pyra,parts_unmod)
-
-numx     = length(x);
-numparts = length(parts);
-
-xptr = zeros(numx,numparts);
-yptr = zeros(numx,numparts);
-mptr = zeros(numx,numparts);
-box  = zeros(numx,4,numparts);
-
-%DB: this code assumes backtracking from a single location. Fix later
-assert(isscalar(x) == 1);
-score_unmod = 0;
-if exist('parts_unmod','var')
-    score_unmod = parts_unmod(1).score(y,x,mix);
-end
-
-for k = 1:numparts,
-    p   = parts(k);
-    if k == 1,
-        xptr(:,k) = x;
-        yptr(:,k) = y;
-        mptr(:,k) = mix;
-    else
-        % I = sub2ind(size(p.Ix),yptr(:,par),xptr(:,par),mptr(:,par));
-        par = p.parent;
-        [h,w,foo] = size(p.Ix);
-        I   = (mptr(:,par)-1)*h*w + (xptr(:,par)-1)*h + yptr(:,par);
-        xptr(:,k) = p.Ix(I);
-        yptr(:,k) = p.Iy(I);
-        mptr(:,k) = p.Ik(I);
-    end
-    scale = pyra.scale(p.level);
-    x1 = (xptr(:,k) - 1 - pyra.padx)*scale+1;
-    y1 = (yptr(:,k) - 1 - pyra.pady)*scale+1;
-    x2 = x1 + p.sizx(mptr(:,k))*scale - 1;
-    y2 = y1 + p.sizy(mptr(:,k))*scale - 1;
-    box(:,:,k) = [x1 y1 x2 y2];
-    
-    %DB: this code assumes backtracking from a single location. Fix later
-    if k>1 && exist('parts_unmod','var')
-        %keyboard
-        score_unmod = score_unmod + parts_unmod(k).score(yptr(1,k),xptr(1,k),mptr(1,k));
-        score_unmod = score_unmod ...
-            + parts_unmod(k).w(:,mptr(1,k))'*defvector(xptr(1,par),yptr(1,par),xptr(1,k),yptr(1,k),mptr(1,k),parts_unmod(k));
-        score_unmod = score_unmod + parts_unmod(k).b(1,mptr(1,par),mptr(1,k));
-    end
+% Filters packed for fconvbank, once per model if the caller did (see
+% testmodel_mmodes)
+if isfield(model,'fconvbank')
+    bank = model.fconvbank;
+else
+    bank = fconvbank({model.filters.w});
 end
-box = reshape(box,numx,4*numparts);
-
-% Compute the deformation feature given parent locations,
-% child locations, and the child part
-function res = defvector(px,py,x,y,mix,part)
-probex = ( (px-1)*part.step + part.startx(mix) );
-probey = ( (py-1)*part.step + part.starty(mix) );
-dx  = probex - x;
-dy  = probey - y;
-res = -[dx^2 dx dy^2 dy]';
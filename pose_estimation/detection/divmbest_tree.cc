@@ -0,0 +1,603 @@
+#include <math.h>
+#include <algorithm>
+#include <string.h>
+#include <vector>
+#include "mex.h"
+#ifndef _WIN32
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+/*
+ * divmbest_tree.cc
+ * DivMBest inference for the tree-structured mixtures-of-parts model.
+ * For each mode, and each active pyramid level, runs the leaf-to-root
+ * dynamic program, takes the best root configuration and
+ * backtracks from it. The best configuration over all levels is then
+ * suppressed in the unary scores of its level, before the next mode.
+ * Levels are processed in parallel.
+ *
+ * The dynamic program of each level is kept between modes, and only the
+ * mixture channels a suppression changed are recomputed: the distance
+ * transforms of the changed channels of each suppressed part, and the
+ * mixture maxima and scores of the parts on their paths to the root.
+ * Levels without a suppression keep their result.
+ *
+ * This replaces the loops of detect_fast_divmbest.m, and gives the same
+ * boxes.
+ */
+
+#define INF 1E20
+
+static inline int square(int x) { return x*x; }
+
+// lower envelope of the parabolas a(q-p)^2 + b(q-p) + src[p], 0 <= p < len,
+// as in shiftdt.cc: their roots v[0..k] and the breakpoints z[0..k+1]
+static void envelope(const double *src, int len, double a, double b, int *v, double *z) {
+  int k = 0;
+  v[0] = 0;
+  z[0] = -INF;
+  z[1] = +INF;
+  for (int q = 1; q <= len-1; q++) {
+    double s = ((src[q] - src[v[k]]) - b*(q - v[k]) + a*(square(q) - square(v[k]))) / (2*a*(q-v[k]));
+    while (s <= z[k]) {
+      k--;
+      s  = ((src[q] - src[v[k]]) - b*(q - v[k]) + a*(square(q) - square(v[k]))) / (2*a*(q-v[k]));
+    }
+    k++;
+    v[k]   = q;
+    z[k]   = s;
+    z[k+1] = +INF;
+  }
+}
+
+// A part of the model (a component of the model, after modelcomponents)
+struct part_model {
+  int parent;            // index of the parent part, -1 for the root
+  int K;                 // number of mixtures
+  const double *w;       // 4 x K deformation weights
+  const double *startx;  // anchor of each mixture
+  const double *starty;
+  double step;
+  const double *b;       // 1 x L x K biases, L being the parent's mixtures
+  int nb;                // number of biases (the root has one)
+  const double *sizx;    // filter size of each mixture
+  const double *sizy;
+  int scale;             // pyramid octave of the part, relative to the root
+};
+
+// A pyramid level, with the state that persists across modes
+struct level_data {
+  bool active;
+  std::vector<const double *> score;  // unary scores of each part
+  std::vector<int> sizy, sizx;        // size of each part's score map
+  std::vector<double> boxscale;       // pyra.scale of each part's level
+
+  // suppressed configurations: changes to the unary scores, in order
+  std::vector<int> mod_part;
+  std::vector<int> mod_index;
+  std::vector<double> mod_delta;
+
+  // the dynamic program, with offsets of each part's arrays
+  std::vector<int> soff, moff, poff;
+  std::vector<double> S;      // scores of each part, with the messages of its children
+  std::vector<double> M;      // distance transform of each mixture of each child
+  std::vector<int> MIx, MIy;
+  std::vector<double> msg;    // message of each child to its parent
+  std::vector<int> Ix, Iy, Ik;  // argmax pointers of each child
+  std::vector<char> dirty;    // mixture channels of each part to recompute
+  bool changed;
+
+  // result of the current mode
+  bool found;
+  double rscore;       // best score, with the suppressions
+  double score_unmod;  // score of the same configuration, without them
+  std::vector<int> xptr, yptr, mptr;  // configuration (1-based)
+};
+
+// Scratch buffers of the distance transforms
+struct workspace {
+  std::vector<double> tmpM;  // first pass, transposed
+  std::vector<int> tmpIy;
+  std::vector<int> v;
+  std::vector<double> z;
+};
+
+struct engine {
+  int numparts;
+  std::vector<part_model> parts;
+  std::vector<std::vector<int> > children;  // of each part, last first
+  std::vector<int> mixoff;  // first mixture channel of each part
+  std::vector<level_data> levels;
+  double padx, pady;
+};
+
+// Distance transform of one mixture of a child's scores, shifted and
+// subsampled onto its parent's grid, as shiftdt.cc
+static void shiftdt(workspace &ws, const double *vals, int sizy, int sizx, const part_model &p, int k, int leny, int lenx, double *M, int *Ix, int *Iy) {
+  double ax = -p.w[4*k];
+  double bx = -p.w[4*k+1];
+  double ay = -p.w[4*k+2];
+  double by = -p.w[4*k+3];
+  int offx = (int)p.startx[k]-1;
+  int offy = (int)p.starty[k]-1;
+  int step = (int)p.step;
+  double *tmpM = &ws.tmpM[0];
+  int *tmpIy = &ws.tmpIy[0];
+  int *v = &ws.v[0];
+  double *z = &ws.z[0];
+
+  // along each column
+  for (int x = 0; x < sizx; x++) {
+    const double *src = vals + x*sizy;
+    envelope(src, sizy, ay, by, v, z);
+    int k = 0;
+    int q = offy;
+    for (int i = 0; i < leny; i++, q += step) {
+      while (z[k+1] < q)
+	k++;
+      tmpM[i*sizx+x] = ay*square(q-v[k]) + by*(q-v[k]) + src[v[k]];
+      tmpIy[i*sizx+x] = v[k];
+    }
+  }
+
+  // along each row of the result, with the argmins (1-based)
+  for (int y = 0; y < leny; y++) {
+    const double *src = tmpM + y*sizx;
+    envelope(src, sizx, ax, bx, v, z);
+    int k = 0;
+    int q = offx;
+    for (int i = 0; i < lenx; i++, q += step) {
+      while (z[k+1] < q)
+	k++;
+      int j = i*leny+y;
+      M[j] = ax*square(q-v[k]) + bx*(q-v[k]) + src[v[k]];
+      Ix[j] = v[k]+1;
+      Iy[j] = tmpIy[y*sizx+v[k]]+1;
+    }
+  }
+}
+
+// Allocates the dynamic program of a level, with every channel to compute
+static void init_level(const engine &eng, level_data &lev) {
+  int numparts = eng.numparts;
+  lev.soff.assign(numparts+1, 0);
+  lev.moff.assign(numparts+1, 0);
+  lev.poff.assign(numparts+1, 0);
+  for (int k = 0; k < numparts; k++) {
+    const part_model &p = eng.parts[k];
+    lev.soff[k+1] = lev.soff[k] + lev.sizy[k]*lev.sizx[k]*p.K;
+    int N = 0;
+    if (p.parent >= 0)
+      N = lev.sizy[p.parent]*lev.sizx[p.parent];
+    lev.moff[k+1] = lev.moff[k] + N*p.K;
+    lev.poff[k+1] = lev.poff[k] + (N ? N*eng.parts[p.parent].K : 0);
+  }
+  lev.S.resize(lev.soff[numparts]);
+  lev.M.resize(lev.moff[numparts]);
+  lev.MIx.resize(lev.moff[numparts]);
+  lev.MIy.resize(lev.moff[numparts]);
+  lev.msg.resize(lev.poff[numparts]);
+  lev.Ix.resize(lev.poff[numparts]);
+  lev.Iy.resize(lev.poff[numparts]);
+  lev.Ik.resize(lev.poff[numparts]);
+  lev.dirty.assign(eng.mixoff[numparts], 1);
+  lev.changed = true;
+}
+
+// Frees the dynamic program of a level that is no longer searched
+static void free_level(level_data &lev) {
+  std::vector<double>().swap(lev.S);
+  std::vector<double>().swap(lev.M);
+  std::vector<int>().swap(lev.MIx);
+  std::vector<int>().swap(lev.MIy);
+  std::vector<double>().swap(lev.msg);
+  std::vector<int>().swap(lev.Ix);
+  std::vector<int>().swap(lev.Iy);
+  std::vector<int>().swap(lev.Ik);
+}
+
+// Recomputes mixture channel t of part k's scores: its unary scores, with
+// the suppressed configurations, plus the messages of its children, in the
+// order of the full dynamic program
+static void part_scores(const engine &eng, level_data &lev, int k, int t) {
+  int n = lev.sizy[k]*lev.sizx[k];
+  double *S = &lev.S[lev.soff[k] + t*n];
+  memcpy(S, lev.score[k] + t*n, n*sizeof(double));
+  for (size_t i = 0; i < lev.mod_part.size(); i++) {
+    if (lev.mod_part[i] == k && lev.mod_index[i] / n == t)
+      S[lev.mod_index[i] - t*n] += lev.mod_delta[i];
+  }
+  const std::vector<int> &ch = eng.children[k];
+  for (size_t c = 0; c < ch.size(); c++) {
+    const double *msg = &lev.msg[lev.poff[ch[c]] + t*n];
+    for (int i = 0; i < n; i++)
+      S[i] += msg[i];
+  }
+}
+
+// Runs the dynamic program at a level, on the channels marked dirty, finds
+// its best configuration and backtracks from it
+static void process_level(const engine &eng, level_data &lev, workspace &ws) {
+  int numparts = eng.numparts;
+  int maxlen = 0;
+  for (int k = 1; k < numparts; k++) {
+    int par = eng.parts[k].parent;
+    maxlen = std::max(maxlen, lev.sizx[k]*lev.sizy[par]);
+    maxlen = std::max(maxlen, std::max(lev.sizx[k], lev.sizy[k])+1);
+  }
+  ws.tmpM.resize(maxlen);
+  ws.tmpIy.resize(maxlen);
+  ws.v.resize(maxlen);
+  ws.z.resize(maxlen+1);
+
+  // walk from leaves to root of tree, passing message to parent
+  for (int k = numparts-1; k >= 1; k--) {
+    const part_model &p = eng.parts[k];
+    char *dirty = &lev.dirty[eng.mixoff[k]];
+    bool any = false;
+    for (int kk = 0; kk < p.K; kk++)
+      any = any || dirty[kk];
+    if (!any)
+      continue;
+
+    int par = p.parent;
+    int K = p.K;
+    int L = eng.parts[par].K;
+    int Ny = lev.sizy[par];
+    int Nx = lev.sizx[par];
+    int N = Nx*Ny;
+    int sy = lev.sizy[k];
+    int sx = lev.sizx[k];
+    double *M = &lev.M[lev.moff[k]];
+    int *MIx = &lev.MIx[lev.moff[k]];
+    int *MIy = &lev.MIy[lev.moff[k]];
+    for (int kk = 0; kk < K; kk++) {
+      if (!dirty[kk])
+	continue;
+      part_scores(eng, lev, k, kk);
+      shiftdt(ws, &lev.S[lev.soff[k] + kk*sy*sx], sy, sx, p, kk, Ny, Nx, M+kk*N, MIx+kk*N, MIy+kk*N);
+      dirty[kk] = 0;
+    }
+
+    // at each parent location, for each parent mixture, the best child
+    // mixture. This changes every channel of the parent.
+    double *msg = &lev.msg[lev.poff[k]];
+    int *Ix = &lev.Ix[lev.poff[k]];
+    int *Iy = &lev.Iy[lev.poff[k]];
+    int *Ik = &lev.Ik[lev.poff[k]];
+    for (int l = 0; l < L; l++) {
+      const double *b = p.b + l;
+      for (int i = 0; i < N; i++) {
+	double best = M[i] + b[0];
+	int I = 0;
+	for (int kk = 1; kk < K; kk++) {
+	  double val = M[kk*N+i] + b[kk*L];
+	  if (val > best) {
+	    best = val;
+	    I = kk;
+	  }
+	}
+	msg[l*N+i] = best;
+	Ix[l*N+i] = MIx[I*N+i];
+	Iy[l*N+i] = MIy[I*N+i];
+	Ik[l*N+i] = I+1;
+      }
+    }
+    for (int l = 0; l < L; l++)
+      lev.dirty[eng.mixoff[par] + l] = 1;
+  }
+
+  // add bias to root score, and take the best root configuration (the
+  // first in x, then y, then mixture order, as max in MATLAB)
+  const part_model &root = eng.parts[0];
+  int Ny = lev.sizy[0];
+  int Nx = lev.sizx[0];
+  int N = Nx*Ny;
+  double *rscore = &lev.S[0];
+  for (int t = 0; t < root.K; t++) {
+    if (!lev.dirty[t])
+      continue;
+    part_scores(eng, lev, 0, t);
+    double b = root.b[root.nb > 1 ? t : 0];
+    for (int i = 0; i < N; i++)
+      rscore[t*N+i] += b;
+    lev.dirty[t] = 0;
+  }
+  lev.changed = false;
+  double best = -HUGE_VAL;
+  int bx = 0, by = 0, bt = 0;
+  for (int x = 0; x < Nx; x++) {
+    for (int y = 0; y < Ny; y++) {
+      for (int t = 0; t < root.K; t++) {
+	if (rscore[t*N+x*Ny+y] > best) {
+	  best = rscore[t*N+x*Ny+y];
+	  bx = x;
+	  by = y;
+	  bt = t;
+	}
+      }
+    }
+  }
+  lev.found = best > -HUGE_VAL;
+  lev.rscore = best;
+  if (!lev.found)
+    return;
+
+  // backtrack through DP msgs to collect ptrs to part locations, and sum
+  // the unmodified score of the configuration
+  lev.xptr[0] = bx+1;
+  lev.yptr[0] = by+1;
+  lev.mptr[0] = bt+1;
+  double score = lev.score[0][bt*N+bx*Ny+by] + root.b[root.nb > 1 ? bt : 0];
+  for (int k = 1; k < numparts; k++) {
+    const part_model &p = eng.parts[k];
+    int par = p.parent;
+    int hy = lev.sizy[par];
+    int I = ((lev.mptr[par]-1)*lev.sizx[par] + lev.xptr[par]-1)*hy + lev.yptr[par]-1;
+    int x = lev.Ix[lev.poff[k]+I];
+    int y = lev.Iy[lev.poff[k]+I];
+    int m = lev.Ik[lev.poff[k]+I];
+    lev.xptr[k] = x;
+    lev.yptr[k] = y;
+    lev.mptr[k] = m;
+
+    // unary, deformation (see defvector) and bias
+    int sy = lev.sizy[k];
+    int sx = lev.sizx[k];
+    score = score + lev.score[k][(m-1)*sy*sx + (x-1)*sy + y-1];
+    double dx = (lev.xptr[par]-1)*p.step + p.startx[m-1] - x;
+    double dy = (lev.yptr[par]-1)*p.step + p.starty[m-1] - y;
+    const double *w = &p.w[4*(m-1)];
+    score = score + (w[0]*-(dx*dx) + w[1]*-dx + w[2]*-(dy*dy) + w[3]*-dy);
+    score = score + p.b[(lev.mptr[par]-1) + eng.parts[par].K*(m-1)];
+  }
+  lev.score_unmod = score;
+}
+
+// Levels of the current mode, handed out to the threads
+struct level_queue {
+  engine *eng;
+  std::vector<int> todo;
+  int next;
+#ifndef _WIN32
+  pthread_mutex_t lock;
+#endif
+};
+
+static void *process_levels(void *arg) {
+  level_queue *q = (level_queue *)arg;
+  workspace ws;
+  for (;;) {
+    int i;
+#ifndef _WIN32
+    pthread_mutex_lock(&q->lock);
+#endif
+    i = q->next++;
+#ifndef _WIN32
+    pthread_mutex_unlock(&q->lock);
+#endif
+    if (i >= (int)q->todo.size())
+      break;
+    process_level(*q->eng, q->eng->levels[q->todo[i]], ws);
+  }
+  return NULL;
+}
+
+static void run_levels(engine &eng, int num_threads) {
+  level_queue q;
+  q.eng = &eng;
+  q.next = 0;
+  for (int l = 0; l < (int)eng.levels.size(); l++) {
+    if (eng.levels[l].active && eng.levels[l].changed)
+      q.todo.push_back(l);
+  }
+  if (num_threads > (int)q.todo.size())
+    num_threads = q.todo.size();
+#ifndef _WIN32
+  pthread_mutex_init(&q.lock, NULL);
+  if (num_threads > 1) {
+    // if a thread cannot be created, the calling thread takes its place
+    // in draining the queue, while the threads that started run
+    std::vector<pthread_t> ts(num_threads);
+    int started = 0;
+    while (started < num_threads && !pthread_create(&ts[started], NULL, process_levels, (void *)&q))
+      started++;
+    if (started < num_threads)
+      process_levels((void *)&q);
+    for (int t = 0; t < started; t++)
+      pthread_join(ts[t], NULL);
+  } else
+#endif
+  process_levels((void *)&q);
+#ifndef _WIN32
+  pthread_mutex_destroy(&q.lock);
+#endif
+}
+
+static double *field(const mxArray *s, int i, const char *name, int n) {
+  const mxArray *f = mxGetField(s, i, name);
+  if (f == NULL || mxGetClassID(f) != mxDOUBLE_CLASS || (int)mxGetNumberOfElements(f) < n)
+    mexErrMsgTxt("Invalid part in model");
+  return mxGetPr(f);
+}
+
+// matlab entry point
+// boxes = divmbest_tree(scores, parts, pyra, thresh, nummodes, lambda, type, U)
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+  if (nrhs != 8)
+    mexErrMsgTxt("Wrong number of inputs");
+  if (nlhs != 1)
+    mexErrMsgTxt("Wrong number of outputs");
+  if (!mxIsCell(prhs[0]) || !mxIsStruct(prhs[1]) || !mxIsStruct(prhs[2]))
+    mexErrMsgTxt("Invalid input");
+
+  engine eng;
+  const mxArray *mxparts = prhs[1];
+  int numparts = mxGetNumberOfElements(mxparts);
+  int numlevels = mxGetNumberOfElements(prhs[0]);
+  const mxArray *mxscale = mxGetField(prhs[2], 0, "scale");
+  if (mxscale == NULL || (int)mxGetNumberOfElements(mxscale) < numlevels)
+    mexErrMsgTxt("Invalid pyramid");
+  const double *pyrascale = mxGetPr(mxscale);
+  int interval = (int)*field(prhs[2], 0, "interval", 1);
+  eng.numparts = numparts;
+  eng.padx = *field(prhs[2], 0, "padx", 1);
+  eng.pady = *field(prhs[2], 0, "pady", 1);
+  double thresh = mxGetScalar(prhs[3]);
+  int nummodes = (int)mxGetScalar(prhs[4]);
+  double lambda = mxGetScalar(prhs[5]);
+  char type[32];
+  mxGetString(prhs[6], type, sizeof(type));
+  bool perturb = !strcmp(type, "perturb");
+  bool divmbest = !strcmp(type, "divmbest");
+  const double *U = mxGetPr(prhs[7]);
+  if (perturb && ((int)mxGetM(prhs[7]) != numparts-1 || (int)mxGetN(prhs[7]) < nummodes))
+    mexErrMsgTxt("U must be (numparts-1) x nummodes for perturb");
+
+  // read in the parts
+  eng.parts.resize(numparts);
+  for (int k = 0; k < numparts; k++) {
+    part_model &p = eng.parts[k];
+    p.parent = (int)*field(mxparts, k, "parent", 1) - 1;
+    if ((k == 0) != (p.parent < 0) || p.parent >= k)
+      mexErrMsgTxt("Parts must be in tree order, with the root first");
+    if (mxGetField(mxparts, k, "sizx") == NULL)
+      mexErrMsgTxt("Invalid part in model");
+    p.K = mxGetNumberOfElements(mxGetField(mxparts, k, "sizx"));
+    p.w = field(mxparts, k, "w", 4*p.K);
+    p.startx = field(mxparts, k, "startx", p.K);
+    p.starty = field(mxparts, k, "starty", p.K);
+    p.step = *field(mxparts, k, "step", 1);
+    if (p.step != (int)p.step)
+      mexErrMsgTxt("Part step must be an integer");
+    p.nb = k ? eng.parts[p.parent].K*p.K : 1;
+    p.b = field(mxparts, k, "b", p.nb);
+    if (k == 0 && (int)mxGetNumberOfElements(mxGetField(mxparts, k, "b")) == p.K)
+      p.nb = p.K;
+    p.sizx = field(mxparts, k, "sizx", p.K);
+    p.sizy = field(mxparts, k, "sizy", p.K);
+    p.scale = (int)*field(mxparts, k, "scale", 1);
+  }
+  if (numparts < 1)
+    mexErrMsgTxt("Invalid input");
+  eng.children.resize(numparts);
+  eng.mixoff.assign(numparts+1, 0);
+  for (int k = numparts-1; k >= 0; k--) {
+    if (k)
+      eng.children[eng.parts[k].parent].push_back(k);
+  }
+  for (int k = 0; k < numparts; k++)
+    eng.mixoff[k+1] = eng.mixoff[k] + eng.parts[k].K;
+
+  // read in the score maps of the levels to process
+  eng.levels.resize(numlevels);
+  for (int l = 0; l < numlevels; l++) {
+    level_data &lev = eng.levels[l];
+    const mxArray *c = mxGetCell(prhs[0], l);
+    lev.active = c != NULL && !mxIsEmpty(c);
+    if (!lev.active)
+      continue;
+    if (!mxIsCell(c) || (int)mxGetNumberOfElements(c) != numparts)
+      mexErrMsgTxt("scores must hold a cell of score maps per part for each level");
+    lev.score.resize(numparts);
+    lev.sizy.resize(numparts);
+    lev.sizx.resize(numparts);
+    lev.boxscale.resize(numparts);
+    lev.xptr.resize(numparts);
+    lev.yptr.resize(numparts);
+    lev.mptr.resize(numparts);
+    for (int k = 0; k < numparts; k++) {
+      const mxArray *s = mxGetCell(c, k);
+      if (s == NULL || mxGetClassID(s) != mxDOUBLE_CLASS)
+	mexErrMsgTxt("Invalid score map");
+      const mwSize *dims = mxGetDimensions(s);
+      int K = mxGetNumberOfDimensions(s) > 2 ? dims[2] : 1;
+      if (K != eng.parts[k].K || mxGetNumberOfDimensions(s) > 3)
+	mexErrMsgTxt("Score map should have one channel per mixture");
+      lev.score[k] = mxGetPr(s);
+      lev.sizy[k] = dims[0];
+      lev.sizx[k] = dims[1];
+      int level = l - eng.parts[k].scale*interval;
+      if (level < 0)
+	mexErrMsgTxt("Invalid part scale");
+      lev.boxscale[k] = pyrascale[level];
+    }
+    init_level(eng, lev);
+  }
+
+  // boxes: for each mode, the best configuration of each level
+  int rowsize = 4*numparts+2;
+  mwSize dims[3] = {(mwSize)numlevels, (mwSize)rowsize, (mwSize)nummodes};
+  plhs[0] = mxCreateNumericArray(3, dims, mxDOUBLE_CLASS, mxREAL);
+  double *boxes = mxGetPr(plhs[0]);
+  for (int m = 0; m < nummodes; m++) {
+    for (int l = 0; l < numlevels; l++)
+      boxes[l + numlevels*(rowsize-1 + rowsize*m)] = -HUGE_VAL;
+  }
+
+  int num_threads = 1;
+#ifndef _WIN32
+  num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  for (int m = 0; m < nummodes; m++) {
+    run_levels(eng, num_threads);
+
+    // write the boxes of each level, and find the best
+    double *out = boxes + numlevels*rowsize*m;
+    int level_map = -1;
+    double score_map = -HUGE_VAL;
+    for (int l = 0; l < numlevels; l++) {
+      level_data &lev = eng.levels[l];
+      if (!lev.active)
+	continue;
+      // the first mode is scored with the dynamic program, the others
+      // without the suppressions
+      double score = m ? lev.score_unmod : lev.rscore;
+      if (!lev.found || !(score >= thresh)) {
+	lev.active = false;
+	free_level(lev);
+	continue;
+      }
+      for (int k = 0; k < numparts; k++) {
+	const part_model &p = eng.parts[k];
+	double scale = lev.boxscale[k];
+	int mix = lev.mptr[k]-1;
+	double x1 = (lev.xptr[k] - 1 - eng.padx)*scale+1;
+	double y1 = (lev.yptr[k] - 1 - eng.pady)*scale+1;
+	out[l + numlevels*(4*k)] = x1;
+	out[l + numlevels*(4*k+1)] = y1;
+	out[l + numlevels*(4*k+2)] = x1 + p.sizx[mix]*scale - 1;
+	out[l + numlevels*(4*k+3)] = y1 + p.sizy[mix]*scale - 1;
+      }
+      out[l + numlevels*(rowsize-2)] = 1;
+      out[l + numlevels*(rowsize-1)] = score;
+      if (score > score_map) {
+	score_map = score;
+	level_map = l;
+      }
+    }
+    if (level_map < 0)
+      break;
+
+    // suppress (overall) map: the root by lambda, the other parts by lambda
+    // (divmbest) or lambda*log(-log(U)) (perturb)
+    level_data &lev = eng.levels[level_map];
+    for (int k = 0; k < numparts; k++) {
+      double delta;
+      if (k == 0)
+	delta = lambda;
+      else if (perturb)
+	delta = lambda*log(-log(U[(numparts-1)*m + k-1]));
+      else if (divmbest)
+	delta = lambda;
+      else
+	continue;
+      lev.mod_part.push_back(k);
+      lev.mod_index.push_back(((lev.mptr[k]-1)*lev.sizx[k] + lev.xptr[k]-1)*lev.sizy[k] + lev.yptr[k]-1);
+      lev.mod_delta.push_back(delta);
+      lev.dirty[eng.mixoff[k] + lev.mptr[k]-1] = 1;
+    }
+    lev.changed = true;
+  }
+}
@@ -28,6 +28,10 @@ if(exist([ cachedir type '_' name '_boxes_' num2str(nummodes) '_' num2str(lambda
     load([ cachedir type '_' name '_boxes_' num2str(nummodes) '_' num2str(lambda) '_' suffix '.mat']);
 else
     boxes = cell(1,length(test));
+    % pack the filters once for all the images
+    if ~isfield(model,'fconvbank')
+        model.fconvbank = fconvbank({model.filters.w});
+    end
     parfor i = 1:length(test)
         fprintf([name ': testing: %d/%d\n'],i,length(test));
         im = imread(test(i).im);
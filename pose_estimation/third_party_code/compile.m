@@ -28,5 +28,10 @@ mex -O reduce.cc
 mex -O dt.cc
 mex -O shiftdt.cc
 mex -O features.cc
+mex -O featpyr.cc
+mex -O fconvbank.cc
+
+% DivMBest inference for the tree model
+mex -O ../../detection/divmbest_tree.cc -outdir ../../detection
 
 cd ..;
@@ -1,111 +1,217 @@
 #define INF 1E20
 #include <math.h>
 #include <sys/types.h>
-#include "mex.h"
 #include <stdint.h>
+#include <vector>
+#include "mex.h"
+#ifndef _WIN32
+#include <pthread.h>
+#include <unistd.h>
+#endif
 
 /*
  * Generalized distance transforms based on Felzenswalb and Huttenlocher.
  * This computes output values on a shifted grid of length "end", 
  * shifted to start at index "start"
  * This is useful for computing shifted messages
+ *
+ * vals may hold the K mixture channels of a part (sizy x sizx x K), with
+ * the deformation and offset arguments given per channel (or once for
+ * all); M, Ix and Iy are then Ny x Nx x K. The envelope of each line
+ * is built in scratch buffers reused for every line, the first pass is
+ * stored transposed so that both passes read contiguous lines, and Iy is
+ * looked up through Ix as each output is written. Channels are spread
+ * over threads when there is enough work.
  */
 
 static inline int square(int x) { return x*x; }
 
-void dt1d(double *src, double *dst, int *ptr, int step, int n, double a, double b, int start, int end, int delta) {
-  int   *v = new int[n];
-  float *z = new float[n+1];
+// scratch buffers of the transform, reused for every line and channel
+struct dt_scratch {
+  std::vector<int> v;
+  std::vector<double> z;
+  std::vector<double> tmpM;  // first pass, leny x sizx, transposed
+  std::vector<int> tmpIy;
+};
+
+// lower envelope of the parabolas a(q-p)^2 + b(q-p) + src[p], 0 <= p < len:
+// their roots v[0..k] and the breakpoints z[0..k+1] between them
+static void envelope(const double *src, int len, double a, double b, int *v, double *z) {
   int k = 0;
-  int q = 0;
   v[0] = 0;
   z[0] = -INF;
   z[1] = +INF;
-  for (q = 1; q <= n-1; q++) {
-    float s = ((src[q*step] - src[v[k]*step]) - b*(q - v[k]) + a*(square(q) - square(v[k]))) / (2*a*(q-v[k]));
+  for (int q = 1; q <= len-1; q++) {
+    double s = ((src[q] - src[v[k]]) - b*(q - v[k]) + a*(square(q) - square(v[k]))) / (2*a*(q-v[k]));
     while (s <= z[k]) {
-      // Update pointer
       k--;
-      s  = ((src[q*step] - src[v[k]*step]) - b*(q - v[k]) + a*(square(q) - square(v[k]))) / (2*a*(q-v[k]));
+      s  = ((src[q] - src[v[k]]) - b*(q - v[k]) + a*(square(q) - square(v[k]))) / (2*a*(q-v[k]));
     }
     k++;
     v[k]   = q;
     z[k]   = s;
     z[k+1] = +INF;
   }
+}
+
+// distance transform of one channel, with 1-based argmins
+static void dt(const double *vals, int sizy, int sizx, double ax, double bx, double ay, double by,
+		    int offx, int offy, int lenx, int leny, int step,
+		    double *M, int32_t *Ix, int32_t *Iy, dt_scratch &ws) {
+  int len = sizy > sizx ? sizy : sizx;
+  ws.v.resize(len);
+  ws.z.resize(len+1);
+  ws.tmpM.resize(leny*sizx);
+  ws.tmpIy.resize(leny*sizx);
+  int *v = &ws.v[0];
+  double *z = &ws.z[0];
+  double *tmpM = &ws.tmpM[0];
+  int *tmpIy = &ws.tmpIy[0];
 
-   k = 0;
-   q = start;
-   for (int i=0; i <= end-1; i++) {
-     while (z[k+1] < q)
-       k++;
-     dst[i*step] = a*square(q-v[k]) + b*(q-v[k]) + src[v[k]*step];
-     ptr[i*step] = v[k];
-     q+=delta;
+  // along each column
+  for (int x = 0; x < sizx; x++) {
+    const double *src = vals + x*sizy;
+    envelope(src, sizy, ay, by, v, z);
+    int k = 0;
+    int q = offy;
+    for (int i = 0; i < leny; i++, q += step) {
+      while (z[k+1] < q)
+	k++;
+      tmpM[i*sizx+x] = ay*square(q-v[k]) + by*(q-v[k]) + src[v[k]];
+      tmpIy[i*sizx+x] = v[k];
+    }
   }
 
-  delete [] v;
-  delete [] z;
+  // along each row of the result
+  for (int y = 0; y < leny; y++) {
+    const double *src = tmpM + y*sizx;
+    envelope(src, sizx, ax, bx, v, z);
+    int k = 0;
+    int q = offx;
+    for (int i = 0; i < lenx; i++, q += step) {
+      while (z[k+1] < q)
+	k++;
+      int p = i*leny+y;
+      M[p] = ax*square(q-v[k]) + bx*(q-v[k]) + src[v[k]];
+      Ix[p] = v[k]+1;
+      Iy[p] = tmpIy[y*sizx+v[k]]+1;
+    }
+  }
 }
 
+// the channels, and the thread that computes each
+struct dt_job {
+  const double *vals;
+  double *M;
+  int32_t *Ix, *Iy;
+  const double *ax, *bx, *ay, *by, *offx, *offy;
+  int na, noff;  // number of deformations and offsets given (1 or K)
+  int sizy, sizx, lenx, leny, step, K;
+  int thread, num_threads;
+};
 
+static void *process(void *arg) {
+  dt_job *job = (dt_job *)arg;
+  dt_scratch ws;
+  int sin = job->sizy*job->sizx;
+  int sout = job->leny*job->lenx;
+  for (int c = job->thread; c < job->K; c += job->num_threads) {
+    int a = job->na > 1 ? c : 0;
+    int o = job->noff > 1 ? c : 0;
+    // negating the deformation coefficients to define a cost, and
+    // fixing MATLAB 0-1 indexing of the offsets
+    dt(job->vals + c*sin, job->sizy, job->sizx,
+	    -job->ax[a], -job->bx[a], -job->ay[a], -job->by[a],
+	    (int)job->offx[o]-1, (int)job->offy[o]-1, job->lenx, job->leny, job->step,
+	    job->M + c*sout, job->Ix + c*sout, job->Iy + c*sout, ws);
+  }
+  return NULL;
+}
+
+static const double *coefs(const mxArray *mx, int K, int &n) {
+  n = mxGetNumberOfElements(mx);
+  if (mxGetClassID(mx) != mxDOUBLE_CLASS || (n != 1 && n != K))
+    mexErrMsgTxt("Invalid input");
+  return mxGetPr(mx);
+}
 
 // matlab entry point
-// [M, Ix, Iy] = dt(vals, ax, bx, ay, by)
-void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) { 
+// [M, Ix, Iy] = dt(vals, ax, bx, ay, by, offx, offy, Nx, Ny, step)
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
   if (nrhs != 10)
-    mexErrMsgTxt("Wrong number of inputs"); 
+    mexErrMsgTxt("Wrong number of inputs");
   if (nlhs != 3)
     mexErrMsgTxt("Wrong number of outputs");
-  if (mxGetClassID(prhs[0]) != mxDOUBLE_CLASS)
+  if (mxGetClassID(prhs[0]) != mxDOUBLE_CLASS || mxGetNumberOfDimensions(prhs[0]) > 3)
     mexErrMsgTxt("Invalid input");
 
-  // Read in deformation coefficients, negating to define a cost
-  // Read in offsets for output grid, fixing MATLAB 0-1 indexing
-  const int *dims = mxGetDimensions(prhs[0]);
-  double *vals = (double *)mxGetPr(prhs[0]);
-  double ax = -mxGetScalar(prhs[1]);
-  double bx = -mxGetScalar(prhs[2]);
-  double ay = -mxGetScalar(prhs[3]);
-  double by = -mxGetScalar(prhs[4]);
-  int offx = (int)mxGetScalar(prhs[5])-1;
-  int offy = (int)mxGetScalar(prhs[6])-1;
-  int Nx   = (int)mxGetScalar(prhs[7]);
-  int Ny   = (int)mxGetScalar(prhs[8]);
-  int step = (int)mxGetScalar(prhs[9]);
-
-  mxArray  *mxM = mxCreateNumericMatrix(Ny,Nx,mxDOUBLE_CLASS, mxREAL);
-  mxArray *mxIx = mxCreateNumericMatrix(Ny,Nx,mxINT32_CLASS, mxREAL);
-  mxArray *mxIy = mxCreateNumericMatrix(Ny,Nx,mxINT32_CLASS, mxREAL);
-  double   *M = (double *)mxGetPr(mxM);
-  int32_t *Ix = (int32_t *)mxGetPr(mxIx);
-  int32_t *Iy = (int32_t *)mxGetPr(mxIy);
-
-  double   *tmpM =  (double *)mxCalloc(Ny*dims[1], sizeof(double));
-  int32_t *tmpIx = (int32_t *)mxCalloc(Ny*dims[1], sizeof(int32_t));
-  int32_t *tmpIy = (int32_t *)mxCalloc(Ny*dims[1], sizeof(int32_t));
-
-  // printf("(%g,%g),(%g,%g)(%d,%d)\n",offx,offy,Nx,Ny,dims[1],dims[0]);
+  const mwSize *dims = mxGetDimensions(prhs[0]);
+  dt_job job;
+  job.vals = mxGetPr(prhs[0]);
+  job.sizy = dims[0];
+  job.sizx = dims[1];
+  job.K = mxGetNumberOfDimensions(prhs[0]) == 3 ? dims[2] : 1;
+  int n[6];
+  job.ax = coefs(prhs[1], job.K, n[0]);
+  job.bx = coefs(prhs[2], job.K, n[1]);
+  job.ay = coefs(prhs[3], job.K, n[2]);
+  job.by = coefs(prhs[4], job.K, n[3]);
+  job.offx = coefs(prhs[5], job.K, n[4]);
+  job.offy = coefs(prhs[6], job.K, n[5]);
+  if (n[0] != n[1] || n[0] != n[2] || n[0] != n[3] || n[4] != n[5])
+    mexErrMsgTxt("Invalid input");
+  job.na = n[0];
+  job.noff = n[4];
+  job.lenx = (int)mxGetScalar(prhs[7]);
+  job.leny = (int)mxGetScalar(prhs[8]);
+  job.step = (int)mxGetScalar(prhs[9]);
+  if (job.sizy < 1 || job.sizx < 1 || job.lenx < 0 || job.leny < 0)
+    mexErrMsgTxt("Invalid input");
 
-  for (int x = 0; x < dims[1]; x++)
-    dt1d(vals+x*dims[0], tmpM+x*dims[0], tmpIy+x*dims[0], 1, dims[0], ay, by, offy, Ny, step);
-  
-  for (int y = 0; y < dims[0]; y++)
-    dt1d(tmpM+y, M+y, tmpIx+y, dims[0], dims[1], ax, bx, offx, Nx, step);
+  mwSize odims[3] = {(mwSize)job.leny, (mwSize)job.lenx, (mwSize)job.K};
+  int ndims = job.K > 1 ? 3 : 2;
+  mxArray  *mxM = mxCreateNumericArray(ndims, odims, mxDOUBLE_CLASS, mxREAL);
+  mxArray *mxIx = mxCreateNumericArray(ndims, odims, mxINT32_CLASS, mxREAL);
+  mxArray *mxIy = mxCreateNumericArray(ndims, odims, mxINT32_CLASS, mxREAL);
+  job.M = (double *)mxGetPr(mxM);
+  job.Ix = (int32_t *)mxGetData(mxIx);
+  job.Iy = (int32_t *)mxGetData(mxIy);
 
-  // get argmins and adjust for matlab indexing from 1
-  for (int x = 0; x < Nx; x++) {
-    for (int y = 0; y < Ny; y++) {
-      int p = x*dims[0]+y;
-      Ix[p] = tmpIx[p]+1;
-      Iy[p] = tmpIy[tmpIx[p]*dims[0]+y]+1;
+  // threads over the channels, for large transforms only
+  int num_threads = 1;
+#ifndef _WIN32
+  double work = (double)job.K * (job.sizy*job.sizx + job.leny*job.sizx + job.leny*job.lenx);
+  if (job.K > 1 && work > 1e6) {
+    num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_threads > job.K)
+      num_threads = job.K;
+  }
+  if (num_threads > 1) {
+    std::vector<dt_job> jobs(num_threads, job);
+    std::vector<pthread_t> ts(num_threads);
+    // the channels of any thread that could not be created are
+    // computed here, while the threads that started run
+    int started = 0;
+    for (int t = 0; t < num_threads; t++) {
+      jobs[t].thread = t;
+      jobs[t].num_threads = num_threads;
+      if (started == t && !pthread_create(&ts[t], NULL, process, (void *)&jobs[t]))
+	started++;
     }
+    for (int t = started; t < num_threads; t++)
+      process((void *)&jobs[t]);
+    for (int t = 0; t < started; t++)
+      pthread_join(ts[t], NULL);
+  } else
+#endif
+  {
+    job.thread = 0;
+    job.num_threads = 1;
+    process((void *)&job);
   }
 
-  mxFree(tmpM);
-  mxFree(tmpIx);
-  mxFree(tmpIy);
   plhs[0] = mxM;
   plhs[1] = mxIx;
   plhs[2] = mxIy;
+  return;
 }
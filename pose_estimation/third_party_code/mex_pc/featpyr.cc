@@ -0,0 +1,686 @@
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "mex.h"
+
+#define	round(x)	((x-floor(x))>0.5 ? ceil(x) : floor(x))
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define USE_SSE
+#endif
+#ifndef _WIN32
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Feature pyramid.
+ * Computes all the levels of featpyramid.m in one call: the resized and
+ * reduced images, their HOG features (as features.cc), and the padding
+ * with the boundary occlusion feature. The images and features are
+ * computed in single precision, with SSE2 for the gradients, the
+ * orientation binning and the block normalization. The resize/reduce
+ * chain of each octave, then the features of each level, are spread
+ * over a pool of threads.
+ */
+
+// small value, used to avoid division by zero
+#define eps 0.0001f
+
+// unit vectors used to compute gradient orientation
+static const float uu[9] = {1.0000f,
+			    0.9397f,
+			    0.7660f,
+			    0.500f,
+			    0.1736f,
+			    -0.1736f,
+			    -0.5000f,
+			    -0.7660f,
+			    -0.9397f};
+static const float vv[9] = {0.0000f,
+			    0.3420f,
+			    0.6428f,
+			    0.8660f,
+			    0.9848f,
+			    0.9848f,
+			    0.8660f,
+			    0.6428f,
+			    0.3420f};
+
+static inline int min(int x, int y) { return (x <= y ? x : y); }
+static inline int max(int x, int y) { return (x <= y ? y : x); }
+
+// color image in single precision (height x width x 3)
+struct fimage {
+  int dims[2];
+  std::vector<float> data;
+};
+
+// struct used for caching interpolation values
+struct alphainfo {
+  int si, di;
+  float alpha;
+};
+
+// resize along each column, as resize.cc
+// result is transposed, so we can apply it twice for a complete resize
+static void resize1dtran(const float *src, int sheight, float *dst, int dheight,
+			 int width, int chan) {
+  double scale = (double)dheight/(double)sheight;
+  double invscale = (double)sheight/(double)dheight;
+
+  // we cache the interpolation values since they can be
+  // shared among different columns
+  int len = (int)ceil(dheight*invscale) + 2*dheight;
+  std::vector<alphainfo> ofs(len);
+  int k = 0;
+  for (int dy = 0; dy < dheight; dy++) {
+    double fsy1 = dy * invscale;
+    double fsy2 = fsy1 + invscale;
+    int sy1 = (int)ceil(fsy1);
+    int sy2 = (int)floor(fsy2);
+
+    if (sy1 - fsy1 > 1e-3) {
+      ofs[k].di = dy*width;
+      ofs[k].si = sy1-1;
+      ofs[k++].alpha = (float)((sy1 - fsy1) * scale);
+    }
+
+    for (int sy = sy1; sy < sy2; sy++) {
+      ofs[k].di = dy*width;
+      ofs[k].si = sy;
+      ofs[k++].alpha = (float)scale;
+    }
+
+    if (fsy2 - sy2 > 1e-3) {
+      ofs[k].di = dy*width;
+      ofs[k].si = sy2;
+      ofs[k++].alpha = (float)((fsy2 - sy2) * scale);
+    }
+  }
+
+  // resize each column of each color channel
+  memset(dst, 0, chan*width*dheight*sizeof(float));
+  for (int c = 0; c < chan; c++) {
+    for (int x = 0; x < width; x++) {
+      const float *s = src + c*width*sheight + x*sheight;
+      float *d = dst + c*width*dheight + x;
+      for (int i = 0; i < k; i++)
+	d[ofs[i].di] += ofs[i].alpha * s[ofs[i].si];
+    }
+  }
+}
+
+// reduce each column, as reduce.cc
+// result is transposed, so we can apply it twice for a complete reduction
+static void reduce1dtran(const float *src, int sheight, float *dst, int dheight,
+			 int width, int chan) {
+  for (int c = 0; c < chan; c++) {
+    for (int x = 0; x < width; x++) {
+      const float *s = src + c*width*sheight + x*sheight;
+      float *d = dst + c*dheight*width + x;
+
+      // First row
+      *d = s[0]*.6875f + s[1]*.2500f + s[2]*.0625f;
+
+      for (int y = 1; y < dheight-2; y++) {
+	s += 2;
+	d += width;
+	*d = s[-2]*.0625f + s[-1]*.25f + s[0]*.375f + s[1]*.25f + s[2]*.0625f;
+      }
+
+      // Last two rows
+      s += 2;
+      d += width;
+      if (dheight*2 <= sheight) {
+	*d = s[-2]*.0625f + s[-1]*.25f + s[0]*.375f + s[1]*.25f + s[2]*.0625f;
+      } else {
+	*d = s[1]*.3125f + s[0]*.3750f + s[-1]*.2500f + s[-2]*.0625f;
+      }
+      s += 2;
+      d += width;
+      *d = s[0]*.6875f + s[-1]*.2500f + s[-2]*.0625f;
+    }
+  }
+}
+
+static void resize(const fimage &src, double scale, fimage &dst, std::vector<float> &tmp) {
+  dst.dims[0] = (int)round(src.dims[0]*scale);
+  dst.dims[1] = (int)round(src.dims[1]*scale);
+  dst.data.resize(dst.dims[0]*dst.dims[1]*3);
+  tmp.resize(dst.dims[0]*src.dims[1]*3);
+  resize1dtran(&src.data[0], src.dims[0], &tmp[0], dst.dims[0], src.dims[1], 3);
+  resize1dtran(&tmp[0], src.dims[1], &dst.data[0], dst.dims[1], dst.dims[0], 3);
+}
+
+static void reduce(const fimage &src, fimage &dst, std::vector<float> &tmp) {
+  dst.dims[0] = (int)round(src.dims[0]*.5);
+  dst.dims[1] = (int)round(src.dims[1]*.5);
+  dst.data.resize(dst.dims[0]*dst.dims[1]*3);
+  tmp.resize(dst.dims[0]*src.dims[1]*3);
+  reduce1dtran(&src.data[0], src.dims[0], &tmp[0], dst.dims[0], src.dims[1], 3);
+  reduce1dtran(&tmp[0], src.dims[1], &dst.data[0], dst.dims[1], dst.dims[0], 3);
+}
+
+// scratch memory of a thread, reused across levels
+struct workspace {
+  std::vector<float> tmp, hist, norm, mag, vy0;
+  std::vector<int> ori, iyp;
+};
+
+#ifdef USE_SSE
+static inline __m128 blend(__m128 mask, __m128 a, __m128 b) {
+  return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static inline __m128i blend(__m128 mask, __m128i a, __m128i b) {
+  __m128i m = _mm_castps_si128(mask);
+  return _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b));
+}
+
+static inline void store4(double *dst, __m128 v) {
+  _mm_storeu_pd(dst, _mm_cvtps_pd(v));
+  _mm_storeu_pd(dst+2, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+}
+#endif
+
+// gradient magnitude and orientation (one of 18) of pixels 1..ny of
+// column x, picking the color channel with the strongest gradient
+static void column_gradients(const float *im, const int *dims, int x, int ny,
+			     float *mag, int *ori) {
+  const float *col = im + min(x, dims[1]-2)*dims[0];
+  int plane = dims[0]*dims[1];
+  int y = 1;
+
+#ifdef USE_SSE
+  // four rows at a time, where the rows need no clamping
+  const __m128 zero = _mm_setzero_ps();
+  for (; y+3 <= min(ny, dims[0]-2); y += 4) {
+    const float *s = col + y;
+    __m128 dy = _mm_sub_ps(_mm_loadu_ps(s+1), _mm_loadu_ps(s-1));
+    __m128 dx = _mm_sub_ps(_mm_loadu_ps(s+dims[0]), _mm_loadu_ps(s-dims[0]));
+    __m128 v = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+    for (int c = 1; c < 3; c++) {
+      s += plane;
+      __m128 dy2 = _mm_sub_ps(_mm_loadu_ps(s+1), _mm_loadu_ps(s-1));
+      __m128 dx2 = _mm_sub_ps(_mm_loadu_ps(s+dims[0]), _mm_loadu_ps(s-dims[0]));
+      __m128 v2 = _mm_add_ps(_mm_mul_ps(dx2, dx2), _mm_mul_ps(dy2, dy2));
+      __m128 m = _mm_cmpgt_ps(v2, v);
+      v = blend(m, v2, v);
+      dx = blend(m, dx2, dx);
+      dy = blend(m, dy2, dy);
+    }
+
+    __m128 best_dot = zero;
+    __m128i best_o = _mm_setzero_si128();
+    for (int o = 0; o < 9; o++) {
+      __m128 dot = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(uu[o]), dx),
+			      _mm_mul_ps(_mm_set1_ps(vv[o]), dy));
+      __m128 neg = _mm_sub_ps(zero, dot);
+      __m128 m1 = _mm_cmpgt_ps(dot, best_dot);
+      __m128 m2 = _mm_andnot_ps(m1, _mm_cmpgt_ps(neg, best_dot));
+      best_dot = blend(m1, dot, blend(m2, neg, best_dot));
+      best_o = blend(m1, _mm_set1_epi32(o), blend(m2, _mm_set1_epi32(o+9), best_o));
+    }
+    _mm_storeu_ps(mag+y, _mm_sqrt_ps(v));
+    _mm_storeu_si128((__m128i *)(ori+y), best_o);
+  }
+#endif
+
+  for (; y <= ny; y++) {
+    // first color channel
+    const float *s = col + min(y, dims[0]-2);
+    float dy = *(s+1) - *(s-1);
+    float dx = *(s+dims[0]) - *(s-dims[0]);
+    float v = dx*dx + dy*dy;
+
+    // second and third color channels
+    for (int c = 1; c < 3; c++) {
+      s += plane;
+      float dy2 = *(s+1) - *(s-1);
+      float dx2 = *(s+dims[0]) - *(s-dims[0]);
+      float v2 = dx2*dx2 + dy2*dy2;
+      if (v2 > v) {
+	v = v2;
+	dx = dx2;
+	dy = dy2;
+      }
+    }
+
+    // snap to one of 18 orientations
+    float best_dot = 0;
+    int best_o = 0;
+    for (int o = 0; o < 9; o++) {
+      float dot = uu[o]*dx + vv[o]*dy;
+      if (dot > best_dot) {
+	best_dot = dot;
+	best_o = o;
+      } else if (-dot > best_dot) {
+	best_dot = -dot;
+	best_o = o+9;
+      }
+    }
+    mag[y] = sqrtf(v);
+    ori[y] = best_o;
+  }
+}
+
+// HOG features of an image, as features.cc, written into a level of
+// the pyramid (fdims[0] x fdims[1] x 32) inside its padding
+static void features(const fimage &im, int sbin, double *feat, const int *fdims,
+		     int padx, int pady, workspace &ws) {
+  const int *dims = im.dims;
+  const float *data = &im.data[0];
+
+  // memory for caching orientation histograms & their norms
+  int blocks[2];
+  blocks[0] = (int)round((double)dims[0]/(double)sbin);
+  blocks[1] = (int)round((double)dims[1]/(double)sbin);
+  int bplane = blocks[0]*blocks[1];
+  ws.hist.assign(bplane*18 + 4, 0.0f);
+  ws.norm.assign(bplane + 4, 0.0f);
+  float *hist = &ws.hist[0];
+  float *norm = &ws.norm[0];
+
+  int out[2];
+  out[0] = max(blocks[0]-2, 0);
+  out[1] = max(blocks[1]-2, 0);
+  int fplane = fdims[0]*fdims[1];
+
+  int visible[2];
+  visible[0] = blocks[0]*sbin;
+  visible[1] = blocks[1]*sbin;
+
+  // interpolation of each row between the histograms above and below
+  ws.mag.resize(visible[0]+4);
+  ws.ori.resize(visible[0]+4);
+  ws.iyp.resize(visible[0]);
+  ws.vy0.resize(visible[0]);
+  for (int y = 1; y < visible[0]-1; y++) {
+    float yp = ((float)y+0.5f)/(float)sbin - 0.5f;
+    ws.iyp[y] = (int)floorf(yp);
+    ws.vy0[y] = yp-ws.iyp[y];
+  }
+
+  for (int x = 1; x < visible[1]-1; x++) {
+    column_gradients(data, dims, x, visible[0]-2, &ws.mag[0], &ws.ori[0]);
+
+    // add to 4 histograms around each pixel using linear interpolation
+    float xp = ((float)x+0.5f)/(float)sbin - 0.5f;
+    int ixp = (int)floorf(xp);
+    float vx0 = xp-ixp;
+    float vx1 = 1.0f-vx0;
+    for (int y = 1; y < visible[0]-1; y++) {
+      int iyp = ws.iyp[y];
+      float vy0 = ws.vy0[y];
+      float vy1 = 1.0f-vy0;
+      float v = ws.mag[y];
+      float *h = hist + ws.ori[y]*bplane;
+
+      if (ixp >= 0 && iyp >= 0)
+	h[ixp*blocks[0] + iyp] += vx1*vy1*v;
+      if (ixp+1 < blocks[1] && iyp >= 0)
+	h[(ixp+1)*blocks[0] + iyp] += vx0*vy1*v;
+      if (ixp >= 0 && iyp+1 < blocks[0])
+	h[ixp*blocks[0] + (iyp+1)] += vx1*vy0*v;
+      if (ixp+1 < blocks[1] && iyp+1 < blocks[0])
+	h[(ixp+1)*blocks[0] + (iyp+1)] += vx0*vy0*v;
+    }
+  }
+
+  // compute energy in each block by summing over orientations
+  for (int o = 0; o < 9; o++) {
+    const float *src1 = hist + o*bplane;
+    const float *src2 = hist + (o+9)*bplane;
+    int i = 0;
+#ifdef USE_SSE
+    for (; i+4 <= bplane; i += 4) {
+      __m128 s = _mm_add_ps(_mm_loadu_ps(src1+i), _mm_loadu_ps(src2+i));
+      _mm_storeu_ps(norm+i, _mm_add_ps(_mm_loadu_ps(norm+i), _mm_mul_ps(s, s)));
+    }
+#endif
+    for (; i < bplane; i++)
+      norm[i] += (src1[i] + src2[i]) * (src1[i] + src2[i]);
+  }
+
+  // compute features
+  for (int x = 0; x < out[1]; x++) {
+    double *col = feat + (x+padx+1)*fdims[0] + pady+1;
+    int y = 0;
+
+#ifdef USE_SSE
+    // four cells at a time
+    const __m128 e = _mm_set1_ps(eps);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 trunc = _mm_set1_ps(0.2f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    for (; y+4 <= out[0]; y += 4) {
+      double *dst = col + y;
+      const float *p = norm + x*blocks[0] + y;
+      __m128 a0 = _mm_loadu_ps(p), a1 = _mm_loadu_ps(p+1), a2 = _mm_loadu_ps(p+2);
+      p += blocks[0];
+      __m128 b0 = _mm_loadu_ps(p), b1 = _mm_loadu_ps(p+1), b2 = _mm_loadu_ps(p+2);
+      p += blocks[0];
+      __m128 c0 = _mm_loadu_ps(p), c1 = _mm_loadu_ps(p+1), c2 = _mm_loadu_ps(p+2);
+      __m128 n1 = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(b1, b2), c1), c2), e)));
+      __m128 n2 = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(b0, b1), c0), c1), e)));
+      __m128 n3 = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(a1, a2), b1), b2), e)));
+      __m128 n4 = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(a0, a1), b0), b1), e)));
+
+      __m128 t1 = _mm_setzero_ps();
+      __m128 t2 = _mm_setzero_ps();
+      __m128 t3 = _mm_setzero_ps();
+      __m128 t4 = _mm_setzero_ps();
+
+      // contrast-sensitive features
+      const float *src = hist + (x+1)*blocks[0] + (y+1);
+      for (int o = 0; o < 18; o++) {
+	__m128 s = _mm_loadu_ps(src);
+	__m128 h1 = _mm_min_ps(_mm_mul_ps(s, n1), trunc);
+	__m128 h2 = _mm_min_ps(_mm_mul_ps(s, n2), trunc);
+	__m128 h3 = _mm_min_ps(_mm_mul_ps(s, n3), trunc);
+	__m128 h4 = _mm_min_ps(_mm_mul_ps(s, n4), trunc);
+	store4(dst, _mm_mul_ps(half, _mm_add_ps(_mm_add_ps(_mm_add_ps(h1, h2), h3), h4)));
+	t1 = _mm_add_ps(t1, h1);
+	t2 = _mm_add_ps(t2, h2);
+	t3 = _mm_add_ps(t3, h3);
+	t4 = _mm_add_ps(t4, h4);
+	dst += fplane;
+	src += bplane;
+      }
+
+      // contrast-insensitive features
+      src = hist + (x+1)*blocks[0] + (y+1);
+      for (int o = 0; o < 9; o++) {
+	__m128 s = _mm_add_ps(_mm_loadu_ps(src), _mm_loadu_ps(src + 9*bplane));
+	__m128 h1 = _mm_min_ps(_mm_mul_ps(s, n1), trunc);
+	__m128 h2 = _mm_min_ps(_mm_mul_ps(s, n2), trunc);
+	__m128 h3 = _mm_min_ps(_mm_mul_ps(s, n3), trunc);
+	__m128 h4 = _mm_min_ps(_mm_mul_ps(s, n4), trunc);
+	store4(dst, _mm_mul_ps(half, _mm_add_ps(_mm_add_ps(_mm_add_ps(h1, h2), h3), h4)));
+	dst += fplane;
+	src += bplane;
+      }
+
+      // texture features (the truncation feature stays 0)
+      const __m128 tw = _mm_set1_ps(0.2357f);
+      store4(dst, _mm_mul_ps(tw, t1));
+      dst += fplane;
+      store4(dst, _mm_mul_ps(tw, t2));
+      dst += fplane;
+      store4(dst, _mm_mul_ps(tw, t3));
+      dst += fplane;
+      store4(dst, _mm_mul_ps(tw, t4));
+    }
+#endif
+
+    for (; y < out[0]; y++) {
+      double *dst = col + y;
+      const float *p;
+      float n1, n2, n3, n4;
+
+      p = norm + (x+1)*blocks[0] + y+1;
+      n1 = 1.0f / sqrtf(*p + *(p+1) + *(p+blocks[0]) + *(p+blocks[0]+1) + eps);
+      p = norm + (x+1)*blocks[0] + y;
+      n2 = 1.0f / sqrtf(*p + *(p+1) + *(p+blocks[0]) + *(p+blocks[0]+1) + eps);
+      p = norm + x*blocks[0] + y+1;
+      n3 = 1.0f / sqrtf(*p + *(p+1) + *(p+blocks[0]) + *(p+blocks[0]+1) + eps);
+      p = norm + x*blocks[0] + y;
+      n4 = 1.0f / sqrtf(*p + *(p+1) + *(p+blocks[0]) + *(p+blocks[0]+1) + eps);
+
+      float t1 = 0;
+      float t2 = 0;
+      float t3 = 0;
+      float t4 = 0;
+
+      // contrast-sensitive features
+      const float *src = hist + (x+1)*blocks[0] + (y+1);
+      for (int o = 0; o < 18; o++) {
+	float h1 = std::min(*src * n1, 0.2f);
+	float h2 = std::min(*src * n2, 0.2f);
+	float h3 = std::min(*src * n3, 0.2f);
+	float h4 = std::min(*src * n4, 0.2f);
+	*dst = 0.5f * (h1 + h2 + h3 + h4);
+	t1 += h1;
+	t2 += h2;
+	t3 += h3;
+	t4 += h4;
+	dst += fplane;
+	src += bplane;
+      }
+
+      // contrast-insensitive features
+      src = hist + (x+1)*blocks[0] + (y+1);
+      for (int o = 0; o < 9; o++) {
+	float sum = *src + *(src + 9*bplane);
+	float h1 = std::min(sum * n1, 0.2f);
+	float h2 = std::min(sum * n2, 0.2f);
+	float h3 = std::min(sum * n3, 0.2f);
+	float h4 = std::min(sum * n4, 0.2f);
+	*dst = 0.5f * (h1 + h2 + h3 + h4);
+	dst += fplane;
+	src += bplane;
+      }
+
+      // texture features (the truncation feature stays 0)
+      *dst = 0.2357f * t1;
+      dst += fplane;
+      *dst = 0.2357f * t2;
+      dst += fplane;
+      *dst = 0.2357f * t3;
+      dst += fplane;
+      *dst = 0.2357f * t4;
+    }
+  }
+
+  // write boundary occlusion feature
+  double *occ = feat + 31*fplane;
+  for (int x = 0; x < fdims[1]; x++) {
+    double *c = occ + x*fdims[0];
+    if (x <= padx || x >= fdims[1]-padx-1) {
+      for (int y = 0; y < fdims[0]; y++)
+	c[y] = 1;
+    } else {
+      for (int y = 0; y <= pady; y++)
+	c[y] = 1;
+      for (int y = fdims[0]-pady-1; y < fdims[0]; y++)
+	c[y] = 1;
+    }
+  }
+}
+
+// the pyramid being computed
+struct pyramid {
+  int sbin, interval, max_scale, padx, pady;
+  double sc;
+  const fimage *im;
+  std::vector<fimage> levels;     // image of each level
+  std::vector<double *> feat;     // features of each level
+  std::vector<std::vector<int> > fdims;
+};
+
+// tasks handed out to the threads: the resize/reduce chains of the
+// octaves, then the features of the levels
+struct task_queue {
+  pyramid *pyra;
+  bool chains;
+  std::vector<int> todo;
+  int next;
+#ifndef _WIN32
+  pthread_mutex_t lock;
+#endif
+};
+
+static void *process_tasks(void *arg) {
+  task_queue *q = (task_queue *)arg;
+  pyramid &pyra = *q->pyra;
+  workspace ws;
+  for (;;) {
+    int i;
+#ifndef _WIN32
+    pthread_mutex_lock(&q->lock);
+#endif
+    i = q->next++;
+#ifndef _WIN32
+    pthread_mutex_unlock(&q->lock);
+#endif
+    if (i >= (int)q->todo.size())
+      break;
+    int l = q->todo[i];
+    if (q->chains) {
+      resize(*pyra.im, 1/pow(pyra.sc, l), pyra.levels[l], ws.tmp);
+      for (int j = l+pyra.interval; j < pyra.max_scale; j += pyra.interval)
+	reduce(pyra.levels[j-pyra.interval], pyra.levels[j], ws.tmp);
+    } else {
+      features(pyra.levels[l], pyra.sbin, pyra.feat[l], &pyra.fdims[l][0],
+	       pyra.padx, pyra.pady, ws);
+      std::vector<float>().swap(pyra.levels[l].data);
+    }
+  }
+  return NULL;
+}
+
+static void run_tasks(task_queue &q, int num_threads) {
+  q.next = 0;
+  if (num_threads > (int)q.todo.size())
+    num_threads = q.todo.size();
+#ifndef _WIN32
+  pthread_mutex_init(&q.lock, NULL);
+  if (num_threads > 1) {
+    std::vector<pthread_t> ts(num_threads);
+    for (int t = 0; t < num_threads; t++) {
+      if (pthread_create(&ts[t], NULL, process_tasks, (void *)&q))
+	mexErrMsgTxt("Error creating thread");
+    }
+    for (int t = 0; t < num_threads; t++)
+      pthread_join(ts[t], NULL);
+  } else
+#endif
+  process_tasks((void *)&q);
+#ifndef _WIN32
+  pthread_mutex_destroy(&q.lock);
+#endif
+}
+
+// copy an image of any type into single precision, as a color image
+template<class T> static void copy_image(const T *src, int n, int chan, float *dst) {
+  for (int c = 0; c < 3; c++) {
+    const T *s = src + (chan == 3 ? c*n : 0);
+    for (int i = 0; i < n; i++)
+      dst[c*n+i] = (float)s[i];
+  }
+}
+
+// matlab entry point
+// [feat, scale] = featpyr(im, sbin, interval, padx, pady)
+// im is a color or grayscale image (uint8, single or double); feat{i}
+// and scale(i) are pyra.feat{i} and pyra.scale(i) of featpyramid.m
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+  if (nrhs != 5)
+    mexErrMsgTxt("Wrong number of inputs");
+  if (nlhs > 2)
+    mexErrMsgTxt("Wrong number of outputs");
+
+  const mwSize *idims = mxGetDimensions(prhs[0]);
+  int ndims = mxGetNumberOfDimensions(prhs[0]);
+  int chan = ndims == 3 ? idims[2] : 1;
+  if (ndims > 3 || (chan != 1 && chan != 3) || idims[0] < 3 || idims[1] < 3)
+    mexErrMsgTxt("Invalid input");
+
+  pyramid pyra;
+  pyra.sbin = (int)mxGetScalar(prhs[1]);
+  pyra.interval = (int)mxGetScalar(prhs[2]);
+  pyra.padx = (int)mxGetScalar(prhs[3]);
+  pyra.pady = (int)mxGetScalar(prhs[4]);
+  if (pyra.sbin < 1 || pyra.interval < 1 || pyra.padx < 0 || pyra.pady < 0)
+    mexErrMsgTxt("Invalid input");
+
+  fimage im;
+  im.dims[0] = idims[0];
+  im.dims[1] = idims[1];
+  int n = im.dims[0]*im.dims[1];
+  im.data.resize(n*3);
+  switch (mxGetClassID(prhs[0])) {
+  case mxUINT8_CLASS:
+    copy_image((const unsigned char *)mxGetData(prhs[0]), n, chan, &im.data[0]);
+    break;
+  case mxSINGLE_CLASS:
+    copy_image((const float *)mxGetData(prhs[0]), n, chan, &im.data[0]);
+    break;
+  case mxDOUBLE_CLASS:
+    copy_image((const double *)mxGetData(prhs[0]), n, chan, &im.data[0]);
+    break;
+  default:
+    mexErrMsgTxt("Invalid input");
+  }
+
+  // levels, as featpyramid.m: the first octave computes the other ones
+  // by halving its resolution
+  pyra.sc = pow(2.0, 1.0/pyra.interval);
+  pyra.max_scale = 1 + (int)floor(log(min(im.dims[0], im.dims[1])/(5.0*pyra.sbin))/log(pyra.sc));
+  int numlevels = max(pyra.max_scale, pyra.interval);
+  pyra.im = &im;
+  pyra.levels.resize(numlevels);
+  pyra.feat.resize(numlevels);
+  pyra.fdims.resize(numlevels);
+
+  // sizes of the levels, and their (zero) features
+  plhs[0] = mxCreateCellMatrix(numlevels, 1);
+  std::vector<double> scale(numlevels);
+  for (int l = 0; l < numlevels; l++) {
+    int d[2];
+    if (l < pyra.interval) {
+      scale[l] = 1/pow(pyra.sc, l);
+      d[0] = (int)round(im.dims[0]*scale[l]);
+      d[1] = (int)round(im.dims[1]*scale[l]);
+    } else {
+      scale[l] = 0.5 * scale[l-pyra.interval];
+      d[0] = (int)round(pyra.levels[l-pyra.interval].dims[0]*.5);
+      d[1] = (int)round(pyra.levels[l-pyra.interval].dims[1]*.5);
+    }
+    pyra.levels[l].dims[0] = d[0];
+    pyra.levels[l].dims[1] = d[1];
+    if (d[0] < 3 || d[1] < 3)
+      mexErrMsgTxt("Image too small for the pyramid");
+
+    // add 1 to padding because feature generation deletes a 1-cell
+    // wide border around the feature map
+    mwSize fd[3];
+    fd[0] = max((int)round((double)d[0]/(double)pyra.sbin)-2, 0) + 2*(pyra.pady+1);
+    fd[1] = max((int)round((double)d[1]/(double)pyra.sbin)-2, 0) + 2*(pyra.padx+1);
+    fd[2] = 27+4+1;
+    mxArray *mxfeat = mxCreateNumericArray(3, fd, mxDOUBLE_CLASS, mxREAL);
+    mxSetCell(plhs[0], l, mxfeat);
+    pyra.feat[l] = mxGetPr(mxfeat);
+    pyra.fdims[l].assign(fd, fd+3);
+  }
+
+  int num_threads = 1;
+#ifndef _WIN32
+  num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+  // images: the resize and reductions of each octave
+  task_queue q;
+  q.pyra = &pyra;
+  q.chains = true;
+  for (int l = 0; l < pyra.interval; l++)
+    q.todo.push_back(l);
+  run_tasks(q, num_threads);
+
+  // features, largest levels first
+  q.chains = false;
+  q.todo.clear();
+  for (int l = 0; l < numlevels; l++)
+    q.todo.push_back(l);
+  run_tasks(q, num_threads);
+
+  if (nlhs > 1) {
+    plhs[1] = mxCreateDoubleMatrix(numlevels, 1, mxREAL);
+    double *out = mxGetPr(plhs[1]);
+    for (int l = 0; l < numlevels; l++)
+      out[l] = pyra.sbin/scale[l];
+  }
+}
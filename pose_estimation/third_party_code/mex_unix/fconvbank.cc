@@ -0,0 +1,446 @@
+#include <math.h>
+#include <string.h>
+#include <vector>
+#include "mex.h"
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define USE_SSE
+#endif
+#ifndef _WIN32
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+/*
+ * This code is used for computing filter responses, as fconv.cc, with
+ * the filters packed once per model into a bank.
+ *
+ * bank = fconvbank(filters) groups the filters (a cell of arrays) by
+ * size, and packs each group, in single precision, as one matrix with
+ * the filters innermost.
+ *
+ * resp = fconvbank(bank, A) returns the responses of all the filters
+ * with the feature map A, as fconv(A, filters, 1, length(filters)).
+ * resp = fconvbank(bank, feat, levels) does the same for the levels of
+ * a pyramid (a cell of feature maps) in one call, resp{l} being the
+ * responses of level l, or [] for the levels not in levels (default:
+ * all).
+ *
+ * The responses of each group are one matrix product per level: the
+ * feature map is laid out with the features innermost, so that the
+ * window of each response is a few contiguous runs of the map, and
+ * blocks of 4 responses of 8 filters are accumulated in single
+ * precision with SSE2. The products are split in column blocks that
+ * are run by a pool of threads, kept across calls.
+ */
+
+// filters per block of the product (two SSE registers)
+#define NB 8
+
+// columns of the responses per task
+#define COLS 8
+
+// group of filters of the same size, packed as a (sizx*sizy*nf) x npad
+// matrix (filters innermost, npad a multiple of NB)
+struct filter_group {
+  int sizy, sizx, num, npad;
+  std::vector<int> ids;
+  const float *w;
+};
+
+// feature map, single precision, features innermost
+struct packed_map {
+  int dims[3];
+  std::vector<float> data;
+};
+
+static void pack_map(const double *A, const mwSize *A_dims, packed_map &M) {
+  int H = A_dims[0], W = A_dims[1], nf = A_dims[2];
+  M.dims[0] = H;
+  M.dims[1] = W;
+  M.dims[2] = nf;
+  M.data.resize((size_t)H*W*nf);
+  for (int f = 0; f < nf; f++) {
+    for (int x = 0; x < W; x++) {
+      const double *src = A + f*H*W + x*H;
+      float *dst = &M.data[(size_t)x*H*nf + f];
+      for (int y = 0; y < H; y++)
+	dst[y*nf] = (float)src[y];
+    }
+  }
+}
+
+// responses of R consecutive rows (y..y+R-1) of column x, for the
+// filters nb..nb+4*V-1 of a group (V = 1 or 2 vectors of 4 filters)
+template<int R, int V>
+static void block_responses(const packed_map &M, const filter_group &g, int nb,
+			    int x, int y, float *out) {
+  const int H = M.dims[0], nf = M.dims[2];
+  const int K = g.sizy*nf;
+#ifdef USE_SSE
+  __m128 acc[R][V];
+  for (int i = 0; i < R; i++) {
+    for (int v = 0; v < V; v++)
+      acc[i][v] = _mm_setzero_ps();
+  }
+  for (int dx = 0; dx < g.sizx; dx++) {
+    const float *a = &M.data[((size_t)(x+dx)*H + y)*nf];
+    const float *b = g.w + (size_t)dx*K*g.npad + nb;
+    for (int j = 0; j < K; j++, b += g.npad) {
+      __m128 bv[V];
+      for (int v = 0; v < V; v++)
+	bv[v] = _mm_loadu_ps(b + 4*v);
+      for (int i = 0; i < R; i++) {
+	__m128 ai = _mm_set1_ps(a[i*nf + j]);
+	for (int v = 0; v < V; v++)
+	  acc[i][v] = _mm_add_ps(acc[i][v], _mm_mul_ps(ai, bv[v]));
+      }
+    }
+  }
+  for (int i = 0; i < R; i++) {
+    for (int v = 0; v < V; v++)
+      _mm_storeu_ps(out + i*NB + 4*v, acc[i][v]);
+  }
+#else
+  float acc[R][4*V];
+  memset(acc, 0, sizeof(acc));
+  for (int dx = 0; dx < g.sizx; dx++) {
+    const float *a = &M.data[((size_t)(x+dx)*H + y)*nf];
+    const float *b = g.w + (size_t)dx*K*g.npad + nb;
+    for (int j = 0; j < K; j++, b += g.npad) {
+      for (int i = 0; i < R; i++) {
+	float ai = a[i*nf + j];
+	for (int n = 0; n < 4*V; n++)
+	  acc[i][n] += ai * b[n];
+      }
+    }
+  }
+  for (int i = 0; i < R; i++)
+    memcpy(out + i*NB, acc[i], sizeof(acc[i]));
+#endif
+}
+
+template<int V>
+static void block_responses(const packed_map &M, const filter_group &g, int nb,
+			    int x, int y, int rows, float *out) {
+  switch (rows) {
+  case 4: block_responses<4, V>(M, g, nb, x, y, out); break;
+  case 3: block_responses<3, V>(M, g, nb, x, y, out); break;
+  case 2: block_responses<2, V>(M, g, nb, x, y, out); break;
+  default: block_responses<1, V>(M, g, nb, x, y, out); break;
+  }
+}
+
+// one task: columns x0..x1-1 of the responses of a group with a map
+struct conv_task {
+  const packed_map *map;
+  const filter_group *group;
+  double **C;         // responses of the level, one per filter (by id)
+  int height, x0, x1;
+};
+
+static void run_task(const conv_task &t) {
+  const filter_group &g = *t.group;
+  float out[4*NB];
+  for (int nb = 0; nb < g.num; nb += NB) {
+    int nn = g.num - nb < NB ? g.num - nb : NB;
+    for (int x = t.x0; x < t.x1; x++) {
+      for (int y = 0; y < t.height; y += 4) {
+	int rows = t.height - y < 4 ? t.height - y : 4;
+	if (nn > 4)
+	  block_responses<2>(*t.map, g, nb, x, y, rows, out);
+	else
+	  block_responses<1>(*t.map, g, nb, x, y, rows, out);
+	for (int n = 0; n < nn; n++) {
+	  double *dst = t.C[g.ids[nb+n]] + (size_t)x*t.height + y;
+	  for (int i = 0; i < rows; i++)
+	    dst[i] = out[i*NB + n];
+	}
+      }
+    }
+  }
+}
+
+// Pool of worker threads, started on the first call and kept until the
+// MEX file is cleared. The calling thread works on the tasks too.
+struct thread_pool {
+  const std::vector<conv_task> *tasks;
+  int next, finished;
+  bool started, quit;
+#ifndef _WIN32
+  std::vector<pthread_t> ts;
+  pthread_mutex_t lock;
+  pthread_cond_t work, done;
+#endif
+};
+
+static thread_pool pool = {NULL, 0, 0, false, false};
+
+#ifndef _WIN32
+static void *worker(void *arg) {
+  pthread_mutex_lock(&pool.lock);
+  for (;;) {
+    while (!pool.quit && (pool.tasks == NULL || pool.next >= (int)pool.tasks->size()))
+      pthread_cond_wait(&pool.work, &pool.lock);
+    if (pool.quit)
+      break;
+    const conv_task &t = (*pool.tasks)[pool.next++];
+    pthread_mutex_unlock(&pool.lock);
+    run_task(t);
+    pthread_mutex_lock(&pool.lock);
+    if (++pool.finished == (int)pool.tasks->size())
+      pthread_cond_signal(&pool.done);
+  }
+  pthread_mutex_unlock(&pool.lock);
+  return NULL;
+}
+
+static void stop_pool() {
+  pthread_mutex_lock(&pool.lock);
+  pool.quit = true;
+  pthread_cond_broadcast(&pool.work);
+  pthread_mutex_unlock(&pool.lock);
+  for (int t = 0; t < (int)pool.ts.size(); t++)
+    pthread_join(pool.ts[t], NULL);
+  pool.ts.clear();
+  pthread_cond_destroy(&pool.work);
+  pthread_cond_destroy(&pool.done);
+  pthread_mutex_destroy(&pool.lock);
+  pool.started = false;
+  pool.quit = false;
+}
+
+static void start_pool() {
+  pthread_mutex_init(&pool.lock, NULL);
+  pthread_cond_init(&pool.work, NULL);
+  pthread_cond_init(&pool.done, NULL);
+  pool.started = true;
+  mexAtExit(stop_pool);
+  int num_threads = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+  for (int t = 0; t < num_threads; t++) {
+    pthread_t th;
+    if (pthread_create(&th, NULL, worker, NULL))
+      break;
+    pool.ts.push_back(th);
+  }
+}
+#endif
+
+static void run_tasks(const std::vector<conv_task> &tasks) {
+#ifndef _WIN32
+  if (!pool.started)
+    start_pool();
+  pthread_mutex_lock(&pool.lock);
+  pool.tasks = &tasks;
+  pool.next = 0;
+  pool.finished = 0;
+  pthread_cond_broadcast(&pool.work);
+  while (pool.next < (int)tasks.size()) {
+    const conv_task &t = tasks[pool.next++];
+    pthread_mutex_unlock(&pool.lock);
+    run_task(t);
+    pthread_mutex_lock(&pool.lock);
+    pool.finished++;
+  }
+  while (pool.finished < (int)tasks.size())
+    pthread_cond_wait(&pool.done, &pool.lock);
+  pool.tasks = NULL;
+  pthread_mutex_unlock(&pool.lock);
+#else
+  for (int i = 0; i < (int)tasks.size(); i++)
+    run_task(tasks[i]);
+#endif
+}
+
+// bank = fconvbank(filters)
+static mxArray *pack_bank(const mxArray *cellB) {
+  int num = mxGetNumberOfElements(cellB);
+  int nf = -1;
+  std::vector<int> sizy(num), sizx(num), group(num, -1);
+  std::vector<int> gy, gx, gnum;
+  for (int i = 0; i < num; i++) {
+    const mxArray *mxB = mxGetCell(cellB, i);
+    if (mxB == NULL || mxGetNumberOfDimensions(mxB) != 3 ||
+	mxGetClassID(mxB) != mxDOUBLE_CLASS)
+      mexErrMsgTxt("Invalid input: B");
+    const mwSize *B_dims = mxGetDimensions(mxB);
+    if (nf < 0)
+      nf = B_dims[2];
+    if ((int)B_dims[2] != nf)
+      mexErrMsgTxt("Invalid input: B");
+    sizy[i] = B_dims[0];
+    sizx[i] = B_dims[1];
+    for (int k = 0; k < (int)gy.size() && group[i] < 0; k++) {
+      if (gy[k] == sizy[i] && gx[k] == sizx[i])
+	group[i] = k;
+    }
+    if (group[i] < 0) {
+      group[i] = gy.size();
+      gy.push_back(sizy[i]);
+      gx.push_back(sizx[i]);
+      gnum.push_back(0);
+    }
+    gnum[group[i]]++;
+  }
+
+  const char *fields[] = {"ids", "sizy", "sizx", "w"};
+  int num_groups = gy.size();
+  mxArray *bank = mxCreateStructMatrix(1, num_groups, 4, fields);
+  for (int k = 0; k < num_groups; k++) {
+    int npad = (gnum[k] + NB-1)/NB*NB;
+    int K = gy[k]*gx[k]*nf;
+    mxArray *ids = mxCreateDoubleMatrix(1, gnum[k], mxREAL);
+    mxArray *w = mxCreateNumericMatrix(npad, K, mxSINGLE_CLASS, mxREAL);
+    float *dst = (float *)mxGetData(w);
+    int n = 0;
+    for (int i = 0; i < num; i++) {
+      if (group[i] != k)
+	continue;
+      mxGetPr(ids)[n] = i+1;
+      const double *B = mxGetPr(mxGetCell(cellB, i));
+      for (int f = 0; f < nf; f++) {
+	for (int x = 0; x < gx[k]; x++) {
+	  for (int y = 0; y < gy[k]; y++) {
+	    dst[(size_t)((x*gy[k] + y)*nf + f)*npad + n] =
+	      (float)B[y + x*gy[k] + f*gy[k]*gx[k]];
+	  }
+	}
+      }
+      n++;
+    }
+    mxSetField(bank, k, "ids", ids);
+    mxSetField(bank, k, "sizy", mxCreateDoubleScalar(gy[k]));
+    mxSetField(bank, k, "sizx", mxCreateDoubleScalar(gx[k]));
+    mxSetField(bank, k, "w", w);
+  }
+  return bank;
+}
+
+static void read_bank(const mxArray *bank, std::vector<filter_group> &groups, int &num_bs, int &nf) {
+  if (!mxIsStruct(bank))
+    mexErrMsgTxt("Invalid input: bank");
+  int num_groups = mxGetNumberOfElements(bank);
+  groups.resize(num_groups);
+  num_bs = 0;
+  nf = -1;
+  for (int k = 0; k < num_groups; k++) {
+    filter_group &g = groups[k];
+    const mxArray *ids = mxGetField(bank, k, "ids");
+    const mxArray *sy = mxGetField(bank, k, "sizy");
+    const mxArray *sx = mxGetField(bank, k, "sizx");
+    const mxArray *w = mxGetField(bank, k, "w");
+    if (ids == NULL || sy == NULL || sx == NULL || w == NULL ||
+	mxGetClassID(ids) != mxDOUBLE_CLASS || mxGetClassID(w) != mxSINGLE_CLASS)
+      mexErrMsgTxt("Invalid input: bank");
+    g.sizy = (int)mxGetScalar(sy);
+    g.sizx = (int)mxGetScalar(sx);
+    g.num = mxGetNumberOfElements(ids);
+    g.npad = mxGetM(w);
+    g.w = (const float *)mxGetData(w);
+    if (g.sizy < 1 || g.sizx < 1 || g.npad % NB || g.npad < g.num ||
+	mxGetN(w) % (g.sizy*g.sizx))
+      mexErrMsgTxt("Invalid input: bank");
+    int f = mxGetN(w)/(g.sizy*g.sizx);
+    if (nf >= 0 && f != nf)
+      mexErrMsgTxt("Invalid input: bank");
+    nf = f;
+    g.ids.resize(g.num);
+    for (int n = 0; n < g.num; n++) {
+      g.ids[n] = (int)mxGetPr(ids)[n] - 1;
+      if (g.ids[n] < 0)
+	mexErrMsgTxt("Invalid input: bank");
+      if (g.ids[n] >= num_bs)
+	num_bs = g.ids[n]+1;
+    }
+  }
+}
+
+// matlab entry points
+// bank = fconvbank(filters)
+// C = fconvbank(bank, A)
+// C = fconvbank(bank, cell of A, levels)
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+  if (nrhs < 1 || nrhs > 3)
+    mexErrMsgTxt("Wrong number of inputs");
+  if (nlhs != 1)
+    mexErrMsgTxt("Wrong number of outputs");
+
+  if (nrhs == 1) {
+    if (!mxIsCell(prhs[0]))
+      mexErrMsgTxt("Invalid input: B");
+    plhs[0] = pack_bank(prhs[0]);
+    return;
+  }
+
+  std::vector<filter_group> groups;
+  int num_bs, nf;
+  read_bank(prhs[0], groups, num_bs, nf);
+
+  // feature maps, and the levels to compute
+  bool pyramid = mxIsCell(prhs[1]);
+  int num_levels = pyramid ? mxGetNumberOfElements(prhs[1]) : 1;
+  std::vector<int> levels;
+  if (nrhs > 2) {
+    if (!pyramid || mxGetClassID(prhs[2]) != mxDOUBLE_CLASS)
+      mexErrMsgTxt("Invalid input: levels");
+    for (int i = 0; i < (int)mxGetNumberOfElements(prhs[2]); i++) {
+      int l = (int)mxGetPr(prhs[2])[i] - 1;
+      if (l < 0 || l >= num_levels)
+	mexErrMsgTxt("Invalid input: levels");
+      levels.push_back(l);
+    }
+  } else {
+    for (int l = 0; l < num_levels; l++)
+      levels.push_back(l);
+  }
+
+  if (pyramid)
+    plhs[0] = mxCreateCellArray(mxGetNumberOfDimensions(prhs[1]), mxGetDimensions(prhs[1]));
+  std::vector<packed_map> maps(levels.size());
+  std::vector<std::vector<double *> > C(levels.size(), std::vector<double *>(num_bs, (double *)NULL));
+  std::vector<conv_task> tasks;
+  for (int i = 0; i < (int)levels.size(); i++) {
+    const mxArray *mxA = pyramid ? mxGetCell(prhs[1], levels[i]) : prhs[1];
+    if (mxA == NULL || mxGetNumberOfDimensions(mxA) != 3 ||
+	mxGetClassID(mxA) != mxDOUBLE_CLASS)
+      mexErrMsgTxt("Invalid input: A");
+    const mwSize *A_dims = mxGetDimensions(mxA);
+    if ((int)A_dims[2] != nf)
+      mexErrMsgTxt("Invalid input: B");
+    if (pyramid && mxGetCell(plhs[0], levels[i]) != NULL)
+      continue;  // repeated level
+
+    // output cell of the level
+    mxArray *resp = mxCreateCellMatrix(1, num_bs);
+    if (pyramid)
+      mxSetCell(plhs[0], levels[i], resp);
+    else
+      plhs[0] = resp;
+    for (int k = 0; k < (int)groups.size(); k++) {
+      const filter_group &g = groups[k];
+      // compute size of output
+      int height = A_dims[0] - g.sizy + 1;
+      int width = A_dims[1] - g.sizx + 1;
+      if (height < 1 || width < 1)
+	mexErrMsgTxt("Invalid input: B should be smaller than A");
+      for (int n = 0; n < g.num; n++) {
+	mxArray *mxC = mxCreateDoubleMatrix(height, width, mxREAL);
+	mxSetCell(resp, g.ids[n], mxC);
+	C[i][g.ids[n]] = mxGetPr(mxC);
+      }
+      for (int x = 0; x < width; x += COLS) {
+	conv_task t;
+	t.map = &maps[i];
+	t.group = &g;
+	t.C = &C[i][0];
+	t.height = height;
+	t.x0 = x;
+	t.x1 = x+COLS < width ? x+COLS : width;
+	tasks.push_back(t);
+      }
+    }
+    pack_map(mxGetPr(mxA), A_dims, maps[i]);
+  }
+
+  run_tasks(tasks);
+}